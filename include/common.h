@@ -7,6 +7,8 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <cstdint>
+#include <cstddef>
 
 std::string readFileContents(std::string path) {
     std::ifstream in(path);
@@ -15,5 +17,20 @@ std::string readFileContents(std::string path) {
     return buffer.str();
 }
 
+// 64-bit FNV-1a, chainable through the seed argument.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t hashString(const std::string& s, uint64_t seed = 14695981039346656037ull) {
+    return hashBytes(s.data(), s.size(), seed);
+}
+
 
 #endif //PROJECT_BASE_COMMON_H
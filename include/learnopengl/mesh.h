@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/MeshLod.h>
 
 #include <string>
 #include <vector>
@@ -39,8 +40,16 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-
-    unsigned int VAO;
+    // lods[0] is the whole mesh, coarser levels are appended to indices after it
+    vector<rg::MeshLod>  lods;
+
+    // where the mesh lives in its Model's shared buffers, filled in by the Model
+    unsigned int baseVertex = 0;
+    unsigned int firstIndex = 0;
+    unsigned int node = 0;      // index of the owning node in Model::nodes
+    unsigned int material = 0;  // meshes with the same textures share a material id
+    bool alphaTested = false;   // has an opacity map, drawn with the alpha shader after every opaque mesh
+    glm::vec3 center = glm::vec3(0.0f);  // of the bounding box, in the node's space, for sorting blended meshes
     std::string glslIdentifierPrefix;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -48,22 +57,31 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
-
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        this->lods.push_back(rg::MeshLod{ 0, (uint32_t) this->indices.size(), 0.0f });
+        if (!this->vertices.empty())
+        {
+            glm::vec3 boxMin = this->vertices[0].Position, boxMax = boxMin;
+            for (const Vertex& vertex : this->vertices)
+            {
+                boxMin = glm::min(boxMin, vertex.Position);
+                boxMax = glm::max(boxMax, vertex.Position);
+            }
+            center = (boxMin + boxMax) * 0.5f;
+        }
+        for (const Texture& texture : this->textures)
+            alphaTested = alphaTested || texture.type == "texture_opacity";
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // binds the mesh's textures to consecutive units and points the samplers at them
+    void BindTextures(Shader &shader) const
     {
-        // bind appropriate textures
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        unsigned int opacityNr  = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,65 +93,21 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
+            else if(name == "texture_opacity")
+                number = std::to_string(opacityNr++);
 
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            shader.setInt(glslIdentifierPrefix + name + number, i);
+            // and finally bind the texture, skipped if the unit already holds it
+            rg::GLState::instance().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
         }
-
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
-
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // draws one level of the mesh's range of the shared index buffer, the Model's VAO must be bound
+    void DrawElements(unsigned int lod = 0) const
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        glDrawElementsBaseVertex(GL_TRIANGLES, lods[lod].indexCount, GL_UNSIGNED_INT,
+                                 (void*) ((firstIndex + lods[lod].firstIndex) * sizeof(unsigned int)), baseVertex);
     }
 };
-#endif
\ No newline at end of file
+#endif
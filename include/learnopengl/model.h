@@ -12,7 +12,11 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/DrawBatcher.h>
+#include <rg/TextureRegistry.h>
 
+#include <algorithm>
+#include <cfloat>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -23,28 +27,160 @@ using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
-
+// one aiNode, kept so parts of a model can be moved without touching vertex data
+struct ModelNode {
+    string name;
+    int parent;                       // index into Model::nodes, -1 for the root. parents always come before their children
+    glm::mat4 bind;                   // local transform as loaded from the file
+    glm::mat4 local;                  // current local transform, bind unless the node is animated
+    glm::mat4 world;                  // cached parent world * local, relative to the model
+    unsigned int firstMesh;           // meshes[firstMesh, firstMesh + meshCount) hang off this node
+    unsigned int meshCount;
+    glm::vec3 boundsMin, boundsMax;   // of the node's own meshes, in node space
+    bool dirty;
+};
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// every texture reference this model holds in the registry, released with the model.
     vector<Mesh>    meshes;
+    vector<ModelNode> nodes;            // the node tree flattened depth first
+    vector<unsigned int> drawOrder;     // mesh indices sorted by material, then node
+    // every mesh of the model packed into one vertex and one index buffer
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
     string directory;
     bool gammaCorrection;
+    unsigned int lodLevels;             // levels of detail generated per mesh at load, 1 for none
+    // sphere around the whole model in its bind pose, for picking levels of detail
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, unsigned int lods = 4) : gammaCorrection(gamma), lodLevels(lods)
     {
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // the textures are shared through rg::TextureRegistry, a copy would release them twice
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    ~Model()
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        for (const Texture& texture : textures_loaded)
+            rg::TextureRegistry::instance().release(texture.id);
+        if (VAO)
+            rg::GLState::instance().bindVertexArray(0);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+
+    // draws the model, and thus all its meshes, each with model * its node's world transform.
+    // one VAO bind for the whole model, textures are only rebound when the material changes.
+    void Draw(Shader &shader, const glm::mat4 &model)
+    {
+        if (!VAO)
+            return;
+        updateNodes();
+        rg::GLState::instance().bindVertexArray(VAO);
+        const glm::mat4 *uploaded = nullptr;
+        const Mesh *bound = nullptr;
+        for (unsigned int index : drawOrder)
+        {
+            const Mesh& mesh = meshes[index];
+            const glm::mat4& world = nodes[mesh.node].world;
+            // most nodes share a transform, only upload when it changes
+            if (!uploaded || world != *uploaded)
+            {
+                shader.setMat4("model", model * world);
+                uploaded = &world;
+            }
+            if (!bound || mesh.material != bound->material)
+            {
+                mesh.BindTextures(shader);
+                bound = &mesh;
+            }
+            mesh.DrawElements();
+        }
+    }
+
+    // queues every mesh with the batcher instead of drawing it, the shader must be built with DRAW_DATA.
+    // with a lodView each mesh is drawn at the coarsest level whose error stays under its pixel limit,
+    // measured where this instance's bounding sphere is closest to the eye.
+    void Submit(rg::DrawBatcher &batcher, Shader &shader, const glm::mat4 &model, const rg::LodView *lodView = nullptr)
+    {
+        if (!VAO)
+            return;
+        updateNodes();
+        float pixelsPerUnit = 0.0f;
+        if (lodView)
+            pixelsPerUnit = lodView->pixelsPerUnit(glm::vec3(model * glm::vec4(boundsCenter, 1.0f)), boundsRadius * rg::maxScale(model));
+        const glm::mat4 *world = nullptr;
+        glm::mat4 transform;
+        float errorToPixels = 0.0f;
+        for (unsigned int index : drawOrder)
+        {
+            const Mesh& mesh = meshes[index];
+            if (!world || nodes[mesh.node].world != *world)
+            {
+                world = &nodes[mesh.node].world;
+                transform = model * *world;
+                errorToPixels = pixelsPerUnit * rg::maxScale(transform);
+            }
+            unsigned int lod = lodView ? rg::selectLod(mesh.lods, errorToPixels, lodView->maxPixelError) : 0;
+            batcher.submit(shader, VAO, mesh, transform, lod);
+        }
+    }
+
+    // index of the first node with that name, -1 if there is none
+    int FindNode(const string &name) const
+    {
+        for (unsigned int i = 0; i < nodes.size(); i++)
+            if (nodes[i].name == name)
+                return (int) i;
+        return -1;
+    }
+
+    // replaces a node's local transform, its subtree is recomputed on the next updateNodes()
+    void SetNodeTransform(int index, const glm::mat4 &local)
+    {
+        nodes[index].local = local;
+        nodes[index].dirty = true;
+        firstDirtyNode = std::min(firstDirtyNode, (unsigned int) index);
+    }
+
+    // turns a node about an axis through the center of its own geometry, for
+    // parts like rotors whose vertices are baked in model space
+    void RotateNode(int index, float angle, const glm::vec3 &axis)
+    {
+        const ModelNode& node = nodes[index];
+        glm::vec3 pivot = (node.boundsMin + node.boundsMax) * 0.5f;
+        glm::mat4 local = glm::translate(node.bind, pivot);
+        local = glm::rotate(local, angle, axis);
+        SetNodeTransform(index, glm::translate(local, -pivot));
+    }
+
+    // Brings the cached world transforms up to date. Nodes are stored parents
+    // first, so one pass from the first changed node reaches every descendant.
+    void updateNodes()
+    {
+        if (firstDirtyNode >= nodes.size())
+            return;
+        std::vector<bool> changed(nodes.size(), false);
+        for (unsigned int i = firstDirtyNode; i < nodes.size(); i++)
+        {
+            ModelNode& node = nodes[i];
+            bool parentChanged = node.parent >= 0 && changed[node.parent];
+            if (!node.dirty && !parentChanged)
+                continue;
+            node.world = node.parent >= 0 ? nodes[node.parent].world * node.local : node.local;
+            node.dirty = false;
+            changed[i] = true;
+        }
+        firstDirtyNode = (unsigned int) nodes.size();
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
@@ -53,6 +189,8 @@ public:
         }
     }
 private:
+    unsigned int firstDirtyNode = 0;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
@@ -69,28 +207,178 @@ private:
         directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, -1);
+        firstDirtyNode = 0;
+        updateNodes();
+        computeBounds();
+        for (Mesh& mesh : meshes)
+            buildLods(mesh);
+        setupBuffers();
+    }
+
+    // Simplifies the mesh into lodLevels - 1 coarser levels, appended to its
+    // own indices so they end up in the same index buffer. Normals and uvs
+    // weigh in on the error, so seams and creases go last.
+    void buildLods(Mesh &mesh)
+    {
+        static const float attributeWeights[5] = { 0.02f, 0.02f, 0.02f, 0.1f, 0.1f };
+        if (mesh.vertices.empty() || lodLevels < 2)
+            return;
+        rg::SimplifyMesh simplify;
+        simplify.positions = &mesh.vertices[0].Position.x;
+        simplify.attributes = &mesh.vertices[0].Normal.x;   // Normal and TexCoords are adjacent
+        simplify.attributeWeights = attributeWeights;
+        simplify.attributeCount = 5;
+        simplify.vertexCount = mesh.vertices.size();
+        simplify.stride = sizeof(Vertex);
+        mesh.lods = rg::buildLodChain(simplify, mesh.indices, lodLevels);
+    }
+
+    // a box around every node's bounds in its bind pose world transform, then the sphere around the box
+    void computeBounds()
+    {
+        glm::vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+        for (const ModelNode& node : nodes)
+        {
+            if (!node.meshCount)
+                continue;
+            for (int corner = 0; corner < 8; corner++)
+            {
+                glm::vec3 local((corner & 1) ? node.boundsMax.x : node.boundsMin.x,
+                                (corner & 2) ? node.boundsMax.y : node.boundsMin.y,
+                                (corner & 4) ? node.boundsMax.z : node.boundsMin.z);
+                glm::vec3 position = glm::vec3(node.world * glm::vec4(local, 1.0f));
+                boxMin = glm::min(boxMin, position);
+                boxMax = glm::max(boxMax, position);
+            }
+        }
+        if (boxMin.x > boxMax.x)
+            return;
+        boundsCenter = (boxMin + boxMax) * 0.5f;
+        boundsRadius = glm::length(boxMax - boundsCenter);
+    }
+
+    // Packs every mesh into one VBO/EBO. Indices stay relative to their mesh,
+    // each mesh is drawn with its own base vertex and first index.
+    void setupBuffers()
+    {
+        if (meshes.empty())
+            return;
+        size_t vertexCount = 0, indexCount = 0;
+        vector<vector<unsigned int>> materials;
+        for (Mesh& mesh : meshes)
+        {
+            mesh.baseVertex = vertexCount;
+            mesh.firstIndex = indexCount;
+            vertexCount += mesh.vertices.size();
+            indexCount += mesh.indices.size();
+
+            vector<unsigned int> textureIds;
+            for (const Texture& texture : mesh.textures)
+                textureIds.push_back(texture.id);
+            auto found = std::find(materials.begin(), materials.end(), textureIds);
+            mesh.material = found - materials.begin();
+            if (found == materials.end())
+                materials.push_back(textureIds);
+        }
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            drawOrder.push_back(i);
+        std::stable_sort(drawOrder.begin(), drawOrder.end(), [this](unsigned int a, unsigned int b) {
+            return meshes[a].material != meshes[b].material ? meshes[a].material < meshes[b].material
+                                                            : meshes[a].node < meshes[b].node;
+        });
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        rg::GLState::instance().bindVertexArray(VAO);
+        GLLABEL(GL_VERTEX_ARRAY, VAO, directory);
+        // A great thing about structs is that their memory layout is sequential for all its items.
+        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+        // again translates to 3/2 floats which translates to a byte array.
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+        GLLABEL(GL_BUFFER, VBO, directory + " vertices");
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+        GLLABEL(GL_BUFFER, EBO, directory + " indices");
+        for (const Mesh& mesh : meshes)
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, mesh.baseVertex * sizeof(Vertex), mesh.vertices.size() * sizeof(Vertex), mesh.vertices.data());
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, mesh.firstIndex * sizeof(unsigned int), mesh.indices.size() * sizeof(unsigned int), mesh.indices.data());
+        }
+
+        // set the vertex attribute pointers
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        // vertex bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+
+        rg::GLState::instance().bindVertexArray(0);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    void processNode(aiNode *node, const aiScene *scene, int parent)
     {
+        ModelNode modelNode;
+        modelNode.name = node->mName.C_Str();
+        modelNode.parent = parent;
+        modelNode.bind = modelNode.local = modelNode.world = toMat4(node->mTransformation);
+        modelNode.firstMesh = meshes.size();
+        modelNode.meshCount = node->mNumMeshes;
+        modelNode.dirty = true;
+        int index = nodes.size();
+
         // process each mesh located at the current node
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
             meshes.push_back(processMesh(mesh, scene));
+            meshes.back().node = index;
+            for (const Vertex& vertex : meshes.back().vertices)
+            {
+                boundsMin = glm::min(boundsMin, vertex.Position);
+                boundsMax = glm::max(boundsMax, vertex.Position);
+            }
         }
+        bool empty = meshes.size() == modelNode.firstMesh || boundsMin.x > boundsMax.x;
+        modelNode.boundsMin = empty ? glm::vec3(0.0f) : boundsMin;
+        modelNode.boundsMax = empty ? glm::vec3(0.0f) : boundsMax;
+        nodes.push_back(modelNode);
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, index);
         }
 
     }
 
+    // assimp matrices are row major, glm's are column major
+    static glm::mat4 toMat4(const aiMatrix4x4 &m)
+    {
+        glm::mat4 result;
+        result[0][0] = m.a1; result[1][0] = m.a2; result[2][0] = m.a3; result[3][0] = m.a4;
+        result[0][1] = m.b1; result[1][1] = m.b2; result[2][1] = m.b3; result[3][1] = m.b4;
+        result[0][2] = m.c1; result[1][2] = m.c2; result[2][2] = m.c3; result[3][2] = m.c4;
+        result[0][3] = m.d1; result[1][3] = m.d2; result[2][3] = m.d3; result[3][3] = m.d4;
+        return result;
+    }
+
     Mesh processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
@@ -175,6 +463,9 @@ private:
         // 4. height maps
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        // 5. opacity maps (map_d), the mesh becomes alpha tested
+        std::vector<Texture> opacityMaps = loadMaterialTextures(material, aiTextureType_OPACITY, "texture_opacity");
+        textures.insert(textures.end(), opacityMaps.begin(), opacityMaps.end());
 
 
 
@@ -182,7 +473,8 @@ private:
         return Mesh(vertices, indices, textures);
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
+    // gets all material textures of a given type from the texture registry, which only loads
+    // the ones no model (or loadTexture call) has loaded before.
     // the required info is returned as a Texture struct.
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
@@ -191,26 +483,12 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.id = TextureFromFile(str.C_Str(), this->directory);
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+            textures_loaded.push_back(texture);  // one entry per registry reference, so the destructor releases each of them
         }
         return textures;
     }
@@ -222,38 +500,9 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    // decoded and uploaded in the background, a placeholder is bound until then
+    rg::TextureParams params;
+    params.gammaCorrection = gamma;
+    return rg::TextureRegistry::instance().acquire(filename, params);
 }
 #endif
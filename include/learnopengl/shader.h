@@ -8,24 +8,219 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include <common.h>
+#include <rg/Error.h>
+#include <rg/GLState.h>
+#include <rg/ProgramCache.h>
 class Shader
 {
 public:
     unsigned int ID;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string& defines = "")
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath ? geometryPath : ""), defines(defines)
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
-
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
+        std::string vertexCode, fragmentCode, geometryCode;
+        readSources(vertexCode, fragmentCode, geometryCode);
+
+        // 2. try the program binary cache before compiling anything
+        rg::ProgramCache& cache = rg::ProgramCache::instance();
+        uint64_t cacheKey = cache.key(vertexCode, fragmentCode, geometryCode, defines);
+        ID = glCreateProgram();
+        GLLABEL(GL_PROGRAM, ID, this->vertexPath + " + " + this->fragmentPath);
+        if(cache.load(cacheKey, ID))
+            return;
+
+        // 3. compile and link, the program is usable right after the constructor
+        startProgram(ID, vertexCode, fragmentCode, geometryCode);
+        if(checkProgram(ID))
+            cache.store(cacheKey, ID);
+    }
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    // source files this program was built from, used by the hot-reload watcher
+    // ------------------------------------------------------------------------
+    bool dependsOn(const std::string& path) const
+    {
+        return path == vertexPath || path == fragmentPath || path == geometryPath;
+    }
+    // Recompiles from the current sources without blocking: the new program is
+    // swapped in by pollReload() once the driver reports it done. Until then,
+    // and for good if compilation fails, the old program keeps rendering.
+    // ------------------------------------------------------------------------
+    void reload()
+    {
+        if(pendingID != 0)
+            glDeleteProgram(pendingID);
+        std::string vertexCode, fragmentCode, geometryCode;
+        if(!readSources(vertexCode, fragmentCode, geometryCode))
+        {
+            pendingID = 0;
+            return;
+        }
+        pendingKey = rg::ProgramCache::instance().key(vertexCode, fragmentCode, geometryCode, defines);
+        pendingID = glCreateProgram();
+        startProgram(pendingID, vertexCode, fragmentCode, geometryCode);
+    }
+    // returns true when a reloaded program replaced the current one this call
+    bool pollReload()
+    {
+        if(pendingID == 0)
+            return false;
+        if(GLAD_GL_KHR_parallel_shader_compile)
+        {
+            GLint done = GL_FALSE;
+            glGetProgramiv(pendingID, GL_COMPLETION_STATUS_KHR, &done);
+            if(!done)
+                return false;
+        }
+        unsigned int program = pendingID;
+        pendingID = 0;
+        if(!checkProgram(program))
+        {
+            std::cout << "Shader reload failed, keeping the previous program: " << fragmentPath << std::endl;
+            glDeleteProgram(program);
+            return false;
+        }
+        rg::ProgramCache::instance().store(pendingKey, program);
+
+        rg::GLState& state = rg::GLState::instance();
+        GLuint current = state.program();
+        unsigned int previous = ID;
+        ID = program;
+        GLLABEL(GL_PROGRAM, ID, vertexPath + " + " + fragmentPath);
+        locations.clear();
+        // uniforms set once at startup (light colors, sampler units, ...) live in the old program only
+        state.useProgram(ID);
+        for(auto& entry : uniforms)
+            applyUniform(location(entry.first), entry.second);
+        state.useProgram(current == previous ? ID : current);
+        glDeleteProgram(previous);
+        std::cout << "Shader reloaded: " << vertexPath << ", " << fragmentPath << std::endl;
+        return true;
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use()
+    {
+        rg::GLState::instance().useProgram(ID);
+    }
+    // utility uniform functions
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value) const
+    {
+        setUniform(name, Uniform::Int, nullptr, (int)value);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(const std::string &name, int value) const
+    {
+        setUniform(name, Uniform::Int, nullptr, value);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const std::string &name, float value) const
+    {
+        setUniform(name, Uniform::Float, &value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(const std::string &name, const glm::vec2 &value) const
+    {
+        setUniform(name, Uniform::Vec2, &value[0]);
+    }
+    void setVec2(const std::string &name, float x, float y) const
+    {
+        setVec2(name, glm::vec2(x, y));
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(const std::string &name, const glm::vec3 &value) const
+    {
+        setUniform(name, Uniform::Vec3, &value[0]);
+    }
+    void setVec3(const std::string &name, float x, float y, float z) const
+    {
+        setVec3(name, glm::vec3(x, y, z));
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(const std::string &name, const glm::vec4 &value) const
+    {
+        setUniform(name, Uniform::Vec4, &value[0]);
+    }
+    void setVec4(const std::string &name, float x, float y, float z, float w)
+    {
+        setVec4(name, glm::vec4(x, y, z, w));
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    {
+        setUniform(name, Uniform::Mat2, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    {
+        setUniform(name, Uniform::Mat3, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    {
+        setUniform(name, Uniform::Mat4, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    GLint location(const std::string &name) const
+    {
+        auto it = locations.find(name);
+        if(it != locations.end())
+            return it->second;
+        GLint loc = glGetUniformLocation(ID, name.c_str());
+        locations.emplace(name, loc);
+        return loc;
+    }
+
+private:
+    struct Uniform {
+        enum Type { Int, Float, Vec2, Vec3, Vec4, Mat2, Mat3, Mat4 } type;
+        int i;
+        float f[16];
+    };
+
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::string geometryPath;
+    std::string defines;
+    unsigned int pendingID = 0;
+    uint64_t pendingKey = 0;
+    // last value of every uniform, replayed into the program after a reload
+    mutable std::unordered_map<std::string, Uniform> uniforms;
+    mutable std::unordered_map<std::string, GLint> locations;
+
+    void setUniform(const std::string &name, Uniform::Type type, const float* data, int i = 0) const
+    {
+        static const int sizes[] = { 0, 1, 2, 3, 4, 4, 9, 16 };
+        Uniform& u = uniforms[name];
+        u.type = type;
+        u.i = i;
+        for(int k = 0; k < sizes[type]; k++)
+            u.f[k] = data[k];
+        applyUniform(location(name), u);
+    }
+    static void applyUniform(GLint loc, const Uniform& u)
+    {
+        switch(u.type)
+        {
+            case Uniform::Int: glUniform1i(loc, u.i); break;
+            case Uniform::Float: glUniform1f(loc, u.f[0]); break;
+            case Uniform::Vec2: glUniform2fv(loc, 1, u.f); break;
+            case Uniform::Vec3: glUniform3fv(loc, 1, u.f); break;
+            case Uniform::Vec4: glUniform4fv(loc, 1, u.f); break;
+            case Uniform::Mat2: glUniformMatrix2fv(loc, 1, GL_FALSE, u.f); break;
+            case Uniform::Mat3: glUniformMatrix3fv(loc, 1, GL_FALSE, u.f); break;
+            case Uniform::Mat4: glUniformMatrix4fv(loc, 1, GL_FALSE, u.f); break;
+        }
+    }
+    bool readSources(std::string& vertexCode, std::string& fragmentCode, std::string& geometryCode) const
+    {
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -33,7 +228,7 @@ public:
         vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
+        try
         {
             // open files
             vShaderFile.open(vertexPath);
@@ -41,137 +236,101 @@ public:
             std::stringstream vShaderStream, fShaderStream;
             // read file's buffer contents into streams
             vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
+            fShaderStream << fShaderFile.rdbuf();
             // close file handlers
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            vertexCode = injectDefines(vShaderStream.str(), defines);
+            fragmentCode = injectDefines(fShaderStream.str(), defines);
             // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
+            if(!geometryPath.empty())
             {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
                 gShaderFile.open(geometryPath);
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = injectDefines(gShaderStream.str(), defines);
             }
         }
         catch (std::ifstream::failure& e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            return false;
         }
+        return true;
+    }
+    // compiles the stages and issues the link; with parallel shader compile
+    // the status queries are what actually wait, so they are left to the caller
+    void startProgram(unsigned int program, const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode)
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        unsigned int geometry = 0;
+        if(!geometryPath.empty())
         {
             const char * gShaderCode = geometryCode.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, NULL);
             glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        if(geometry != 0)
+            glAttachShader(program, geometry);
+        if(rg::ProgramCache::instance().available())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        // only flagged for deletion while attached, checkProgram() can still read their logs
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-        if(geometryPath != nullptr)
+        if(geometry != 0)
             glDeleteShader(geometry);
-
-    }
-    // activate the shader
-    // ------------------------------------------------------------------------
-    void use() 
-    { 
-        glUseProgram(ID); 
-    }
-    // utility uniform functions
-    // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
-    }
-    // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-    // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-    // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
     }
+    // defines go right after the #version line, which has to stay first
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
-    }
-    // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
-    }
-    // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    static std::string injectDefines(const std::string& code, const std::string& defines)
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        if(defines.empty())
+            return code;
+        size_t lineEnd = 0;
+        if(code.compare(0, 8, "#version") == 0)
+            lineEnd = code.find('\n') + 1;
+        return code.substr(0, lineEnd) + defines + code.substr(lineEnd);
     }
+    // link status of a program, printing the attached stages' logs on failure
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    static bool checkProgram(GLuint program)
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
-    // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
-    {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if(linked)
+            return true;
+        GLuint stages[3];
+        GLsizei count = 0;
+        glGetAttachedShaders(program, 3, &count, stages);
+        for(GLsizei i = 0; i < count; i++)
+        {
+            GLint type = 0;
+            glGetShaderiv(stages[i], GL_SHADER_TYPE, &type);
+            checkCompileErrors(stages[i], type == GL_VERTEX_SHADER ? "VERTEX" : type == GL_FRAGMENT_SHADER ? "FRAGMENT" : "GEOMETRY");
+        }
+        return checkCompileErrors(program, "PROGRAM");
     }
-
-private:
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -193,6 +352,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
 #endif
@@ -0,0 +1,179 @@
+#ifndef PROJECT_BASE_AUTOEXPOSURE_H
+#define PROJECT_BASE_AUTOEXPOSURE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace rg {
+
+struct ExposureSettings {
+    float minLog = -8.0f;          // log2 luminance of the first and past the last histogram bin
+    float maxLog = 4.0f;
+    float lowPercent = 0.5f;       // the darkest half and the brightest 5% do not count
+    float highPercent = 0.95f;
+    float key = 0.18f;             // the average luminance is mapped to this
+    float compensation = 0.0f;     // in stops, added to the metered exposure
+    float minExposure = 0.05f;
+    float maxExposure = 8.0f;
+    float speedUp = 3.0f;          // adaptation rates per second, towards brighter and darker images
+    float speedDown = 1.0f;
+};
+
+// Exposure metered from a luminance histogram, all on the GPU so nothing
+// waits on a readback. The HDR image is reduced to an eighth of its size in
+// log2 luminance, every texel of that is drawn as a point into the bin of a
+// 64 x 1 float target with additive blending (GL 3.3 has no compute shaders
+// or image atomics), and a 1 x 1 pass averages the bins between two
+// percentiles and moves last frame's exposure towards key / average. The
+// exposure stays in a 1 x 1 texture that the tone mapping pass reads.
+class AutoExposure {
+public:
+    static const int Bins = 64;
+    static const int Downsample = 8;
+    // bloom_final.fs reads the exposure here, after the scene and the bloom
+    static const GLuint Unit = 2;
+
+    AutoExposure(int width, int height)
+            : m_Width(std::max(width / Downsample, 1)), m_Height(std::max(height / Downsample, 1)) {
+        GLState& gl = GLState::instance();
+        glGenTextures(4, m_Textures);
+        glGenFramebuffers(4, m_Framebuffers);
+        const char* names[4] = { "exposure luminance", "exposure histogram", "exposure", "exposure" };
+        const float initial = 0.5f;
+        for (int i = 0; i < 4; ++i) {
+            const GLsizei w = i == Luminance ? m_Width : i == Histogram ? (GLsizei) Bins : 1;
+            const GLsizei h = i == Luminance ? m_Height : 1;
+            gl.bindTexture(0, GL_TEXTURE_2D, m_Textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, i == Luminance ? GL_R16F : GL_R32F, w, h, 0, GL_RED, GL_FLOAT,
+                         i >= Exposure ? &initial : nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Textures[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cout << "Auto exposure: framebuffer not complete" << std::endl;
+            }
+            GLLABEL(GL_TEXTURE, m_Textures[i], names[i]);
+            GLLABEL(GL_FRAMEBUFFER, m_Framebuffers[i], names[i]);
+        }
+        gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        gl.bindTexture(0, GL_TEXTURE_2D, 0);
+        // the histogram's points have no attributes, gl_VertexID picks the texel
+        glGenVertexArrays(1, &m_EmptyVAO);
+    }
+
+    AutoExposure(const AutoExposure&) = delete;
+    AutoExposure& operator=(const AutoExposure&) = delete;
+
+    ~AutoExposure() {
+        GLState& gl = GLState::instance();
+        for (int i = 0; i < 4; ++i) {
+            gl.forgetFramebuffer(m_Framebuffers[i]);
+            gl.forgetTexture(m_Textures[i]);
+        }
+        glDeleteFramebuffers(4, m_Framebuffers);
+        glDeleteTextures(4, m_Textures);
+        glDeleteVertexArrays(1, &m_EmptyVAO);
+    }
+
+    ExposureSettings& settings() {
+        return m_Settings;
+    }
+
+    // Meters sceneTexture (linear HDR color) and adapts the exposure by
+    // deltaTime seconds. drawQuad() draws a screen filling quad with
+    // positions and texture coordinates in attributes 0 and 1.
+    template <typename DrawQuad>
+    void update(GLuint sceneTexture, float deltaTime, Shader& luminanceShader, Shader& histogramShader,
+                Shader& adaptShader, DrawQuad drawQuad) {
+        GLState& gl = GLState::instance();
+        const GLState::Snapshot saved = gl.save();
+        GLGROUP("Auto exposure");
+        gl.disable(GL_DEPTH_TEST);
+        gl.disable(GL_BLEND);
+
+        gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[Luminance]);
+        gl.viewport(0, 0, m_Width, m_Height);
+        luminanceShader.use();
+        luminanceShader.setInt("scene", 0);
+        gl.bindTexture(0, GL_TEXTURE_2D, sceneTexture);
+        drawQuad();
+
+        gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[Histogram]);
+        gl.viewport(0, 0, Bins, 1);
+        const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, zero);
+        gl.enable(GL_BLEND);
+        gl.blendFunc(GL_ONE, GL_ONE);
+        histogramShader.use();
+        histogramShader.setInt("luminance", 0);
+        histogramShader.setFloat("minLog", m_Settings.minLog);
+        histogramShader.setFloat("maxLog", m_Settings.maxLog);
+        histogramShader.setInt("bins", Bins);
+        gl.bindTexture(0, GL_TEXTURE_2D, m_Textures[Luminance]);
+        gl.bindVertexArray(m_EmptyVAO);
+        glDrawArrays(GL_POINTS, 0, m_Width * m_Height);
+        gl.disable(GL_BLEND);
+
+        // last frame's exposure in, this frame's into the other texture
+        m_Current = 1 - m_Current;
+        gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[Exposure + m_Current]);
+        gl.viewport(0, 0, 1, 1);
+        adaptShader.use();
+        adaptShader.setInt("histogram", 0);
+        adaptShader.setInt("previous", 1);
+        adaptShader.setInt("bins", Bins);
+        adaptShader.setFloat("minLog", m_Settings.minLog);
+        adaptShader.setFloat("maxLog", m_Settings.maxLog);
+        adaptShader.setFloat("lowPercent", m_Settings.lowPercent);
+        adaptShader.setFloat("highPercent", m_Settings.highPercent);
+        adaptShader.setFloat("key", m_Settings.key * std::exp2(m_Settings.compensation));
+        adaptShader.setFloat("minExposure", m_Settings.minExposure);
+        adaptShader.setFloat("maxExposure", m_Settings.maxExposure);
+        // the share of the way to the target covered this frame, the same whatever the frame rate
+        adaptShader.setFloat("adaptUp", 1.0f - std::exp(-deltaTime * m_Settings.speedUp));
+        adaptShader.setFloat("adaptDown", 1.0f - std::exp(-deltaTime * m_Settings.speedDown));
+        gl.bindTexture(0, GL_TEXTURE_2D, m_Textures[Histogram]);
+        gl.bindTexture(1, GL_TEXTURE_2D, m_Textures[Exposure + 1 - m_Current]);
+        drawQuad();
+        gl.restore(saved);
+    }
+
+    // Binds this frame's exposure for the tone mapping shader; its sampler
+    // is set by setSamplers once.
+    void bind() const {
+        GLState::instance().bindTexture(Unit, GL_TEXTURE_2D, m_Textures[Exposure + m_Current]);
+    }
+
+    static void setSamplers(Shader& shader) {
+        shader.setInt("exposure", Unit);
+    }
+
+private:
+    // indices into the textures and framebuffers; the exposure is double buffered
+    enum Target {
+        Luminance = 0,
+        Histogram = 1,
+        Exposure = 2
+    };
+
+    int m_Width, m_Height;
+    GLuint m_Textures[4] = { 0, 0, 0, 0 };
+    GLuint m_Framebuffers[4] = { 0, 0, 0, 0 };
+    GLuint m_EmptyVAO = 0;
+    int m_Current = 0;
+    ExposureSettings m_Settings;
+};
+
+}
+
+#endif //PROJECT_BASE_AUTOEXPOSURE_H
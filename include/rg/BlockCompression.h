@@ -0,0 +1,189 @@
+#ifndef PROJECT_BASE_BLOCKCOMPRESSION_H
+#define PROJECT_BASE_BLOCKCOMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace rg {
+
+// CPU encoders for the BC1 (DXT1), BC3 (DXT5) and BC5 (RGTC2) block formats.
+// Endpoints come from the principal axis of each 4x4 block; quality is roughly
+// that of a "fast" preset in the usual offline compressors, which is plenty for
+// the diffuse maps in resources/.
+namespace bc {
+
+inline uint16_t pack565(const float c[3]) {
+    int r = std::min(31, std::max(0, (int) (c[0] * 31.0f / 255.0f + 0.5f)));
+    int g = std::min(63, std::max(0, (int) (c[1] * 63.0f / 255.0f + 0.5f)));
+    int b = std::min(31, std::max(0, (int) (c[2] * 31.0f / 255.0f + 0.5f)));
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+inline void unpack565(uint16_t v, float c[3]) {
+    c[0] = (float) (((v >> 11) & 31) * 255 / 31);
+    c[1] = (float) (((v >> 5) & 63) * 255 / 63);
+    c[2] = (float) ((v & 31) * 255 / 31);
+}
+
+// 16 RGB pixels (stride 4 bytes) -> 8 bytes, always in four color mode
+inline void encodeColorBlock(const unsigned char rgba[16][4], unsigned char out[8]) {
+    float mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            mean[c] += rgba[i][c] / 16.0f;
+        }
+    }
+    float cov[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < 16; ++i) {
+        float d[3] = { rgba[i][0] - mean[0], rgba[i][1] - mean[1], rgba[i][2] - mean[2] };
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+    // power iteration for the dominant eigenvector
+    float axis[3] = { 1, 1, 1 };
+    for (int it = 0; it < 8; ++it) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float m = std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+        if (m < 1e-6f) {
+            break;
+        }
+        axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+    }
+    float axisLen2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float minT = 0, maxT = 0;
+    for (int i = 0; i < 16; ++i) {
+        float t = ((rgba[i][0] - mean[0]) * axis[0] + (rgba[i][1] - mean[1]) * axis[1] + (rgba[i][2] - mean[2]) * axis[2]) / axisLen2;
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; ++c) {
+        e0[c] = mean[c] + axis[c] * maxT;
+        e1[c] = mean[c] + axis[c] * minT;
+    }
+    uint16_t c0 = pack565(e0), c1 = pack565(e1);
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        float palette[4][3];
+        unpack565(c0, palette[0]);
+        unpack565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; ++i) {
+            int best = 0;
+            float bestDist = 1e30f;
+            for (int p = 0; p < 4; ++p) {
+                float dr = rgba[i][0] - palette[p][0], dg = rgba[i][1] - palette[p][1], db = rgba[i][2] - palette[p][2];
+                float dist = dr * dr + dg * dg + db * db;
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t) best << (2 * i);
+        }
+    }
+    out[0] = c0 & 0xff; out[1] = c0 >> 8;
+    out[2] = c1 & 0xff; out[3] = c1 >> 8;
+    out[4] = indices & 0xff; out[5] = (indices >> 8) & 0xff;
+    out[6] = (indices >> 16) & 0xff; out[7] = indices >> 24;
+}
+
+// 16 single channel values -> 8 bytes (BC4 layout, eight value mode)
+inline void encodeAlphaBlock(const unsigned char values[16], unsigned char out[8]) {
+    unsigned char a0 = *std::max_element(values, values + 16);
+    unsigned char a1 = *std::min_element(values, values + 16);
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        int palette[8] = { a0, a1 };
+        for (int i = 1; i < 7; ++i) {
+            palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+        }
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDist = 256;
+            for (int p = 0; p < 8; ++p) {
+                int dist = std::abs(values[i] - palette[p]);
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t) best << (3 * i);
+        }
+    }
+    out[0] = a0;
+    out[1] = a1;
+    for (int i = 0; i < 6; ++i) {
+        out[2 + i] = (indices >> (8 * i)) & 0xff;
+    }
+}
+
+}
+
+enum class BlockFormat {
+    BC1, // RGB, 8 bytes per block
+    BC3, // RGBA, 16 bytes per block
+    BC5  // RG, 16 bytes per block
+};
+
+inline size_t blockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+inline size_t compressedSize(BlockFormat format, int width, int height) {
+    return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+// Compresses one image level; edge blocks repeat the last row/column.
+inline std::vector<unsigned char> compressLevel(BlockFormat format, const unsigned char* pixels,
+                                                int width, int height, int channels) {
+    std::vector<unsigned char> out(compressedSize(format, width, height));
+    unsigned char* dst = out.data();
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            unsigned char block[16][4];
+            for (int i = 0; i < 16; ++i) {
+                int x = std::min(bx + i % 4, width - 1);
+                int y = std::min(by + i / 4, height - 1);
+                const unsigned char* p = pixels + ((size_t) y * width + x) * channels;
+                for (int c = 0; c < 4; ++c) {
+                    block[i][c] = c < channels ? p[c] : (c == 3 ? 255 : p[0]);
+                }
+            }
+            unsigned char channel[16];
+            switch (format) {
+                case BlockFormat::BC1:
+                    bc::encodeColorBlock(block, dst);
+                    break;
+                case BlockFormat::BC3:
+                    for (int i = 0; i < 16; ++i) channel[i] = block[i][3];
+                    bc::encodeAlphaBlock(channel, dst);
+                    bc::encodeColorBlock(block, dst + 8);
+                    break;
+                case BlockFormat::BC5:
+                    for (int i = 0; i < 16; ++i) channel[i] = block[i][0];
+                    bc::encodeAlphaBlock(channel, dst);
+                    for (int i = 0; i < 16; ++i) channel[i] = block[i][1];
+                    bc::encodeAlphaBlock(channel, dst + 8);
+                    break;
+            }
+            dst += blockBytes(format);
+        }
+    }
+    return out;
+}
+
+}
+
+#endif //PROJECT_BASE_BLOCKCOMPRESSION_H
@@ -0,0 +1,176 @@
+#ifndef PROJECT_BASE_CASCADEDSHADOWMAP_H
+#define PROJECT_BASE_CASCADEDSHADOWMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/GLState.h>
+#include <rg/ShadowCascades.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace rg {
+
+// Cascaded shadow map of the directional light. Every cascade has two depth
+// layers: static casters (the island, anything that never moves) and dynamic
+// ones (orbiting instances, spinning parts). The static layer is a cache that
+// is only redrawn when its cascade moves a snapping step or invalidate() is
+// called; the dynamic layer is cleared and redrawn every frame. Receivers test
+// against both and are lit only where neither has a closer caster.
+class CascadedShadowMap {
+public:
+    enum Layer {
+        Static = 0,
+        Dynamic = 1
+    };
+
+    struct Stats {
+        unsigned int staticLayers = 0;    // static layers redrawn this frame
+        unsigned int staticCasters = 0;
+        unsigned int dynamicCasters = 0;
+    };
+
+    // below rg::DrawBatcher::DrawDataUnit, above the units meshes bind their maps to
+    static const GLuint StaticUnit = 13;
+    static const GLuint DynamicUnit = 14;
+
+    explicit CascadedShadowMap(const ShadowSettings& settings = ShadowSettings()) : m_Settings(settings) {
+        m_Settings.cascades = std::min(std::max(m_Settings.cascades, 1u), (unsigned int) ShadowCascades::MaxCascades);
+        GLState& gl = GLState::instance();
+        glGenTextures(2, m_Layers);
+        const float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (GLuint texture : m_Layers) {
+            gl.bindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_Settings.resolution, m_Settings.resolution,
+                         m_Settings.cascades, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            // hardware 2x2 PCF on every lookup
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+            // outside the map is lit
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+            glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        }
+        gl.bindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+        GLLABEL(GL_TEXTURE, m_Layers[Static], "shadow cascades static");
+        GLLABEL(GL_TEXTURE, m_Layers[Dynamic], "shadow cascades dynamic");
+
+        glGenFramebuffers(1, &m_Framebuffer);
+        gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Layers[Static], 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Shadows: framebuffer not complete" << std::endl;
+        }
+        gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLLABEL(GL_FRAMEBUFFER, m_Framebuffer, "shadow cascades");
+    }
+
+    CascadedShadowMap(const CascadedShadowMap&) = delete;
+    CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+    ~CascadedShadowMap() {
+        GLState& gl = GLState::instance();
+        gl.forgetFramebuffer(m_Framebuffer);
+        glDeleteFramebuffers(1, &m_Framebuffer);
+        for (GLuint texture : m_Layers) {
+            gl.forgetTexture(texture);
+        }
+        glDeleteTextures(2, m_Layers);
+    }
+
+    // World space box around every caster, static and dynamic; nothing
+    // outside it along the light casts a shadow. Invalidates the cache.
+    void setCasterBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        m_Cascades.setCasterBounds(boundsMin, boundsMax);
+        invalidate();
+    }
+
+    // the static layers are redrawn on the next render, e.g. once textures they cut out with have streamed in
+    void invalidate() {
+        m_StaticValid = 0;
+    }
+
+    // Fits the cascades to the camera and redraws what changed.
+    // drawCasters(cascade, layer) draws the casters of one layer that touch
+    // the cascade (its viewProjection is the light's clip space) and returns
+    // how many it drew; the framebuffer, viewport and depth state are set.
+    template <typename DrawCasters>
+    void render(const glm::vec3& eye, const glm::vec3& forward, float fovY, float aspect, float nearPlane,
+                const glm::vec3& lightDirection, DrawCasters drawCasters) {
+        m_Stats = Stats();
+        m_StaticValid &= ~m_Cascades.update(m_Settings, eye, forward, fovY, aspect, nearPlane, lightDirection);
+
+        GLState& gl = GLState::instance();
+        const GLState::Snapshot saved = gl.save();
+        GLGROUP("Shadow cascades");
+        gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        gl.viewport(0, 0, m_Settings.resolution, m_Settings.resolution);
+        gl.enable(GL_DEPTH_TEST);
+        gl.depthFunc(GL_LESS);
+        gl.depthMask(true);
+        gl.disable(GL_BLEND);
+        // slope scaled bias while rendering, the receivers add a normal offset
+        gl.enable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.5f, 2.0f);
+        for (unsigned int i = 0; i < m_Cascades.count(); ++i) {
+            if (!(m_StaticValid & (1u << i))) {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Layers[Static], 0, (GLint) i);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                m_Stats.staticCasters += drawCasters(m_Cascades.cascade(i), Static);
+                m_StaticValid |= 1u << i;
+                ++m_Stats.staticLayers;
+            }
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Layers[Dynamic], 0, (GLint) i);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            m_Stats.dynamicCasters += drawCasters(m_Cascades.cascade(i), Dynamic);
+        }
+        glPolygonOffset(0.0f, 0.0f);
+        gl.restore(saved);
+    }
+
+    // Binds the layers and sets the cascades on a shader that receives
+    // shadows (bloom.fs), which must be in use. Its samplers are set by
+    // setSamplers once, before the first draw.
+    void bind(Shader& shader) const {
+        GLState& gl = GLState::instance();
+        gl.bindTexture(StaticUnit, GL_TEXTURE_2D_ARRAY, m_Layers[Static]);
+        gl.bindTexture(DynamicUnit, GL_TEXTURE_2D_ARRAY, m_Layers[Dynamic]);
+        shader.setInt("cascadeCount", (int) m_Cascades.count());
+        for (unsigned int i = 0; i < m_Cascades.count(); ++i) {
+            const std::string index = "[" + std::to_string(i) + "]";
+            shader.setMat4("cascadeMatrices" + index, m_Cascades.cascade(i).viewProjection);
+            shader.setFloat("cascadeSplits" + index, m_Cascades.cascade(i).splitFar);
+            shader.setFloat("cascadeTexels" + index, m_Cascades.cascade(i).texelSize);
+        }
+    }
+
+    // The shadow samplers get units of their own even while shadows are off,
+    // a unit may not be read as two sampler types in one draw.
+    static void setSamplers(Shader& shader) {
+        shader.setInt("shadowStatic", StaticUnit);
+        shader.setInt("shadowDynamic", DynamicUnit);
+    }
+
+    const Stats& stats() const {
+        return m_Stats;
+    }
+
+private:
+    ShadowSettings m_Settings;
+    ShadowCascades m_Cascades;
+    unsigned int m_StaticValid = 0;   // a bit per cascade whose static layer matches its matrix
+    GLuint m_Layers[2] = { 0, 0 };    // indexed by Layer
+    GLuint m_Framebuffer = 0;
+    Stats m_Stats;
+};
+
+}
+
+#endif //PROJECT_BASE_CASCADEDSHADOWMAP_H
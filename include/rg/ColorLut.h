@@ -0,0 +1,131 @@
+#ifndef PROJECT_BASE_COLORLUT_H
+#define PROJECT_BASE_COLORLUT_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+struct GradingSettings {
+    float gamma = 2.2f;
+    float temperature = 0.0f;   // -1 cooler (bluer) to 1 warmer (redder), applied before the tone curve
+    float saturation = 1.0f;    // 0 grey, 1 unchanged
+    float contrast = 1.0f;      // around middle grey of the display values
+
+    bool operator==(const GradingSettings& other) const {
+        return gamma == other.gamma && temperature == other.temperature && saturation == other.saturation &&
+               contrast == other.contrast;
+    }
+
+    bool operator!=(const GradingSettings& other) const {
+        return !(*this == other);
+    }
+};
+
+// Tone curve, color grading and gamma of the tone mapping pass baked into one
+// 32^3 texture, rebuilt on the CPU only when the settings change. The exposed
+// HDR color c is unbounded, so the lookup is indexed by sqrt(c / (c + 1)):
+// it maps [0, inf) onto [0, 1) and spends most of the grid on the darks, where
+// the gamma curve is steep and trilinear interpolation would miss most.
+class ColorLut {
+public:
+    static const int Size = 32;
+    // bloom_final.fs reads the table here, after the scene, the bloom and the exposure
+    static const GLuint Unit = 3;
+
+    ColorLut() {
+        glGenTextures(1, &m_Texture);
+        GLState& gl = GLState::instance();
+        gl.bindTexture(0, GL_TEXTURE_3D, m_Texture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, Size, Size, Size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        gl.bindTexture(0, GL_TEXTURE_3D, 0);
+        GLLABEL(GL_TEXTURE, m_Texture, "color LUT");
+    }
+
+    ColorLut(const ColorLut&) = delete;
+    ColorLut& operator=(const ColorLut&) = delete;
+
+    ~ColorLut() {
+        GLState::instance().forgetTexture(m_Texture);
+        glDeleteTextures(1, &m_Texture);
+    }
+
+    // Rebuilds the table if the settings differ from the last ones; cheap to call every frame.
+    void update(const GradingSettings& settings) {
+        if (m_Baked && settings == m_Settings) {
+            return;
+        }
+        m_Settings = settings;
+        m_Baked = true;
+        bake(settings, m_Texels);
+        GLState& gl = GLState::instance();
+        gl.bindTexture(0, GL_TEXTURE_3D, m_Texture);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, Size, Size, Size, GL_RGBA, GL_UNSIGNED_BYTE, m_Texels.data());
+        gl.bindTexture(0, GL_TEXTURE_3D, 0);
+    }
+
+    void bind() const {
+        GLState::instance().bindTexture(Unit, GL_TEXTURE_3D, m_Texture);
+    }
+
+    // the sampler and the scale and offset that put [0, 1] on the centers of the first and last texels
+    static void setSamplers(Shader& shader) {
+        shader.setInt("lut", Unit);
+        shader.setFloat("lutScale", (Size - 1.0f) / Size);
+        shader.setFloat("lutOffset", 0.5f / Size);
+    }
+
+    // The display color of every grid point, RGBA8 with red varying fastest.
+    static void bake(const GradingSettings& settings, std::vector<uint8_t>& texels) {
+        texels.resize(Size * Size * Size * 4);
+        const float balance[3] = { 1.0f + 0.1f * settings.temperature, 1.0f, 1.0f - 0.1f * settings.temperature };
+        float values[Size];
+        for (int i = 0; i < Size; ++i) {
+            // inverse of the shaper, the exposed HDR value at this grid point
+            const float s = (float) i / (Size - 1);
+            values[i] = s < 1.0f ? s * s / (1.0f - s * s) : 1.0e6f;
+        }
+        uint8_t* out = texels.data();
+        for (int b = 0; b < Size; ++b) {
+            for (int g = 0; g < Size; ++g) {
+                for (int r = 0; r < Size; ++r) {
+                    const float exposed[3] = { values[r], values[g], values[b] };
+                    float color[3];
+                    for (int c = 0; c < 3; ++c) {
+                        color[c] = 1.0f - std::exp(-exposed[c] * balance[c]);
+                    }
+                    const float luma = 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+                    for (int c = 0; c < 3; ++c) {
+                        float value = std::max(luma + (color[c] - luma) * settings.saturation, 0.0f);
+                        value = std::pow(value, 1.0f / settings.gamma);
+                        value = (value - 0.5f) * settings.contrast + 0.5f;
+                        *out++ = (uint8_t) (std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+                    }
+                    *out++ = 255;
+                }
+            }
+        }
+    }
+
+private:
+    GLuint m_Texture = 0;
+    GradingSettings m_Settings;
+    bool m_Baked = false;
+    std::vector<uint8_t> m_Texels;
+};
+
+}
+
+#endif //PROJECT_BASE_COLORLUT_H
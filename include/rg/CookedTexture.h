@@ -0,0 +1,119 @@
+#ifndef PROJECT_BASE_COOKEDTEXTURE_H
+#define PROJECT_BASE_COOKEDTEXTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// ".rgtex" files written by tools/texture_cooker: a small header followed by
+// every mip level, largest first, each prefixed with its byte size. Levels are
+// stored exactly as they are handed to glTexImage2D / glCompressedTexImage2D.
+enum class CookedFormat : uint32_t {
+    R8, RG8, RGB8, RGBA8, BC1, BC3, BC5
+};
+
+enum CookedFlags : uint32_t {
+    CookedSRGB = 1,  // color data, may be sampled through an sRGB format
+    CookedAlpha = 2  // alpha channel is not fully opaque
+};
+
+struct CookedLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> data;
+};
+
+struct CookedTexture {
+    CookedFormat format = CookedFormat::RGBA8;
+    uint32_t flags = 0;
+    std::vector<CookedLevel> levels;
+};
+
+namespace cooked {
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t flags;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t reserved;
+};
+
+const uint32_t Version = 1;
+
+}
+
+inline std::string cookedPath(const std::string& source) {
+    return source + ".rgtex";
+}
+
+inline bool writeCookedTexture(const std::string& path, const CookedTexture& texture) {
+    if (texture.levels.empty()) {
+        return false;
+    }
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    cooked::Header header = {};
+    std::memcpy(header.magic, "RGTX", 4);
+    header.version = cooked::Version;
+    header.format = (uint32_t) texture.format;
+    header.flags = texture.flags;
+    header.width = (uint32_t) texture.levels[0].width;
+    header.height = (uint32_t) texture.levels[0].height;
+    header.levels = (uint32_t) texture.levels.size();
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const CookedLevel& level : texture.levels) {
+        uint32_t size = (uint32_t) level.data.size();
+        ok = ok && std::fwrite(&size, sizeof(size), 1, file) == 1
+             && std::fwrite(level.data.data(), 1, size, file) == size;
+    }
+    std::fclose(file);
+    return ok;
+}
+
+inline bool readCookedTexture(const std::string& path, CookedTexture& texture) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    cooked::Header header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+              && std::memcmp(header.magic, "RGTX", 4) == 0
+              && header.version == cooked::Version
+              && header.format <= (uint32_t) CookedFormat::BC5
+              && header.levels > 0 && header.levels <= 32;
+    if (ok) {
+        texture.format = (CookedFormat) header.format;
+        texture.flags = header.flags;
+        texture.levels.resize(header.levels);
+        int width = (int) header.width, height = (int) header.height;
+        for (CookedLevel& level : texture.levels) {
+            uint32_t size = 0;
+            ok = ok && std::fread(&size, sizeof(size), 1, file) == 1;
+            if (!ok) {
+                break;
+            }
+            level.width = width;
+            level.height = height;
+            level.data.resize(size);
+            ok = std::fread(level.data.data(), 1, size, file) == size;
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+    }
+    std::fclose(file);
+    return ok;
+}
+
+}
+
+#endif //PROJECT_BASE_COOKEDTEXTURE_H
@@ -0,0 +1,127 @@
+#ifndef PROJECT_BASE_CUBEMAP_H
+#define PROJECT_BASE_CUBEMAP_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <rg/MappedFile.h>
+
+#include <algorithm>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+struct CubemapParams {
+    bool flipVertically = false;
+    bool gammaCorrection = false;
+    bool mipmaps = false;
+};
+
+struct CubemapFace {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    unsigned char* pixels = nullptr;
+};
+
+// Decodes one face on a worker thread. All six files were mapped with
+// MADV_WILLNEED beforehand, so the reads overlap across faces as well.
+inline CubemapFace decodeCubemapFace(const MappedFile* file, bool flip) {
+    CubemapFace face;
+    stbi_set_flip_vertically_on_load_thread(flip);
+    if (file->valid()) {
+        face.pixels = stbi_load_from_memory(file->data(), (int) file->size(), &face.width, &face.height, &face.channels, 0);
+    }
+    return face;
+}
+
+// Builds a cube map from six faces in +X, -X, +Y, -Y, +Z, -Z order. The faces
+// decode in parallel; they must agree on size and channel count, otherwise
+// the texture is left with no storage and an error is printed. Storage is
+// immutable (ARB_texture_storage) when the driver has it.
+inline unsigned int createCubemap(const std::vector<std::string>& faces, const CubemapParams& params = CubemapParams()) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, params.mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    if (faces.size() != 6) {
+        std::cout << "Cubemap needs 6 faces, got " << faces.size() << std::endl;
+        return textureID;
+    }
+
+    std::vector<MappedFile> files;
+    for (const std::string& face : faces) {
+        files.emplace_back(face, MappedFile::WillNeed);
+    }
+    std::vector<std::future<CubemapFace>> decoding;
+    for (const MappedFile& file : files) {
+        decoding.push_back(std::async(std::launch::async, decodeCubemapFace, &file, params.flipVertically));
+    }
+    std::vector<CubemapFace> decoded;
+    for (std::future<CubemapFace>& face : decoding) {
+        decoded.push_back(face.get());
+    }
+
+    bool valid = true;
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        if (!decoded[i].pixels) {
+            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+            valid = false;
+        } else if (decoded[i].width != decoded[0].width || decoded[i].height != decoded[0].height
+                   || decoded[i].channels != decoded[0].channels || decoded[i].width != decoded[i].height) {
+            std::cout << "Cubemap face " << faces[i] << " is " << decoded[i].width << "x" << decoded[i].height
+                      << " with " << decoded[i].channels << " channels, expected square faces matching "
+                      << faces[0] << std::endl;
+            valid = false;
+        }
+    }
+
+    if (valid) {
+        const int size = decoded[0].width;
+        const int channels = decoded[0].channels;
+        const bool srgb = params.gammaCorrection && channels >= 3;
+        GLenum internalFormat, format;
+        switch (channels) {
+            case 1: internalFormat = GL_R8; format = GL_RED; break;
+            case 2: internalFormat = GL_RG8; format = GL_RG; break;
+            case 3: internalFormat = srgb ? GL_SRGB8 : GL_RGB8; format = GL_RGB; break;
+            default: internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8; format = GL_RGBA; break;
+        }
+        int levels = 1;
+        if (params.mipmaps) {
+            while ((size >> levels) > 0) {
+                ++levels;
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (GLAD_GL_ARB_texture_storage) {
+            glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, internalFormat, size, size);
+            for (unsigned int i = 0; i < 6; ++i) {
+                glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, size, size, format, GL_UNSIGNED_BYTE, decoded[i].pixels);
+            }
+        } else {
+            for (unsigned int i = 0; i < 6; ++i) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, internalFormat, size, size, 0, format, GL_UNSIGNED_BYTE, decoded[i].pixels);
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if (params.mipmaps) {
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        }
+    }
+    for (CubemapFace& face : decoded) {
+        stbi_image_free(face.pixels);
+    }
+    return textureID;
+}
+
+}
+
+#endif //PROJECT_BASE_CUBEMAP_H
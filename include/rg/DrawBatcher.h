@@ -0,0 +1,404 @@
+#ifndef PROJECT_BASE_DRAWBATCHER_H
+#define PROJECT_BASE_DRAWBATCHER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/GLState.h>
+#include <rg/RadixSort.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+namespace rg {
+
+// Collects mesh draws for a frame and issues them grouped by (program, VAO,
+// material, state), one multi-draw per group instead of one draw per mesh.
+//
+// Per-draw data (model and normal matrix) goes into a buffer texture that the
+// vertex shader reads at aDrawID * 8 texels, see DRAW_DATA in bloom.vs. With
+// ARB_multi_draw_indirect and ARB_base_instance every draw is a command whose
+// baseInstance is its data index, fed to aDrawID through an instanced
+// attribute, so a whole group is a single glMultiDrawElementsIndirect.
+// Without them aDrawID is a constant attribute set per run of draws that share
+// a transform and each run is one glMultiDrawElementsBaseVertex.
+//
+// Meshes with an opacity map go to the alpha shader instead, two-sided, and
+// sort after every opaque batch so the opaque ones keep early depth
+// rejection. Depending on the alpha mode they are alpha tested, written with
+// alpha to coverage, or blended back to front by the distance to their center
+// after everything else (flushTransparent()), or left out of a pass that
+// only wants opaque depth.
+class DrawBatcher {
+public:
+    // state bits that are part of the batch key
+    enum State : uint32_t {
+        CullFaces = 1,
+        AlphaToCoverage = 2,   // the target must be multisampled
+        Blend = 4,             // no depth writes, sorted back to front
+        Cutout = 8             // drawn with the alpha shader, after the opaque batches
+    };
+
+    // how the alpha shader treats coverage, its alphaMode uniform
+    enum AlphaMode : int {
+        AlphaTest = 0,
+        AlphaCoverage = 1,
+        AlphaBlend = 2,
+        AlphaSkip = 3      // not submitted at all, e.g. blended meshes in a depth prepass
+    };
+
+    static const GLuint DrawIdAttribute = 5;
+    static const GLuint DrawDataUnit = 15;
+
+    struct Stats {
+        unsigned int draws = 0;
+        unsigned int batches = 0;
+        unsigned int calls = 0;  // glMultiDraw* calls issued
+        unsigned int triangles = 0;
+    };
+
+    DrawBatcher() {
+        m_Indirect = GLAD_GL_ARB_draw_indirect && GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance;
+        glGenBuffers(1, &m_DataBuffer);
+        glGenTextures(1, &m_DataTexture);
+        glBindBuffer(GL_TEXTURE_BUFFER, m_DataBuffer);
+        GLState::instance().bindTexture(DrawDataUnit, GL_TEXTURE_BUFFER, m_DataTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_DataBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        GLLABEL(GL_BUFFER, m_DataBuffer, "per-draw data");
+        GLLABEL(GL_TEXTURE, m_DataTexture, "per-draw data");
+        if (m_Indirect) {
+            glGenBuffers(1, &m_CommandBuffer);
+            glGenBuffers(1, &m_IdBuffer);
+        }
+    }
+
+    DrawBatcher(const DrawBatcher&) = delete;
+    DrawBatcher& operator=(const DrawBatcher&) = delete;
+
+    ~DrawBatcher() {
+        GLState::instance().forgetTexture(m_DataTexture);
+        glDeleteTextures(1, &m_DataTexture);
+        glDeleteBuffers(1, &m_DataBuffer);
+        glDeleteBuffers(1, &m_CommandBuffer);
+        glDeleteBuffers(1, &m_IdBuffer);
+    }
+
+    bool indirect() const {
+        return m_Indirect;
+    }
+
+    // The shader meshes with an opacity map are drawn with, built with
+    // DRAW_DATA and ALPHA; without one they draw as opaque.
+    void setAlphaShader(Shader* shader, AlphaMode mode) {
+        m_AlphaShader = shader;
+        m_AlphaMode = mode;
+    }
+
+    // blended meshes are ordered by their distance from the eye, quantized over [0, farPlane]
+    void setView(const glm::vec3& eye, float farPlane) {
+        m_Eye = eye;
+        m_FarPlane = farPlane;
+    }
+
+    // Queues one level of detail of a mesh of a packed model. The shader
+    // must be built with DRAW_DATA; consecutive submissions with the same
+    // model matrix share their per-draw data.
+    void submit(Shader& shader, GLuint vao, const Mesh& mesh, const glm::mat4& model, unsigned int lod = 0,
+                uint32_t state = CullFaces) {
+        Shader* drawShader = &shader;
+        if (mesh.alphaTested && m_AlphaShader) {
+            if (m_AlphaMode == AlphaSkip) {
+                return;
+            }
+            drawShader = m_AlphaShader;
+            state = Cutout;
+            if (m_AlphaMode == AlphaCoverage) {
+                state |= AlphaToCoverage;
+            } else if (m_AlphaMode == AlphaBlend) {
+                state |= Blend;
+            }
+        }
+        if (m_Data.empty() || model != m_LastModel) {
+            const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+            for (int c = 0; c < 4; ++c) {
+                m_Data.push_back(model[c]);
+            }
+            for (int c = 0; c < 3; ++c) {
+                m_Data.push_back(glm::vec4(normalMatrix[c], 0.0f));
+            }
+            m_Data.push_back(glm::vec4(0.0f));
+            m_LastModel = model;
+        }
+        Draw draw;
+        const uint64_t program = m_Programs.get(drawShader->ID) & 0x3f;
+        if (state & Blend) {
+            const float distance = glm::length(glm::vec3(model * glm::vec4(mesh.center, 1.0f)) - m_Eye) / m_FarPlane;
+            const uint64_t depth = (uint64_t) (std::min(std::max(distance, 0.0f), 1.0f) * 0xffffff);
+            draw.key = (uint64_t) PassBlended << 62 | (0xffffff - depth) << 38 | program << 32 |
+                       (uint64_t) (mesh.material & 0xff) << 24;
+        } else {
+            draw.key = (uint64_t) (state & Cutout ? PassCutout : PassOpaque) << 62 | program << 56 |
+                       (uint64_t) (m_Vaos.get(vao) & 0xfff) << 44 | (uint64_t) (mesh.material & 0xffff) << 28 |
+                       (uint64_t) (state & 0xf) << 24;
+        }
+        draw.program = drawShader->ID;
+        draw.vao = vao;
+        draw.material = mesh.material;
+        draw.state = state;
+        draw.data = (uint32_t) (m_Data.size() / TexelsPerDraw - 1);
+        draw.count = (GLsizei) mesh.lods[lod].indexCount;
+        draw.firstIndex = mesh.firstIndex + mesh.lods[lod].firstIndex;
+        draw.baseVertex = (GLint) mesh.baseVertex;
+        draw.mesh = &mesh;
+        draw.shader = drawShader;
+        m_Draws.push_back(draw);
+    }
+
+    // Draws the opaque and alpha tested meshes submitted since the last
+    // flush. Blended ones stay queued for flushTransparent().
+    void flush() {
+        m_Stats = Stats();
+        m_Stats.draws = (unsigned int) m_Draws.size();
+        for (const Draw& draw : m_Draws) {
+            m_Stats.triangles += draw.count / 3;
+        }
+        m_Blended = 0;
+        if (m_Draws.empty()) {
+            m_Data.clear();
+            return;
+        }
+        GLGROUP("Model batches");
+        sortDraws();
+
+        glBindBuffer(GL_TEXTURE_BUFFER, m_DataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, m_Data.size() * sizeof(glm::vec4), m_Data.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        if (m_Indirect) {
+            uploadCommands();
+        }
+
+        // blended draws sort last
+        m_Blended = m_Draws.size();
+        while (m_Blended > 0 && (m_Draws[m_Blended - 1].state & Blend)) {
+            --m_Blended;
+        }
+        drawBatches(0, m_Blended);
+    }
+
+    // Draws the blended meshes held back by flush(), back to front; call it
+    // once the rest of the frame's geometry is in. Ends the frame's batches.
+    void flushTransparent() {
+        if (m_Blended < m_Draws.size()) {
+            GLGROUP("Blended model batches");
+            drawBatches(m_Blended, m_Draws.size());
+        }
+        m_Draws.clear();
+        m_Data.clear();
+        m_Blended = 0;
+    }
+
+    const Stats& stats() const {
+        return m_Stats;
+    }
+
+private:
+    static const size_t TexelsPerDraw = 8;
+
+    // top two bits of the key
+    enum KeyPass : uint64_t {
+        PassOpaque = 0,
+        PassCutout = 1,
+        PassBlended = 2
+    };
+
+    struct Draw {
+        // opaque and cutout   pass:2 | program:6 | vao:12 | material:16 | state:4 | data:24, see sortDraws()
+        // blended             pass:2 | depth:24 (inverted) | program:6 | material:8 | data:24
+        uint64_t key;
+        GLuint program;
+        GLuint vao;
+        uint32_t material;
+        uint32_t state;
+        uint32_t data;
+        GLsizei count;
+        GLuint firstIndex;
+        GLint baseVertex;
+        const Mesh* mesh;
+        Shader* shader;
+    };
+
+    // layout fixed by ARB_draw_indirect
+    struct Command {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    static bool sameBatch(const Draw& a, const Draw& b) {
+        return a.program == b.program && a.vao == b.vao && a.material == b.material && a.state == b.state;
+    }
+
+    // Radix sorts on the batch key. Data slots are filled in only now, so the
+    // low bits order draws by transform within a batch (the order of their runs
+    // in the fallback path) and the sort stays exact up to 16M slots.
+    void sortDraws() {
+        m_Keys.clear();
+        for (uint32_t i = 0; i < m_Draws.size(); ++i) {
+            m_Keys.push_back({ m_Draws[i].key | std::min<uint32_t>(m_Draws[i].data, 0xffffff), i });
+        }
+        radixSort(m_Keys, m_SortScratch);
+        m_Sorted.clear();
+        for (const SortItem& item : m_Keys) {
+            m_Sorted.push_back(m_Draws[item.index]);
+        }
+        m_Draws.swap(m_Sorted);
+    }
+
+    // Draws m_Draws[begin, end), uploaded by flush(), batch by batch, and
+    // leaves culling as it found it and blending, depth writes and alpha to
+    // coverage the way the rest of the frame expects them (off, on, off).
+    void drawBatches(size_t begin, size_t end) {
+        GLState& gl = GLState::instance();
+        gl.bindTexture(DrawDataUnit, GL_TEXTURE_BUFFER, m_DataTexture);
+        if (m_Indirect) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+        }
+        const bool cullWas = gl.enabled(GL_CULL_FACE);
+        GLuint program = 0;
+        while (begin < end) {
+            const Draw& first = m_Draws[begin];
+            size_t last = begin + 1;
+            while (last < end && sameBatch(first, m_Draws[last])) {
+                ++last;
+            }
+            ++m_Stats.batches;
+
+            if (first.program != program) {
+                gl.useProgram(first.program);
+                first.shader->setInt("drawData", DrawDataUnit);
+                program = first.program;
+            }
+            gl.bindVertexArray(first.vao);
+            if (m_Indirect) {
+                prepareVao(first.vao);
+            }
+            gl.setEnabled(GL_CULL_FACE, (first.state & CullFaces) != 0);
+            gl.setEnabled(GL_SAMPLE_ALPHA_TO_COVERAGE, (first.state & AlphaToCoverage) != 0);
+            gl.setEnabled(GL_BLEND, (first.state & Blend) != 0);
+            gl.depthMask((first.state & Blend) == 0);
+            if (first.state & Blend) {
+                gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            }
+            if (first.state & Cutout) {
+                first.shader->setInt("alphaMode", m_AlphaMode);
+            }
+            first.mesh->BindTextures(*first.shader);
+
+            if (m_Indirect) {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                            (void*) (begin * sizeof(Command)), (GLsizei) (last - begin), 0);
+                ++m_Stats.calls;
+            } else {
+                drawRuns(begin, last);
+            }
+            begin = last;
+        }
+
+        if (m_Indirect) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        gl.setEnabled(GL_CULL_FACE, cullWas);
+        gl.disable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+        gl.disable(GL_BLEND);
+        gl.depthMask(true);
+    }
+
+    void uploadCommands() {
+        m_Commands.clear();
+        for (const Draw& draw : m_Draws) {
+            m_Commands.push_back({ (GLuint) draw.count, 1, draw.firstIndex, draw.baseVertex, draw.data });
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_Commands.size() * sizeof(Command), m_Commands.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        // aDrawID = baseInstance + 0 through an attribute that advances once per instance
+        size_t draws = m_Data.size() / TexelsPerDraw;
+        if (draws > m_Ids) {
+            std::vector<GLint> ids(std::max(draws, m_Ids * 2));
+            for (size_t i = 0; i < ids.size(); ++i) {
+                ids[i] = (GLint) i;
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, m_IdBuffer);
+            glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLint), ids.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            m_Ids = ids.size();
+        }
+    }
+
+    // the draw id attribute is VAO state, hooked up the first time a VAO is
+    // seen. models create their VAOs at load and keep them, so names are not reused
+    void prepareVao(GLuint vao) {
+        if (!m_PreparedVaos.insert(vao).second) {
+            return;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, m_IdBuffer);
+        glEnableVertexAttribArray(DrawIdAttribute);
+        glVertexAttribIPointer(DrawIdAttribute, 1, GL_INT, sizeof(GLint), (void*) 0);
+        glVertexAttribDivisor(DrawIdAttribute, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // one multi-draw per run of draws sharing their per-draw data
+    void drawRuns(size_t begin, size_t end) {
+        while (begin < end) {
+            m_Counts.clear();
+            m_Offsets.clear();
+            m_BaseVertices.clear();
+            const uint32_t data = m_Draws[begin].data;
+            for (; begin < end && m_Draws[begin].data == data; ++begin) {
+                m_Counts.push_back(m_Draws[begin].count);
+                m_Offsets.push_back((const void*) (m_Draws[begin].firstIndex * sizeof(GLuint)));
+                m_BaseVertices.push_back(m_Draws[begin].baseVertex);
+            }
+            glVertexAttribI1i(DrawIdAttribute, (GLint) data);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_Counts.data(), GL_UNSIGNED_INT, m_Offsets.data(),
+                                          (GLsizei) m_Counts.size(), m_BaseVertices.data());
+            ++m_Stats.calls;
+        }
+    }
+
+    bool m_Indirect = false;
+    Shader* m_AlphaShader = nullptr;
+    AlphaMode m_AlphaMode = AlphaTest;
+    glm::vec3 m_Eye = glm::vec3(0.0f);
+    float m_FarPlane = 100.0f;
+    size_t m_Blended = 0;   // first blended draw after flush()
+    GLuint m_DataBuffer = 0, m_DataTexture = 0;
+    GLuint m_CommandBuffer = 0, m_IdBuffer = 0;
+    size_t m_Ids = 0;
+    std::set<GLuint> m_PreparedVaos;
+    DenseIds m_Programs, m_Vaos;
+
+    std::vector<Draw> m_Draws;
+    std::vector<Draw> m_Sorted;
+    std::vector<SortItem> m_Keys, m_SortScratch;
+    std::vector<glm::vec4> m_Data;
+    glm::mat4 m_LastModel;
+    std::vector<Command> m_Commands;
+    std::vector<GLsizei> m_Counts;
+    std::vector<const void*> m_Offsets;
+    std::vector<GLint> m_BaseVertices;
+    Stats m_Stats;
+};
+
+}
+
+#endif //PROJECT_BASE_DRAWBATCHER_H
@@ -6,27 +6,55 @@
 #define PROJECT_BASE_ERROR_H
 
 #include <iostream>
+#include <string>
 #include <glad/glad.h>
 
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+
+// GL error reporting. Debug builds (no NDEBUG, or RG_GL_DEBUG defined) install
+// a GL_KHR_debug message callback, which the driver calls on its own schedule
+// instead of the renderer stopping after every call to ask glGetError(). Only
+// when KHR_debug is missing does GLCALL fall back to polling. Release builds
+// compile GLCALL, labels and debug groups down to the bare call or nothing.
+#if !defined(NDEBUG) && !defined(RG_GL_DEBUG)
+#define RG_GL_DEBUG 1
+#endif
+
+#define RG_CONCAT_(a, b) a##b
+#define RG_CONCAT(a, b) RG_CONCAT_(a, b)
+
+#ifdef RG_GL_DEBUG
 #define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+do{ if (rg::debugOutputInstalled()) { x; } else { rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } } while (0)
+// names a GL object in debug messages and capture tools
+#define GLLABEL(identifier, name, label) rg::labelObject(identifier, name, label)
+// debug group for the rest of the enclosing scope, or pushed and popped by hand
+#define GLGROUP(name) rg::DebugGroup RG_CONCAT(debugGroup, __LINE__)(name)
+#define GLPUSHGROUP(name) rg::pushDebugGroup(name)
+#define GLPOPGROUP() rg::popDebugGroup()
+#else
+#define GLCALL(x) do{ x; } while (0)
+#define GLLABEL(identifier, name, label) do{ } while (0)
+#define GLGROUP(name) do{ } while (0)
+#define GLPUSHGROUP(name) do{ } while (0)
+#define GLPOPGROUP() do{ } while (0)
+#endif
 
 namespace rg {
 
     
-void clearAllOpenGlErrors();
-const char* openGLErrorToString(GLenum error);
-bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call);
+inline void clearAllOpenGlErrors();
+inline const char* openGLErrorToString(GLenum error);
+inline bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call);
 
-    void clearAllOpenGlErrors() {
+    inline void clearAllOpenGlErrors() {
         while (glGetError() != GL_NO_ERROR) {
             ;
         }
     }
-    const char* openGLErrorToString(GLenum error) {
+    inline const char* openGLErrorToString(GLenum error) {
         switch(error) {
             case GL_NO_ERROR: return "GL_NO_ERROR";
             case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
@@ -37,7 +65,7 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
         ASSERT(false, "Passed something that is not an error code");
         return "THIS_SHOULD_NEVER_HAPPEN";
     }
-    bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call) {
+    inline bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call) {
         bool success = true;
         while (GLenum error = glGetError()) {
             std::cerr << "[OpenGL error] " << error << " " << openGLErrorToString(error)
@@ -50,5 +78,118 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
         return success;
     }
 
+
+    inline bool& debugOutputFlag() {
+        static bool installed = false;
+        return installed;
+    }
+    // true once the KHR_debug callback reports errors, GLCALL stops polling then
+    inline bool debugOutputInstalled() {
+        return debugOutputFlag();
+    }
+
+    inline const char* debugSourceToString(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API: return "API";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+        }
+        return "other";
+    }
+    inline const char* debugTypeToString(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+            case GL_DEBUG_TYPE_MARKER: return "marker";
+        }
+        return "other";
+    }
+    inline const char* debugSeverityToString(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+            case GL_DEBUG_SEVERITY_LOW: return "low";
+        }
+        return "notification";
+    }
+
+    // May run on a driver thread, long after the call that caused it, so it
+    // only prints; the debug group (pass) shows up in the message log of
+    // capture tools such as RenderDoc.
+    inline void APIENTRY debugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                              const GLchar* message, const void* userParam) {
+        if (type == GL_DEBUG_TYPE_PUSH_GROUP || type == GL_DEBUG_TYPE_POP_GROUP) {
+            return;
+        }
+        std::cerr << "[OpenGL " << debugSeverityToString(severity) << "] " << debugSourceToString(source) << " "
+                  << debugTypeToString(type) << " " << id << ": " << (length < 0 ? std::string(message) : std::string(message, length))
+                  << '\n';
+    }
+
+    // Installs the KHR_debug callback and drops messages below minSeverity
+    // (GL_DEBUG_SEVERITY_HIGH, _MEDIUM, _LOW or _NOTIFICATION). Returns false,
+    // leaving GLCALL to poll, when the context has no KHR_debug. The context
+    // should be created with GLFW_OPENGL_DEBUG_CONTEXT; without it most
+    // drivers only report errors.
+    inline bool installDebugOutput(GLenum minSeverity = GL_DEBUG_SEVERITY_MEDIUM) {
+#ifdef RG_GL_DEBUG
+        if (!GLAD_GL_KHR_debug) {
+            return false;
+        }
+        const GLenum severities[] = { GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_MEDIUM,
+                                      GL_DEBUG_SEVERITY_HIGH };
+        bool enabled = false;
+        for (GLenum severity : severities) {
+            enabled = enabled || severity == minSeverity;
+            glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, enabled ? GL_TRUE : GL_FALSE);
+        }
+        glDebugMessageCallback(debugMessageCallback, nullptr);
+        glEnable(GL_DEBUG_OUTPUT);
+        debugOutputFlag() = true;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Labels and groups are meant to be used through GLLABEL / GLGROUP, which
+    // drop them (and the building of their strings) from release builds.
+    // identifier is GL_TEXTURE, GL_BUFFER, GL_PROGRAM, GL_FRAMEBUFFER, GL_VERTEX_ARRAY, ...
+    inline void labelObject(GLenum identifier, GLuint name, const std::string& label) {
+        if (debugOutputInstalled()) {
+            glObjectLabel(identifier, name, (GLsizei) label.size(), label.c_str());
+        }
+    }
+
+    inline void pushDebugGroup(const char* name) {
+        if (debugOutputInstalled()) {
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+        }
+    }
+
+    inline void popDebugGroup() {
+        if (debugOutputInstalled()) {
+            glPopDebugGroup();
+        }
+    }
+
+    // brackets a pass so captures and messages are grouped by it
+    class DebugGroup {
+    public:
+        explicit DebugGroup(const char* name) {
+            pushDebugGroup(name);
+        }
+        DebugGroup(const DebugGroup&) = delete;
+        DebugGroup& operator=(const DebugGroup&) = delete;
+        ~DebugGroup() {
+            popDebugGroup();
+        }
+    };
+
 };
 #endif //PROJECT_BASE_ERROR_H
@@ -0,0 +1,56 @@
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+namespace rg {
+
+// The six planes of a view volume, taken from a projection * view matrix
+// (Gribb & Hartmann). Normals point inwards, so a point is inside when every
+// plane gives a distance >= 0.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    explicit Frustum(const glm::mat4& viewProjection = glm::mat4(1.0f)) {
+        for (int i = 0; i < 3; ++i) {
+            for (int side = 0; side < 2; ++side) {
+                glm::vec4& plane = planes[i * 2 + side];
+                for (int c = 0; c < 4; ++c) {
+                    // row 3 +- row i
+                    plane[c] = viewProjection[c][3] + (side ? -viewProjection[c][i] : viewProjection[c][i]);
+                }
+                const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+                plane = plane * (1.0f / length);
+            }
+        }
+    }
+
+    // false only when the box is entirely behind one of the planes, so boxes
+    // near a corner of the volume may pass without being inside
+    bool intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+        for (const glm::vec4& plane : planes) {
+            // the box corner furthest along the plane's normal
+            const glm::vec3 corner(plane.x >= 0.0f ? boxMax.x : boxMin.x, plane.y >= 0.0f ? boxMax.y : boxMin.y,
+                                   plane.z >= 0.0f ? boxMax.z : boxMin.z);
+            if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool intersects(const glm::vec3& center, float radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_FRUSTUM_H
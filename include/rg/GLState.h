@@ -0,0 +1,494 @@
+#ifndef PROJECT_BASE_GLSTATE_H
+#define PROJECT_BASE_GLSTATE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <iostream>
+
+namespace rg {
+
+// Shadow copy of the GL state the renderer touches: bound program, VAO,
+// framebuffers, the active texture unit and the texture on each target of each
+// unit, plus the fixed-function switches (capabilities, culling, depth, blend,
+// viewport). Calls that would not change anything are dropped before they
+// reach the driver and counted, so the savings show up in the ImGui stats.
+//
+// The shadow is only right while every change goes through here. Code that
+// calls GL behind its back (one-off setup) must call invalidate() afterwards,
+// and deleting a texture or framebuffer must be reported with forget*(), since
+// GL silently unbinds it and the name can come back from glGen*. With
+// validation on, validate() compares the whole shadow against glGet* and
+// reports every entry that drifted.
+class GLState {
+public:
+    static const unsigned int TextureUnits = 16;
+
+    struct Counter {
+        unsigned int issued = 0;
+        unsigned int skipped = 0;
+    };
+
+    struct Counters {
+        Counter programs;
+        Counter vertexArrays;
+        Counter textures;
+        Counter textureUnits;   // glActiveTexture
+        Counter framebuffers;
+        Counter capabilities;   // glEnable / glDisable
+        Counter fixedFunction;  // cull, depth, blend and viewport settings
+        unsigned int mismatches = 0;
+    };
+
+    // every shadowed value, Unknown where the driver has to be asked
+    struct Snapshot {
+        GLuint program;
+        GLuint vertexArray;
+        GLuint activeUnit;
+        GLuint textures[TextureUnits][5];
+        GLuint drawFramebuffer;
+        GLuint readFramebuffer;
+        GLuint capabilities[8];
+        GLuint cullFace;
+        GLuint frontFace;
+        GLuint depthFunc;
+        GLuint depthMask;
+        GLuint blend[4];          // src rgb, dst rgb, src alpha, dst alpha
+        GLuint blendEquation[2];  // rgb, alpha
+        GLint viewport[4];
+    };
+
+    static GLState& instance() {
+        static GLState state;
+        return state;
+    }
+
+    // bindings
+    // ------------------------------------------------------------------------
+    void useProgram(GLuint program) {
+        if (skip(m_State.program, program, m_Counters.programs)) {
+            return;
+        }
+        glUseProgram(program);
+    }
+
+    GLuint program() const {
+        return m_State.program;
+    }
+
+    void bindVertexArray(GLuint vao) {
+        if (skip(m_State.vertexArray, vao, m_Counters.vertexArrays)) {
+            return;
+        }
+        glBindVertexArray(vao);
+    }
+
+    void activeTexture(unsigned int unit) {
+        if (skip(m_State.activeUnit, unit, m_Counters.textureUnits)) {
+            return;
+        }
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds on the given unit, switching the active unit only if the bind is needed
+    void bindTexture(unsigned int unit, GLenum target, GLuint texture) {
+        int slot = targetSlot(target);
+        if (unit >= TextureUnits || slot < 0) {
+            activeTexture(unit);
+            glBindTexture(target, texture);
+            ++m_Counters.textures.issued;
+            return;
+        }
+        if (m_State.textures[unit][slot] == texture) {
+            ++m_Counters.textures.skipped;
+            return;
+        }
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        m_State.textures[unit][slot] = texture;
+        ++m_Counters.textures.issued;
+    }
+
+    // binds on whatever unit is active, for uploads that do not care which
+    void bindTexture(GLenum target, GLuint texture) {
+        if (m_State.activeUnit == Unknown) {
+            activeTexture(0);
+        }
+        bindTexture(m_State.activeUnit, target, texture);
+    }
+
+    void forgetTexture(GLuint texture) {
+        for (auto& unit : m_State.textures) {
+            for (GLuint& bound : unit) {
+                if (bound == texture) {
+                    bound = Unknown;
+                }
+            }
+        }
+    }
+
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer
+    void bindFramebuffer(GLenum target, GLuint framebuffer) {
+        const bool draw = target != GL_READ_FRAMEBUFFER, read = target != GL_DRAW_FRAMEBUFFER;
+        if ((!draw || m_State.drawFramebuffer == framebuffer) && (!read || m_State.readFramebuffer == framebuffer)) {
+            ++m_Counters.framebuffers.skipped;
+            return;
+        }
+        glBindFramebuffer(target, framebuffer);
+        if (draw) {
+            m_State.drawFramebuffer = framebuffer;
+        }
+        if (read) {
+            m_State.readFramebuffer = framebuffer;
+        }
+        ++m_Counters.framebuffers.issued;
+    }
+
+    GLuint drawFramebuffer() const {
+        return m_State.drawFramebuffer;
+    }
+
+    void forgetFramebuffer(GLuint framebuffer) {
+        if (m_State.drawFramebuffer == framebuffer) {
+            m_State.drawFramebuffer = Unknown;
+        }
+        if (m_State.readFramebuffer == framebuffer) {
+            m_State.readFramebuffer = Unknown;
+        }
+    }
+
+    // fixed-function state
+    // ------------------------------------------------------------------------
+    void setEnabled(GLenum capability, bool enabled) {
+        int slot = capabilitySlot(capability);
+        if (slot >= 0 && skip(m_State.capabilities[slot], (GLuint) enabled, m_Counters.capabilities)) {
+            return;
+        }
+        if (slot < 0) {
+            ++m_Counters.capabilities.issued;
+        }
+        enabled ? glEnable(capability) : glDisable(capability);
+    }
+
+    void enable(GLenum capability) {
+        setEnabled(capability, true);
+    }
+
+    void disable(GLenum capability) {
+        setEnabled(capability, false);
+    }
+
+    // answered from the shadow, the driver is only asked the first time
+    bool enabled(GLenum capability) {
+        int slot = capabilitySlot(capability);
+        if (slot < 0) {
+            return glIsEnabled(capability) == GL_TRUE;
+        }
+        if (m_State.capabilities[slot] == Unknown) {
+            m_State.capabilities[slot] = glIsEnabled(capability) == GL_TRUE;
+        }
+        return m_State.capabilities[slot] != 0;
+    }
+
+    void cullFace(GLenum mode) {
+        if (!skip(m_State.cullFace, mode, m_Counters.fixedFunction)) {
+            glCullFace(mode);
+        }
+    }
+
+    void frontFace(GLenum mode) {
+        if (!skip(m_State.frontFace, mode, m_Counters.fixedFunction)) {
+            glFrontFace(mode);
+        }
+    }
+
+    void depthFunc(GLenum func) {
+        if (!skip(m_State.depthFunc, func, m_Counters.fixedFunction)) {
+            glDepthFunc(func);
+        }
+    }
+
+    void depthMask(bool write) {
+        if (!skip(m_State.depthMask, (GLuint) write, m_Counters.fixedFunction)) {
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+        }
+    }
+
+    void blendFunc(GLenum src, GLenum dst) {
+        blendFuncSeparate(src, dst, src, dst);
+    }
+
+    void blendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha) {
+        GLuint* blend = m_State.blend;
+        if (blend[0] == srcRGB && blend[1] == dstRGB && blend[2] == srcAlpha && blend[3] == dstAlpha) {
+            ++m_Counters.fixedFunction.skipped;
+            return;
+        }
+        glBlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+        blend[0] = srcRGB; blend[1] = dstRGB; blend[2] = srcAlpha; blend[3] = dstAlpha;
+        ++m_Counters.fixedFunction.issued;
+    }
+
+    void blendEquation(GLenum mode) {
+        blendEquationSeparate(mode, mode);
+    }
+
+    void blendEquationSeparate(GLenum modeRGB, GLenum modeAlpha) {
+        if (m_State.blendEquation[0] == modeRGB && m_State.blendEquation[1] == modeAlpha) {
+            ++m_Counters.fixedFunction.skipped;
+            return;
+        }
+        glBlendEquationSeparate(modeRGB, modeAlpha);
+        m_State.blendEquation[0] = modeRGB;
+        m_State.blendEquation[1] = modeAlpha;
+        ++m_Counters.fixedFunction.issued;
+    }
+
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        GLint* v = m_State.viewport;
+        if (v[0] == x && v[1] == y && v[2] == width && v[3] == height) {
+            ++m_Counters.fixedFunction.skipped;
+            return;
+        }
+        glViewport(x, y, width, height);
+        v[0] = x; v[1] = y; v[2] = width; v[3] = height;
+        ++m_Counters.fixedFunction.issued;
+    }
+
+    // whole-state operations
+    // ------------------------------------------------------------------------
+
+    // Current state with nothing left unknown, for code that has to put things
+    // back the way it found them (the ImGui backend). Only the entries the
+    // shadow does not know yet are queried.
+    Snapshot save() {
+        if (!complete()) {
+            Snapshot actual = query();
+            fill(m_State, actual);
+        }
+        return m_State;
+    }
+
+    // goes back to a saved state through the filtered setters, so only what
+    // actually differs is sent to the driver
+    void restore(const Snapshot& saved) {
+        for (unsigned int unit = 0; unit < TextureUnits; ++unit) {
+            for (int slot = 0; slot < TargetSlots; ++slot) {
+                if (saved.textures[unit][slot] != Unknown) {
+                    bindTexture(unit, target(slot), saved.textures[unit][slot]);
+                }
+            }
+        }
+        activeTexture(saved.activeUnit);
+        useProgram(saved.program);
+        bindVertexArray(saved.vertexArray);
+        bindFramebuffer(GL_DRAW_FRAMEBUFFER, saved.drawFramebuffer);
+        bindFramebuffer(GL_READ_FRAMEBUFFER, saved.readFramebuffer);
+        for (int slot = 0; slot < CapabilitySlots; ++slot) {
+            setEnabled(capability(slot), saved.capabilities[slot] != 0);
+        }
+        cullFace(saved.cullFace);
+        frontFace(saved.frontFace);
+        depthFunc(saved.depthFunc);
+        depthMask(saved.depthMask != 0);
+        blendFuncSeparate(saved.blend[0], saved.blend[1], saved.blend[2], saved.blend[3]);
+        blendEquationSeparate(saved.blendEquation[0], saved.blendEquation[1]);
+        viewport(saved.viewport[0], saved.viewport[1], saved.viewport[2], saved.viewport[3]);
+    }
+
+    // forget everything, the next call of each kind always reaches the driver
+    void invalidate() {
+        GLuint* words = &m_State.program;
+        // Snapshot is all 32-bit words; the viewport's Unknown is -1 as well
+        for (size_t i = 0; i < sizeof(Snapshot) / sizeof(GLuint); ++i) {
+            words[i] = Unknown;
+        }
+    }
+
+    void setValidation(bool enabled) {
+        m_Validate = enabled;
+    }
+
+    bool validation() const {
+        return m_Validate;
+    }
+
+    // With validation on, compares every known entry against the driver,
+    // reports the ones that drifted and adopts the driver's values. Expensive
+    // (a few hundred glGet calls), meant to run once a frame while debugging.
+    unsigned int validate() {
+        if (!m_Validate) {
+            return 0;
+        }
+        Snapshot actual = query();
+        unsigned int mismatches = 0;
+        auto check = [&mismatches](const char* name, GLuint& shadow, GLuint real) {
+            if (shadow != Unknown && shadow != real) {
+                std::cerr << "GLState: " << name << " shadowed as " << shadow << ", driver has " << real << std::endl;
+                ++mismatches;
+            }
+            shadow = real;
+        };
+        check("program", m_State.program, actual.program);
+        check("vertex array", m_State.vertexArray, actual.vertexArray);
+        check("active texture unit", m_State.activeUnit, actual.activeUnit);
+        for (unsigned int unit = 0; unit < TextureUnits; ++unit) {
+            for (int slot = 0; slot < TargetSlots; ++slot) {
+                check("texture binding", m_State.textures[unit][slot], actual.textures[unit][slot]);
+            }
+        }
+        check("draw framebuffer", m_State.drawFramebuffer, actual.drawFramebuffer);
+        check("read framebuffer", m_State.readFramebuffer, actual.readFramebuffer);
+        for (int slot = 0; slot < CapabilitySlots; ++slot) {
+            check("capability", m_State.capabilities[slot], actual.capabilities[slot]);
+        }
+        check("cull face", m_State.cullFace, actual.cullFace);
+        check("front face", m_State.frontFace, actual.frontFace);
+        check("depth func", m_State.depthFunc, actual.depthFunc);
+        check("depth mask", m_State.depthMask, actual.depthMask);
+        for (int i = 0; i < 4; ++i) {
+            check("blend func", m_State.blend[i], actual.blend[i]);
+            check("viewport", (GLuint&) m_State.viewport[i], (GLuint) actual.viewport[i]);
+        }
+        check("blend equation", m_State.blendEquation[0], actual.blendEquation[0]);
+        check("blend equation", m_State.blendEquation[1], actual.blendEquation[1]);
+        m_Counters.mismatches += mismatches;
+        return mismatches;
+    }
+
+    const Counters& counters() const {
+        return m_Counters;
+    }
+
+    void resetCounters() {
+        m_Counters = Counters();
+    }
+
+private:
+    static const GLuint Unknown = 0xffffffffu;
+    static const int TargetSlots = 5;
+    static const int CapabilitySlots = 8;
+    // texture targets and capabilities that get a shadow slot
+    static GLenum target(int slot) {
+        static const GLenum targets[TargetSlots] = {
+                GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D
+        };
+        return targets[slot];
+    }
+
+    static GLenum targetBinding(int slot) {
+        static const GLenum bindings[TargetSlots] = {
+                GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_BUFFER,
+                GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_3D
+        };
+        return bindings[slot];
+    }
+
+    static GLenum capability(int slot) {
+        static const GLenum capabilities[CapabilitySlots] = {
+                GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST,
+                GL_MULTISAMPLE, GL_SAMPLE_ALPHA_TO_COVERAGE, GL_POLYGON_OFFSET_FILL, GL_FRAMEBUFFER_SRGB
+        };
+        return capabilities[slot];
+    }
+
+    GLState() {
+        invalidate();
+    }
+
+    // true when the call can be dropped; otherwise records the new value
+    static bool skip(GLuint& shadow, GLuint value, Counter& counter) {
+        if (shadow == value) {
+            ++counter.skipped;
+            return true;
+        }
+        shadow = value;
+        ++counter.issued;
+        return false;
+    }
+
+    static int targetSlot(GLenum target) {
+        for (int slot = 0; slot < TargetSlots; ++slot) {
+            if (GLState::target(slot) == target) {
+                return slot;
+            }
+        }
+        return -1;
+    }
+
+    static int capabilitySlot(GLenum capability) {
+        for (int slot = 0; slot < CapabilitySlots; ++slot) {
+            if (GLState::capability(slot) == capability) {
+                return slot;
+            }
+        }
+        return -1;
+    }
+
+    bool complete() const {
+        const GLuint* words = &m_State.program;
+        for (size_t i = 0; i < sizeof(Snapshot) / sizeof(GLuint); ++i) {
+            if (words[i] == Unknown) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void fill(Snapshot& state, const Snapshot& actual) {
+        GLuint* words = &state.program;
+        const GLuint* real = &actual.program;
+        for (size_t i = 0; i < sizeof(Snapshot) / sizeof(GLuint); ++i) {
+            if (words[i] == Unknown) {
+                words[i] = real[i];
+            }
+        }
+    }
+
+    // the real state, straight from the driver
+    static Snapshot query() {
+        Snapshot s;
+        auto get = [](GLenum name) {
+            GLint value = 0;
+            glGetIntegerv(name, &value);
+            return (GLuint) value;
+        };
+        s.program = get(GL_CURRENT_PROGRAM);
+        s.vertexArray = get(GL_VERTEX_ARRAY_BINDING);
+        s.activeUnit = get(GL_ACTIVE_TEXTURE) - GL_TEXTURE0;
+        for (unsigned int unit = 0; unit < TextureUnits; ++unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            for (int slot = 0; slot < TargetSlots; ++slot) {
+                s.textures[unit][slot] = get(targetBinding(slot));
+            }
+        }
+        glActiveTexture(GL_TEXTURE0 + s.activeUnit);
+        s.drawFramebuffer = get(GL_DRAW_FRAMEBUFFER_BINDING);
+        s.readFramebuffer = get(GL_READ_FRAMEBUFFER_BINDING);
+        for (int slot = 0; slot < CapabilitySlots; ++slot) {
+            s.capabilities[slot] = glIsEnabled(capability(slot)) == GL_TRUE;
+        }
+        s.cullFace = get(GL_CULL_FACE_MODE);
+        s.frontFace = get(GL_FRONT_FACE);
+        s.depthFunc = get(GL_DEPTH_FUNC);
+        GLboolean depthMask = GL_TRUE;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        s.depthMask = depthMask == GL_TRUE;
+        s.blend[0] = get(GL_BLEND_SRC_RGB);
+        s.blend[1] = get(GL_BLEND_DST_RGB);
+        s.blend[2] = get(GL_BLEND_SRC_ALPHA);
+        s.blend[3] = get(GL_BLEND_DST_ALPHA);
+        s.blendEquation[0] = get(GL_BLEND_EQUATION_RGB);
+        s.blendEquation[1] = get(GL_BLEND_EQUATION_ALPHA);
+        glGetIntegerv(GL_VIEWPORT, s.viewport);
+        return s;
+    }
+
+    Snapshot m_State;
+    Counters m_Counters;
+    bool m_Validate = false;
+};
+
+}
+
+#endif //PROJECT_BASE_GLSTATE_H
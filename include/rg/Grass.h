@@ -0,0 +1,176 @@
+#ifndef PROJECT_BASE_GRASS_H
+#define PROJECT_BASE_GRASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/Frustum.h>
+#include <rg/GLState.h>
+#include <rg/GrassField.h>
+#include <stb_image.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// every triangle of the model's bind pose in world space, three positions each
+inline void collectTriangles(const Model& model, const glm::mat4& world, std::vector<glm::vec3>& triangles) {
+    for (const Mesh& mesh : model.meshes) {
+        const glm::mat4 transform = world * model.nodes[mesh.node].world;
+        // level 0 only, coarser levels of detail are appended to the same indices
+        for (uint32_t i = 0; i < mesh.lods[0].indexCount; ++i) {
+            triangles.push_back(glm::vec3(transform * glm::vec4(mesh.vertices[mesh.indices[i]].Position, 1.0f)));
+        }
+    }
+}
+
+// an 8-bit grayscale image, an empty map (density 1) when the file does not load
+inline DensityMap loadDensityMap(const std::string& path) {
+    DensityMap map;
+    int channels;
+    unsigned char* data = stbi_load(path.c_str(), &map.width, &map.height, &channels, 1);
+    if (!data) {
+        std::cout << "Grass: density map failed to load at path: " << path << std::endl;
+        map.width = map.height = 0;
+        return map;
+    }
+    map.values.assign(data, data + (size_t) map.width * map.height);
+    stbi_image_free(data);
+    return map;
+}
+
+// Draws a GrassField. The blades are uploaded once into a static instance
+// buffer; a blade is a strip of seven vertices (three segments narrowing to
+// the tip) that grass.vs bends, turns and sways in the wind from its instance
+// data. Each frame the field's chunks are culled on the CPU and the visible
+// blade ranges are drawn with one glMultiDrawArraysIndirect, the range's first
+// blade as the command's baseInstance. Without ARB_multi_draw_indirect every
+// range is its own instanced draw with the instance attributes pointed at it.
+class GrassRenderer {
+public:
+    struct Stats {
+        unsigned int chunks = 0;   // visible
+        unsigned int blades = 0;
+        unsigned int calls = 0;
+    };
+
+    static const GLsizei BladeVertices = 7;
+
+    explicit GrassRenderer(const GrassField& field) : m_Field(field) {
+        m_Indirect = GLAD_GL_ARB_draw_indirect && GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance;
+        // (side, height along the blade), side -1..1 across, narrowing to a point
+        const float strip[BladeVertices * 2] = { -1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.33f, 1.0f, 0.33f,
+                                                 -1.0f, 0.66f, 1.0f, 0.66f, 0.0f, 1.0f };
+        GLState& gl = GLState::instance();
+        glGenVertexArrays(1, &m_Vao);
+        glGenBuffers(1, &m_StripBuffer);
+        glGenBuffers(1, &m_InstanceBuffer);
+        gl.bindVertexArray(m_Vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_StripBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(strip), strip, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*) 0);
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, field.blades().size() * sizeof(GrassBlade), field.blades().data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        pointInstances(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gl.bindVertexArray(0);
+        GLLABEL(GL_VERTEX_ARRAY, m_Vao, "grass");
+        GLLABEL(GL_BUFFER, m_InstanceBuffer, "grass blades");
+        if (m_Indirect) {
+            glGenBuffers(1, &m_CommandBuffer);
+        }
+    }
+
+    GrassRenderer(const GrassRenderer&) = delete;
+    GrassRenderer& operator=(const GrassRenderer&) = delete;
+
+    ~GrassRenderer() {
+        GLState::instance().bindVertexArray(0);
+        glDeleteVertexArrays(1, &m_Vao);
+        glDeleteBuffers(1, &m_StripBuffer);
+        glDeleteBuffers(1, &m_InstanceBuffer);
+        glDeleteBuffers(1, &m_CommandBuffer);
+    }
+
+    // The shader is grass.vs/fs with view, projection, time and the light
+    // already set. Blades are two-sided, culling is off while they draw.
+    void draw(Shader& shader, const Frustum& frustum, const glm::vec3& eye, float maxDistance, float fadeStart = 0.5f) {
+        m_Stats = Stats();
+        m_Field.cull(frustum, eye, maxDistance, fadeStart, m_Draws);
+        if (m_Draws.empty()) {
+            return;
+        }
+        GLGROUP("Grass");
+        GLState& gl = GLState::instance();
+        gl.useProgram(shader.ID);
+        gl.bindVertexArray(m_Vao);
+        const bool cullWas = gl.enabled(GL_CULL_FACE);
+        gl.disable(GL_CULL_FACE);
+        m_Stats.chunks = (unsigned int) m_Draws.size();
+        for (const GrassDraw& draw : m_Draws) {
+            m_Stats.blades += draw.count;
+        }
+
+        if (m_Indirect) {
+            m_Commands.clear();
+            for (const GrassDraw& draw : m_Draws) {
+                m_Commands.push_back({ (GLuint) BladeVertices, draw.count, 0, draw.first });
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, m_Commands.size() * sizeof(Command), m_Commands.data(), GL_STREAM_DRAW);
+            glMultiDrawArraysIndirect(GL_TRIANGLE_STRIP, (void*) 0, (GLsizei) m_Commands.size(), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            m_Stats.calls = 1;
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+            for (const GrassDraw& draw : m_Draws) {
+                pointInstances(draw.first);
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, BladeVertices, (GLsizei) draw.count);
+            }
+            pointInstances(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            m_Stats.calls = (unsigned int) m_Draws.size();
+        }
+        gl.setEnabled(GL_CULL_FACE, cullWas);
+    }
+
+    const Stats& stats() const {
+        return m_Stats;
+    }
+
+private:
+    // layout fixed by ARB_draw_indirect
+    struct Command {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint first;
+        GLuint baseInstance;
+    };
+
+    // the instance attributes start at the given blade, the instance buffer must be bound
+    static void pointInstances(uint32_t first) {
+        const size_t offset = first * sizeof(GrassBlade);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GrassBlade), (void*) offset);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(GrassBlade), (void*) (offset + 4 * sizeof(float)));
+    }
+
+    const GrassField& m_Field;
+    bool m_Indirect = false;
+    GLuint m_Vao = 0, m_StripBuffer = 0, m_InstanceBuffer = 0, m_CommandBuffer = 0;
+    std::vector<GrassDraw> m_Draws;
+    std::vector<Command> m_Commands;
+    Stats m_Stats;
+};
+
+}
+
+#endif //PROJECT_BASE_GRASS_H
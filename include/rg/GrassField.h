@@ -0,0 +1,233 @@
+#ifndef PROJECT_BASE_GRASSFIELD_H
+#define PROJECT_BASE_GRASSFIELD_H
+
+#include <glm/glm.hpp>
+#include <rg/Frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+// One blade, 32 bytes, the layout of the instance buffer grass.vs reads:
+// attribute 1 is position and yaw, attribute 2 the rest.
+struct GrassBlade {
+    glm::vec3 position;
+    float yaw;
+    float height;
+    float width;
+    float phase;   // offset into the wind cycle
+    float tint;    // 0..1, picks the blade's shade
+};
+
+// a range of blades that are culled together, blades inside it in random order
+struct GrassChunk {
+    uint32_t first = 0;
+    uint32_t count = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// a range of blades to draw this frame
+struct GrassDraw {
+    uint32_t first;
+    uint32_t count;
+};
+
+struct GrassSettings {
+    uint32_t blades = 100000;
+    float chunkSize = 4.0f;          // world units
+    float minHeight = 0.15f;
+    float maxHeight = 0.35f;
+    float width = 0.03f;
+    float minUp = 0.8f;              // flattest slope grass grows on, as the normal's y
+    float maxWindStrength = 1.0f;    // strongest wind the chunk bounds leave room for, the "Wind" slider's top
+    uint32_t seed = 1;
+};
+
+// Grayscale image spread over the XZ bounds of the surface; a blade is kept
+// with the probability of the value under it. Empty means density 1 everywhere.
+struct DensityMap {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> values;   // row 0 at the -z edge
+
+    // bilinear, u along x and v along z in [0, 1]
+    float sample(float u, float v) const {
+        if (values.empty()) {
+            return 1.0f;
+        }
+        const float x = std::min(std::max(u, 0.0f), 1.0f) * (width - 1);
+        const float y = std::min(std::max(v, 0.0f), 1.0f) * (height - 1);
+        const int x0 = (int) x, y0 = (int) y;
+        const int x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+        const float fx = x - x0, fy = y - y0;
+        const float top = values[y0 * width + x0] * (1.0f - fx) + values[y0 * width + x1] * fx;
+        const float bottom = values[y1 * width + x0] * (1.0f - fx) + values[y1 * width + x1] * fx;
+        return (top * (1.0f - fy) + bottom * fy) / 255.0f;
+    }
+};
+
+// Blades scattered over a triangle surface, grouped into square chunks of
+// the XZ plane so whole chunks are culled against the frustum and the draw
+// distance. Each chunk is one contiguous range of blades() in random order,
+// so drawing only the first part of a range is an even thinning of the chunk,
+// which is how far chunks fade out.
+class GrassField {
+public:
+    // Triangles are world space positions, three per triangle, wound
+    // counter-clockwise seen from above. Blades land on the ones facing up by
+    // at least minUp, spread by area and thinned by the density map.
+    void scatter(const std::vector<glm::vec3>& triangles, const DensityMap& density, const GrassSettings& settings) {
+        m_Blades.clear();
+        m_Chunks.clear();
+        std::vector<uint32_t> candidates;
+        std::vector<float> cumulativeArea;
+        float totalArea = 0.0f;
+        glm::vec3 surfaceMin(INFINITY), surfaceMax(-INFINITY);
+        for (uint32_t t = 0; t + 2 < triangles.size(); t += 3) {
+            const glm::vec3 n = glm::cross(triangles[t + 1] - triangles[t], triangles[t + 2] - triangles[t]);
+            const float length = glm::length(n);
+            if (length <= 0.0f || n.y < settings.minUp * length) {
+                continue;
+            }
+            totalArea += 0.5f * length;
+            candidates.push_back(t);
+            cumulativeArea.push_back(totalArea);
+            for (int k = 0; k < 3; ++k) {
+                surfaceMin = glm::min(surfaceMin, triangles[t + k]);
+                surfaceMax = glm::max(surfaceMax, triangles[t + k]);
+            }
+        }
+        if (candidates.empty() || settings.blades == 0) {
+            return;
+        }
+
+        uint32_t state = settings.seed * 2654435761u + 1u;
+        auto random = [&state] {
+            // xorshift32, the top 24 bits as a float in [0, 1)
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return (state >> 8) / 16777216.0f;
+        };
+        const glm::vec3 extent = glm::max(surfaceMax - surfaceMin, glm::vec3(1e-6f));
+        // a sparse density map rejects most tries, give up after this many per blade
+        const uint64_t maxTries = (uint64_t) settings.blades * 16;
+        std::vector<GrassBlade> scattered;
+        scattered.reserve(settings.blades);
+        for (uint64_t tries = 0; tries < maxTries && scattered.size() < settings.blades; ++tries) {
+            const size_t pick = std::upper_bound(cumulativeArea.begin(), cumulativeArea.end(), random() * totalArea) -
+                                cumulativeArea.begin();
+            const uint32_t t = candidates[std::min(pick, candidates.size() - 1)];
+            // uniform point in the triangle
+            float a = random(), b = random();
+            if (a + b > 1.0f) {
+                a = 1.0f - a;
+                b = 1.0f - b;
+            }
+            const glm::vec3 p = triangles[t] + (triangles[t + 1] - triangles[t]) * a + (triangles[t + 2] - triangles[t]) * b;
+            if (random() >= density.sample((p.x - surfaceMin.x) / extent.x, (p.z - surfaceMin.z) / extent.z)) {
+                continue;
+            }
+            GrassBlade blade;
+            blade.position = p;
+            blade.yaw = random() * 6.2831853f;
+            blade.height = settings.minHeight + (settings.maxHeight - settings.minHeight) * random();
+            blade.width = settings.width * (0.7f + 0.6f * random());
+            blade.phase = random() * 6.2831853f;
+            blade.tint = random();
+            scattered.push_back(blade);
+        }
+        buildChunks(scattered, surfaceMin, surfaceMax, settings);
+    }
+
+    // Blade ranges of the chunks in the frustum and closer than maxDistance.
+    // Chunks further than fadeStart * maxDistance draw a shrinking share of
+    // their blades, none at maxDistance.
+    void cull(const Frustum& frustum, const glm::vec3& eye, float maxDistance, float fadeStart,
+              std::vector<GrassDraw>& draws) const {
+        draws.clear();
+        const float fadeFrom = fadeStart * maxDistance;
+        for (const GrassChunk& chunk : m_Chunks) {
+            // distance to the closest point of the box
+            const glm::vec3 closest = glm::min(glm::max(eye, chunk.boundsMin), chunk.boundsMax);
+            const float distance = glm::length(closest - eye);
+            if (distance >= maxDistance || !frustum.intersects(chunk.boundsMin, chunk.boundsMax)) {
+                continue;
+            }
+            float keep = 1.0f;
+            if (distance > fadeFrom) {
+                keep = (maxDistance - distance) / std::max(maxDistance - fadeFrom, 1e-6f);
+            }
+            const uint32_t count = (uint32_t) std::ceil(chunk.count * keep);
+            if (count) {
+                draws.push_back({ chunk.first, std::min(count, chunk.count) });
+            }
+        }
+    }
+
+    const std::vector<GrassBlade>& blades() const {
+        return m_Blades;
+    }
+
+    const std::vector<GrassChunk>& chunks() const {
+        return m_Chunks;
+    }
+
+private:
+    // counting sort of the blades by the chunk they stand in, keeping their random order within it
+    void buildChunks(const std::vector<GrassBlade>& scattered, const glm::vec3& surfaceMin, const glm::vec3& surfaceMax,
+                     const GrassSettings& settings) {
+        const float size = std::max(settings.chunkSize, 1e-3f);
+        const int columns = std::max(1, (int) std::ceil((surfaceMax.x - surfaceMin.x) / size));
+        const int rows = std::max(1, (int) std::ceil((surfaceMax.z - surfaceMin.z) / size));
+        auto cellOf = [&](const glm::vec3& p) {
+            const int x = std::min(std::max((int) ((p.x - surfaceMin.x) / size), 0), columns - 1);
+            const int z = std::min(std::max((int) ((p.z - surfaceMin.z) / size), 0), rows - 1);
+            return (size_t) z * columns + x;
+        };
+        std::vector<uint32_t> offsets((size_t) columns * rows + 1, 0);
+        for (const GrassBlade& blade : scattered) {
+            ++offsets[cellOf(blade.position) + 1];
+        }
+        for (size_t c = 1; c < offsets.size(); ++c) {
+            offsets[c] += offsets[c - 1];
+        }
+        m_Blades.resize(scattered.size());
+        std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+        for (const GrassBlade& blade : scattered) {
+            m_Blades[next[cellOf(blade.position)]++] = blade;
+        }
+
+        for (size_t c = 0; c + 1 < offsets.size(); ++c) {
+            if (offsets[c] == offsets[c + 1]) {
+                continue;
+            }
+            GrassChunk chunk;
+            chunk.first = offsets[c];
+            chunk.count = offsets[c + 1] - offsets[c];
+            chunk.boundsMin = glm::vec3(INFINITY);
+            chunk.boundsMax = glm::vec3(-INFINITY);
+            for (uint32_t i = chunk.first; i < chunk.first + chunk.count; ++i) {
+                chunk.boundsMin = glm::min(chunk.boundsMin, m_Blades[i].position);
+                chunk.boundsMax = glm::max(chunk.boundsMax, m_Blades[i].position);
+            }
+            // blades stand up from their root; grass.vs leans the tip by up to
+            // (0.25 + 1.15 windStrength) heights and the strip adds half its width
+            const float reach = settings.maxHeight * (0.25f + 1.15f * settings.maxWindStrength) + 0.5f * settings.width;
+            chunk.boundsMin = chunk.boundsMin - glm::vec3(reach, 0.0f, reach);
+            chunk.boundsMax = chunk.boundsMax + glm::vec3(reach, settings.maxHeight, reach);
+            m_Chunks.push_back(chunk);
+        }
+    }
+
+    std::vector<GrassBlade> m_Blades;
+    std::vector<GrassChunk> m_Chunks;
+};
+
+}
+
+#endif //PROJECT_BASE_GRASSFIELD_H
@@ -0,0 +1,366 @@
+#ifndef PROJECT_BASE_IMPOSTOR_H
+#define PROJECT_BASE_IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/GLState.h>
+#include <rg/MeshLod.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace rg {
+
+// Far instances of a model drawn as one camera-facing quad each instead of
+// its meshes.
+//
+// A model is baked once into an atlas of frames: columns go around the
+// model's up axis, rows from below to above the horizon, each frame an
+// orthographic view of the bounding sphere. The atlas holds the albedo with
+// coverage in alpha and the model space normal, so the quads are still lit by
+// the directional light at runtime. Baking renders the meshes with
+// Model::Draw into a framebuffer, one viewport per frame, then bleeds the
+// colors of covered texels into the empty ones so the mip chain does not
+// darken the silhouettes.
+//
+// At runtime an instance beyond the model's impostor distance is queued here
+// instead of being submitted to the DrawBatcher. flush() uploads the queued
+// instances (bounding sphere and yaw) into one instance buffer and issues one
+// instanced draw per model. impostor.vs picks the frame from the direction to
+// the eye in the instance's frame and blends the two nearest columns. Only the
+// rotation about the up axis is taken from an instance's transform.
+class ImpostorRenderer {
+public:
+    struct Stats {
+        unsigned int impostors = 0;
+        unsigned int calls = 0;
+    };
+
+    ImpostorRenderer() {
+        // unit quad as a strip, corners in the plane facing the camera
+        const float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+        glGenVertexArrays(1, &m_Vao);
+        glGenBuffers(1, &m_QuadBuffer);
+        glGenBuffers(1, &m_InstanceBuffer);
+        GLState::instance().bindVertexArray(m_Vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_QuadBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*) 0);
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GLState::instance().bindVertexArray(0);
+        GLLABEL(GL_VERTEX_ARRAY, m_Vao, "impostor quads");
+        GLLABEL(GL_BUFFER, m_InstanceBuffer, "impostor instances");
+    }
+
+    ImpostorRenderer(const ImpostorRenderer&) = delete;
+    ImpostorRenderer& operator=(const ImpostorRenderer&) = delete;
+
+    ~ImpostorRenderer() {
+        GLState& gl = GLState::instance();
+        for (Kind& kind : m_Kinds) {
+            gl.forgetTexture(kind.albedo);
+            gl.forgetTexture(kind.normal);
+            glDeleteTextures(1, &kind.albedo);
+            glDeleteTextures(1, &kind.normal);
+        }
+        gl.bindVertexArray(0);
+        glDeleteVertexArrays(1, &m_Vao);
+        glDeleteBuffers(1, &m_QuadBuffer);
+        glDeleteBuffers(1, &m_InstanceBuffer);
+    }
+
+    // Registers a model whose instances turn into impostors from distance on
+    // (world units, measured to the instance's bounding sphere center). Nothing
+    // is drawn as an impostor until bake() has run. Returns the model's kind.
+    unsigned int add(Model& model, float distance, unsigned int columns = 8, unsigned int rows = 4,
+                     unsigned int frameSize = 128) {
+        Kind kind;
+        kind.model = &model;
+        kind.distance = distance;
+        kind.columns = std::max(1u, columns);
+        kind.rows = std::max(1u, rows);
+        kind.frameSize = std::max(8u, frameSize);
+        m_Kinds.push_back(kind);
+        return (unsigned int) m_Kinds.size() - 1;
+    }
+
+    bool baked() const {
+        for (const Kind& kind : m_Kinds) {
+            if (!kind.albedo) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Bakes the atlases of the models registered since the last call. The
+    // models' textures should be resident by now, what is baked is kept. The GL
+    // state is put back the way it was found.
+    void bake(Shader& bakeShader) {
+        GLState& gl = GLState::instance();
+        const GLState::Snapshot saved = gl.save();
+        GLGROUP("Impostor bake");
+        for (Kind& kind : m_Kinds) {
+            if (!kind.albedo && kind.model->VAO) {
+                bakeKind(kind, bakeShader);
+            }
+        }
+        gl.restore(saved);
+    }
+
+    // set before the instances of a frame are submitted
+    void setView(const glm::vec3& eye) {
+        m_Eye = eye;
+    }
+
+    // Queues the instance when it is far enough and the model's atlas is
+    // baked; false means the caller draws the model itself.
+    bool submit(unsigned int kind, const glm::mat4& model) {
+        Kind& k = m_Kinds[kind];
+        if (!k.albedo) {
+            return false;
+        }
+        const glm::vec3 center = glm::vec3(model * glm::vec4(k.center, 1.0f));
+        const glm::vec3 offset = center - m_Eye;
+        if (glm::dot(offset, offset) < k.distance * k.distance) {
+            return false;
+        }
+        // the image of the model's x axis gives the rotation about the up axis
+        Instance instance;
+        instance.center = center;
+        instance.radius = k.radius * maxScale(model);
+        instance.yaw = std::atan2(-model[0].z, model[0].x);
+        k.instances.push_back(instance);
+        return true;
+    }
+
+    // Draws everything submitted since the last flush. The shader is
+    // impostor.vs/fs with view, projection, viewPos and the light already set.
+    void flush(Shader& shader) {
+        m_Stats = Stats();
+        m_Upload.clear();
+        for (const Kind& kind : m_Kinds) {
+            m_Upload.insert(m_Upload.end(), kind.instances.begin(), kind.instances.end());
+        }
+        if (m_Upload.empty()) {
+            return;
+        }
+        GLGROUP("Impostors");
+        GLState& gl = GLState::instance();
+        gl.useProgram(shader.ID);
+        gl.bindVertexArray(m_Vao);
+        const bool cullWas = gl.enabled(GL_CULL_FACE);
+        gl.disable(GL_CULL_FACE);
+        shader.setInt("albedo", 0);
+        shader.setInt("normals", 1);
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, m_Upload.size() * sizeof(Instance), m_Upload.data(), GL_STREAM_DRAW);
+        size_t first = 0;
+        for (Kind& kind : m_Kinds) {
+            if (kind.instances.empty()) {
+                continue;
+            }
+            // instanced attributes start at the kind's range of the buffer
+            const size_t offset = first * sizeof(Instance);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*) offset);
+            glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*) (offset + 4 * sizeof(float)));
+            gl.bindTexture(0, GL_TEXTURE_2D, kind.albedo);
+            gl.bindTexture(1, GL_TEXTURE_2D, kind.normal);
+            shader.setInt("columns", (int) kind.columns);
+            shader.setInt("rows", (int) kind.rows);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei) kind.instances.size());
+            m_Stats.impostors += (unsigned int) kind.instances.size();
+            ++m_Stats.calls;
+            first += kind.instances.size();
+            kind.instances.clear();
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gl.setEnabled(GL_CULL_FACE, cullWas);
+    }
+
+    const Stats& stats() const {
+        return m_Stats;
+    }
+
+private:
+    // one per instance, attribute 1 is center and radius, attribute 2 the yaw
+    struct Instance {
+        glm::vec3 center;
+        float radius;
+        float yaw;
+    };
+
+    struct Kind {
+        Model* model = nullptr;
+        float distance = 0.0f;
+        unsigned int columns = 8, rows = 4, frameSize = 128;
+        // the model's bounding sphere the frames were rendered around
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+        GLuint albedo = 0, normal = 0;
+        std::vector<Instance> instances;
+    };
+
+    // Direction from the center to the camera of a frame. Columns start on
+    // the model's +z axis, rows are spread evenly over (-90, 90) degrees of
+    // elevation; impostor.vs inverts this.
+    static glm::vec3 frameDirection(const Kind& kind, unsigned int column, unsigned int row) {
+        const float pi = 3.14159265f;
+        const float yaw = 2.0f * pi * column / kind.columns;
+        const float elevation = pi * ((row + 0.5f) / kind.rows - 0.5f);
+        return glm::vec3(std::sin(yaw) * std::cos(elevation), std::sin(elevation), std::cos(yaw) * std::cos(elevation));
+    }
+
+    void bakeKind(Kind& kind, Shader& bakeShader) {
+        GLState& gl = GLState::instance();
+        Model& model = *kind.model;
+        kind.center = model.boundsCenter;
+        kind.radius = std::max(model.boundsRadius, 1e-4f);
+        const GLsizei width = (GLsizei) (kind.columns * kind.frameSize);
+        const GLsizei height = (GLsizei) (kind.rows * kind.frameSize);
+
+        GLuint textures[2];
+        glGenTextures(2, textures);
+        for (GLuint texture : textures) {
+            gl.bindTexture(0, GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        GLLABEL(GL_TEXTURE, textures[0], "impostor albedo");
+        GLLABEL(GL_TEXTURE, textures[1], "impostor normals");
+
+        GLuint framebuffer, depth;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &depth);
+        gl.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[0], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, textures[1], 0);
+        const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Impostor: framebuffer not complete" << std::endl;
+        }
+
+        gl.viewport(0, 0, width, height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        gl.enable(GL_DEPTH_TEST);
+        gl.depthFunc(GL_LESS);
+        gl.depthMask(true);
+        gl.disable(GL_BLEND);
+        gl.disable(GL_CULL_FACE);
+
+        gl.useProgram(bakeShader.ID);
+        const float r = kind.radius;
+        bakeShader.setMat4("projection", glm::ortho(-r, r, -r, r, 0.5f * r, 3.5f * r));
+        for (unsigned int row = 0; row < kind.rows; ++row) {
+            for (unsigned int column = 0; column < kind.columns; ++column) {
+                const glm::vec3 eye = kind.center + frameDirection(kind, column, row) * (2.0f * r);
+                gl.viewport((GLint) (column * kind.frameSize), (GLint) (row * kind.frameSize),
+                            (GLsizei) kind.frameSize, (GLsizei) kind.frameSize);
+                bakeShader.setMat4("view", glm::lookAt(eye, kind.center, glm::vec3(0.0f, 1.0f, 0.0f)));
+                model.Draw(bakeShader, glm::mat4(1.0f));
+            }
+        }
+
+        gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        gl.forgetFramebuffer(framebuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glDeleteRenderbuffers(1, &depth);
+
+        dilate(textures[0], textures[1], width, height);
+        kind.albedo = textures[0];
+        kind.normal = textures[1];
+    }
+
+    // Fills the uncovered texels next to covered ones with the average of
+    // their covered neighbours, a few rings deep, and builds the mip chains.
+    // Coverage stays 0 there, only the colors the filter blends in change.
+    static void dilate(GLuint albedo, GLuint normal, GLsizei width, GLsizei height) {
+        GLState& gl = GLState::instance();
+        std::vector<uint8_t> color((size_t) width * height * 4), normals((size_t) width * height * 4);
+        // rows are width * 4 bytes, the default alignment of 4 fits both ways
+        gl.bindTexture(0, GL_TEXTURE_2D, albedo);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, color.data());
+        gl.bindTexture(0, GL_TEXTURE_2D, normal);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, normals.data());
+
+        // covered: 0 empty, 1 rendered or filled in an earlier ring
+        std::vector<uint8_t> covered((size_t) width * height), next;
+        for (size_t i = 0; i < covered.size(); ++i) {
+            covered[i] = color[i * 4 + 3] > 0;
+        }
+        const int rings = 4;
+        for (int ring = 0; ring < rings; ++ring) {
+            next = covered;
+            for (GLsizei y = 0; y < height; ++y) {
+                for (GLsizei x = 0; x < width; ++x) {
+                    const size_t i = (size_t) y * width + x;
+                    if (covered[i]) {
+                        continue;
+                    }
+                    unsigned int sum[6] = {}, count = 0;
+                    for (int dy = -1; dy <= 1; ++dy) {
+                        for (int dx = -1; dx <= 1; ++dx) {
+                            const GLsizei nx = x + dx, ny = y + dy;
+                            if (nx < 0 || ny < 0 || nx >= width || ny >= height || !covered[(size_t) ny * width + nx]) {
+                                continue;
+                            }
+                            const size_t n = (size_t) ny * width + nx;
+                            for (int c = 0; c < 3; ++c) {
+                                sum[c] += color[n * 4 + c];
+                                sum[3 + c] += normals[n * 4 + c];
+                            }
+                            ++count;
+                        }
+                    }
+                    if (count) {
+                        for (int c = 0; c < 3; ++c) {
+                            color[i * 4 + c] = (uint8_t) (sum[c] / count);
+                            normals[i * 4 + c] = (uint8_t) (sum[3 + c] / count);
+                        }
+                        next[i] = 1;
+                    }
+                }
+            }
+            covered.swap(next);
+        }
+
+        gl.bindTexture(0, GL_TEXTURE_2D, albedo);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, color.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        gl.bindTexture(0, GL_TEXTURE_2D, normal);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, normals.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    GLuint m_Vao = 0, m_QuadBuffer = 0, m_InstanceBuffer = 0;
+    std::vector<Kind> m_Kinds;
+    std::vector<Instance> m_Upload;
+    glm::vec3 m_Eye = glm::vec3(0.0f);
+    Stats m_Stats;
+};
+
+}
+
+#endif //PROJECT_BASE_IMPOSTOR_H
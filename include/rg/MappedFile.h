@@ -0,0 +1,84 @@
+#ifndef PROJECT_BASE_MAPPEDFILE_H
+#define PROJECT_BASE_MAPPEDFILE_H
+
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rg {
+
+// Read-only memory mapping of a whole file. Image decoders read straight out
+// of the page cache instead of through stdio's small buffer, so loading an
+// image costs an open, an fstat and an mmap rather than one read() per 4 KB.
+class MappedFile {
+public:
+    enum Access {
+        Sequential, // read once front to back, pages can be dropped behind us
+        WillNeed    // start readahead now, the data is read a bit later
+    };
+
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path, Access access = Sequential) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* data = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                m_Data = static_cast<const unsigned char*>(data);
+                m_Size = (size_t) st.st_size;
+                madvise(data, m_Size, access == Sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+            }
+        }
+        // the mapping keeps the file referenced
+        close(fd);
+    }
+
+    MappedFile(MappedFile&& other) noexcept
+            : m_Data(other.m_Data), m_Size(other.m_Size) {
+        other.m_Data = nullptr;
+        other.m_Size = 0;
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        std::swap(m_Data, other.m_Data);
+        std::swap(m_Size, other.m_Size);
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (m_Data) {
+            munmap(const_cast<unsigned char*>(m_Data), m_Size);
+        }
+    }
+
+    bool valid() const {
+        return m_Data != nullptr;
+    }
+
+    const unsigned char* data() const {
+        return m_Data;
+    }
+
+    size_t size() const {
+        return m_Size;
+    }
+
+private:
+    const unsigned char* m_Data = nullptr;
+    size_t m_Size = 0;
+};
+
+}
+
+#endif //PROJECT_BASE_MAPPEDFILE_H
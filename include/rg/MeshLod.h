@@ -0,0 +1,696 @@
+#ifndef PROJECT_BASE_MESHLOD_H
+#define PROJECT_BASE_MESHLOD_H
+
+#include <glm/glm.hpp>
+#include <rg/RadixSort.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// One level of detail of a mesh: a range of the mesh's index buffer, every
+// level indexing the same vertices.
+struct MeshLod {
+    uint32_t firstIndex;   // relative to the mesh's first index
+    uint32_t indexCount;
+    float error;           // largest distance from a vertex of level 0 to this level's surface, in mesh units
+};
+
+// What the simplifier reads from a vertex buffer. Positions and attributes
+// are floats inside the same interleaved vertices.
+struct SimplifyMesh {
+    const float* positions = nullptr;         // x, y, z
+    const float* attributes = nullptr;        // attributeCount floats per vertex, e.g. normal and uv
+    const float* attributeWeights = nullptr;  // how much each attribute's change costs, nullptr for all 1
+    unsigned int attributeCount = 0;
+    size_t vertexCount = 0;
+    size_t stride = 0;                        // bytes from one vertex to the next
+};
+
+// A position error quadric (Garland & Heckbert): the weighted sum of squared
+// distances to a set of planes, evaluated at any point.
+struct Quadric {
+    float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f, a01 = 0.0f, a02 = 0.0f, a12 = 0.0f;
+    float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f, c = 0.0f;
+    float weight = 0.0f;
+
+    // plane n.p + d = 0, n unit length
+    void addPlane(const glm::vec3& n, float d, float w) {
+        a00 += w * n.x * n.x; a11 += w * n.y * n.y; a22 += w * n.z * n.z;
+        a01 += w * n.x * n.y; a02 += w * n.x * n.z; a12 += w * n.y * n.z;
+        b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q) {
+        a00 += q.a00; a11 += q.a11; a22 += q.a22; a01 += q.a01; a02 += q.a02; a12 += q.a12;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+        weight += q.weight;
+    }
+
+    float evaluate(const glm::vec3& p) const {
+        const float rx = a00 * p.x + a01 * p.y + a02 * p.z + 2.0f * b0;
+        const float ry = a01 * p.x + a11 * p.y + a12 * p.z + 2.0f * b1;
+        const float rz = a02 * p.x + a12 * p.y + a22 * p.z + 2.0f * b2;
+        return std::fabs(rx * p.x + ry * p.y + rz * p.z + c);
+    }
+};
+
+// Closest point to p on triangle abc, by the region of the triangle p falls
+// in (Ericson, Real-Time Collision Detection 5.1.5).
+inline glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return a;
+    }
+    const glm::vec3 bp = p - b;
+    const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        return b;
+    }
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+    const glm::vec3 cp = p - c;
+    const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        return c;
+    }
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    const float denominator = 1.0f / std::max(va + vb + vc, FLT_MIN);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Quadric error mesh simplification by half-edge collapses: a vertex is
+// merged into one of its neighbours, so every level indexes a subset of the
+// original vertices and all levels share one vertex buffer.
+//
+// The cost of a collapse is the position quadric of the collapsed vertex at
+// its target, plus the squared change of its attributes (normals, uvs)
+// weighted by the area around it. Vertices sharing a position but not their
+// attributes (uv and hard-normal seams) are its wedges; each wedge moves to
+// the target's vertex it shares an edge with, so seams collapse along
+// themselves for free and across only at the price of their attribute jump.
+// Open borders only collapse along the border and non-manifold edges stay put.
+//
+// Collapses are done in passes: every vertex gets its cheapest collapse, then
+// they are applied cheapest first, each one locking its neighbourhood until
+// the next pass. Positions are scaled to the unit cube; error() and
+// deviation() are relative to extent().
+class MeshSimplifier {
+public:
+    static const unsigned int MaxAttributes = 16;
+
+    MeshSimplifier(const SimplifyMesh& mesh, const uint32_t* indices, size_t indexCount) {
+        const size_t count = mesh.vertexCount;
+        const unsigned int attributeCount = std::min(mesh.attributeCount, (unsigned int) MaxAttributes);
+        m_AttributeCount = attributeCount;
+        m_Positions.resize(count);
+        m_Attributes.resize(count * attributeCount);
+
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+        for (size_t v = 0; v < count; ++v) {
+            const float* p = vertexFloats(mesh.positions, mesh.stride, v);
+            m_Positions[v] = glm::vec3(p[0], p[1], p[2]);
+            boundsMin = glm::min(boundsMin, m_Positions[v]);
+            boundsMax = glm::max(boundsMax, m_Positions[v]);
+        }
+        const glm::vec3 size = count ? boundsMax - boundsMin : glm::vec3(0.0f);
+        m_Extent = std::max(std::max(size.x, size.y), std::max(size.z, FLT_MIN));
+
+        // keys are the exact input floats, welding must not depend on rounding
+        const size_t keySize = 3 + attributeCount;
+        std::vector<float> keys(count * keySize);
+        for (size_t v = 0; v < count; ++v) {
+            std::memcpy(&keys[v * keySize], vertexFloats(mesh.positions, mesh.stride, v), 3 * sizeof(float));
+            if (attributeCount) {
+                std::memcpy(&keys[v * keySize + 3], vertexFloats(mesh.attributes, mesh.stride, v),
+                            attributeCount * sizeof(float));
+            }
+        }
+        for (size_t v = 0; v < count; ++v) {
+            m_Positions[v] = (m_Positions[v] - boundsMin) / m_Extent;
+            for (unsigned int a = 0; a < attributeCount; ++a) {
+                const float weight = mesh.attributeWeights ? mesh.attributeWeights[a] : 1.0f;
+                m_Attributes[v * attributeCount + a] = keys[v * keySize + 3 + a] * std::sqrt(weight);
+            }
+        }
+
+        // vertices identical in everything collapse to one, vertices sharing
+        // only a position are the wedges of that position
+        std::vector<uint32_t> canonical;
+        weld(keys, keySize, keySize, canonical);
+        weld(keys, keySize, 3, m_PositionId);
+        m_WedgeNext.resize(count);
+        for (uint32_t v = 0; v < count; ++v) {
+            m_WedgeNext[v] = v;
+        }
+        for (uint32_t v = 0; v < count; ++v) {
+            const uint32_t position = m_PositionId[v];
+            if (canonical[v] == v && position != v) {
+                m_WedgeNext[v] = m_WedgeNext[position];
+                m_WedgeNext[position] = v;
+            }
+        }
+
+        m_Indices.reserve(indexCount);
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            const uint32_t a = canonical[indices[i]], b = canonical[indices[i + 1]], c = canonical[indices[i + 2]];
+            if (a != b && b != c && a != c) {
+                m_Indices.push_back(a);
+                m_Indices.push_back(b);
+                m_Indices.push_back(c);
+            }
+        }
+        m_Remap.resize(count);
+        m_Merged.resize(count);
+        for (uint32_t v = 0; v < count; ++v) {
+            m_Remap[v] = v;
+            m_Merged[v] = v;
+        }
+        std::vector<uint8_t> used(count, 0);
+        for (uint32_t index : m_Indices) {
+            if (!used[m_PositionId[index]]) {
+                used[m_PositionId[index]] = 1;
+                m_InputPositions.push_back(m_PositionId[index]);
+            }
+        }
+        m_Flags.resize(count);
+        m_Target.resize(count);
+        m_Quadrics.resize(count);
+        m_AttributeArea.assign(count, 0.0f);
+
+        countEdges();
+        for (size_t i = 0; i < m_Indices.size(); i += 3) {
+            const uint32_t* t = &m_Indices[i];
+            const glm::vec3& p0 = m_Positions[t[0]];
+            glm::vec3 normal = glm::cross(m_Positions[t[1]] - p0, m_Positions[t[2]] - p0);
+            const float length = glm::length(normal);
+            if (length <= 0.0f) {
+                continue;
+            }
+            normal = normal / length;
+            const float area = 0.5f * length;
+            Quadric plane;
+            plane.addPlane(normal, -glm::dot(normal, p0), area);
+            for (int k = 0; k < 3; ++k) {
+                m_Quadrics[m_PositionId[t[k]]].add(plane);
+                m_AttributeArea[t[k]] += area / 3.0f;
+                // open borders are held in place by a plane through the edge, across the surface
+                const uint32_t from = m_PositionId[t[k]], to = m_PositionId[t[(k + 1) % 3]];
+                if (m_Edges[edgeKey(from, to)] == 1) {
+                    const glm::vec3 edge = m_Positions[to] - m_Positions[from];
+                    const glm::vec3 across = glm::cross(edge, normal);
+                    const float acrossLength = glm::length(across);
+                    if (acrossLength > 0.0f) {
+                        Quadric border;
+                        border.addPlane(across / acrossLength, -glm::dot(across / acrossLength, m_Positions[from]),
+                                        BorderWeight * glm::dot(edge, edge));
+                        m_Quadrics[from].add(border);
+                        m_Quadrics[to].add(border);
+                    }
+                }
+            }
+        }
+    }
+
+    // Collapses until at most targetIndexCount indices are left or the next
+    // collapse would move the surface more than maxError (relative to
+    // extent()). Can be called again with a lower target to continue from the
+    // current level.
+    void simplify(size_t targetIndexCount, float maxError) {
+        const float maxCost = maxError * maxError;
+        while (m_Indices.size() > targetIndexCount) {
+            if (!pass(targetIndexCount, maxCost)) {
+                break;
+            }
+        }
+    }
+
+    const std::vector<uint32_t>& indices() const {
+        return m_Indices;
+    }
+
+    // largest cost of any collapse so far, relative to extent(): a root mean
+    // square over the planes around a vertex, attribute changes included,
+    // not a bound on how far the surface moved
+    float error() const {
+        return std::sqrt(m_Cost);
+    }
+
+    // Largest distance from an input vertex to the current surface, relative
+    // to extent(). Each vertex is measured against the triangles around the
+    // position it was merged into, which can only overestimate the distance
+    // to the whole surface; a vertex whose triangles are all gone counts its
+    // distance to that position.
+    float deviation() {
+        buildAdjacency();
+        float worst = 0.0f;
+        for (uint32_t v : m_InputPositions) {
+            uint32_t root = v;
+            while (m_Merged[root] != root) {
+                root = m_Merged[root];
+            }
+            m_Merged[v] = root;
+            const glm::vec3& point = m_Positions[v];
+            float closest = FLT_MAX;
+            uint32_t wedge = root;
+            do {
+                for (uint32_t i = m_TriangleOffsets[wedge]; i < m_TriangleOffsets[wedge + 1]; ++i) {
+                    const uint32_t* t = &m_Indices[m_Triangles[i] * 3];
+                    const glm::vec3 offset = point - closestPointOnTriangle(point, m_Positions[t[0]], m_Positions[t[1]],
+                                                                            m_Positions[t[2]]);
+                    closest = std::min(closest, glm::dot(offset, offset));
+                }
+                wedge = m_WedgeNext[wedge];
+            } while (wedge != root);
+            if (closest == FLT_MAX) {
+                const glm::vec3 offset = point - m_Positions[root];
+                closest = glm::dot(offset, offset);
+            }
+            worst = std::max(worst, closest);
+        }
+        return std::sqrt(worst);
+    }
+
+    // largest side of the mesh's bounding box
+    float extent() const {
+        return m_Extent;
+    }
+
+private:
+    // keeps borders from being eaten into before the surface is simplified
+    static constexpr float BorderWeight = 10.0f;
+
+    enum Flag : uint8_t {
+        Seen = 1,
+        Border = 2,
+        Locked = 4,
+        Touched = 8
+    };
+
+    static const float* vertexFloats(const float* first, size_t stride, size_t vertex) {
+        return (const float*) ((const char*) first + vertex * stride);
+    }
+
+    static uint64_t edgeKey(uint32_t a, uint32_t b) {
+        return a < b ? (uint64_t) a << 32 | b : (uint64_t) b << 32 | a;
+    }
+
+    // remap[v] = first vertex whose leading size floats of its key match v's exactly
+    static void weld(const std::vector<float>& keys, size_t keySize, size_t size, std::vector<uint32_t>& remap) {
+        const size_t count = keys.size() / keySize;
+        size_t buckets = 1;
+        while (buckets < count * 2) {
+            buckets *= 2;
+        }
+        std::vector<uint32_t> table(buckets, UINT32_MAX);
+        remap.resize(count);
+        for (uint32_t v = 0; v < count; ++v) {
+            const float* key = &keys[v * keySize];
+            uint32_t hash = 2166136261u;
+            for (size_t i = 0; i < size; ++i) {
+                uint32_t bits;
+                std::memcpy(&bits, &key[i], sizeof(bits));
+                hash = (hash ^ bits) * 16777619u;
+            }
+            size_t bucket = hash & (buckets - 1);
+            while (table[bucket] != UINT32_MAX &&
+                   std::memcmp(&keys[table[bucket] * keySize], key, size * sizeof(float)) != 0) {
+                bucket = (bucket + 1) & (buckets - 1);
+            }
+            if (table[bucket] == UINT32_MAX) {
+                table[bucket] = v;
+            }
+            remap[v] = table[bucket];
+        }
+    }
+
+    // how many triangles share each edge between two positions
+    void countEdges() {
+        m_Edges.clear();
+        m_Edges.reserve(m_Indices.size());
+        for (size_t i = 0; i < m_Indices.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                ++m_Edges[edgeKey(m_PositionId[m_Indices[i + k]], m_PositionId[m_Indices[i + (k + 1) % 3]])];
+            }
+        }
+    }
+
+    // triangles around every vertex, m_Triangles[m_TriangleOffsets[v] .. m_TriangleOffsets[v + 1])
+    void buildAdjacency() {
+        m_TriangleOffsets.assign(m_Positions.size() + 1, 0);
+        for (uint32_t index : m_Indices) {
+            ++m_TriangleOffsets[index + 1];
+        }
+        for (size_t v = 0; v < m_Positions.size(); ++v) {
+            m_TriangleOffsets[v + 1] += m_TriangleOffsets[v];
+        }
+        m_Triangles.resize(m_Indices.size());
+        std::vector<uint32_t>& fill = m_Partners;
+        fill.assign(m_TriangleOffsets.begin(), m_TriangleOffsets.end() - 1);
+        for (size_t i = 0; i < m_Indices.size(); ++i) {
+            m_Triangles[fill[m_Indices[i]]++] = (uint32_t) (i / 3);
+        }
+    }
+
+    uint32_t triangleCount(uint32_t vertex) const {
+        return m_TriangleOffsets[vertex + 1] - m_TriangleOffsets[vertex];
+    }
+
+    // For every wedge of position p the vertex at position q it collapses
+    // into: the one it shares a triangle with, so a seam collapses along
+    // itself, or else the wedge of q with the closest attributes, whose
+    // difference then shows up in the collapse cost.
+    void findPartners(uint32_t p, uint32_t q, std::vector<uint32_t>& partners) const {
+        partners.clear();
+        uint32_t wedge = p;
+        do {
+            uint32_t partner = UINT32_MAX;
+            for (uint32_t i = m_TriangleOffsets[wedge]; i < m_TriangleOffsets[wedge + 1] && partner == UINT32_MAX; ++i) {
+                const uint32_t* t = &m_Indices[m_Triangles[i] * 3];
+                for (int k = 0; k < 3; ++k) {
+                    if (m_PositionId[t[k]] == q) {
+                        partner = t[k];
+                        break;
+                    }
+                }
+            }
+            if (triangleCount(wedge)) {
+                if (partner == UINT32_MAX) {
+                    partner = closestWedge(q, wedge);
+                }
+                partners.push_back(wedge);
+                partners.push_back(partner);
+            }
+            wedge = m_WedgeNext[wedge];
+        } while (wedge != p);
+    }
+
+    float attributeDistance(uint32_t a, uint32_t b) const {
+        const float* from = &m_Attributes[a * m_AttributeCount];
+        const float* to = &m_Attributes[b * m_AttributeCount];
+        float distance = 0.0f;
+        for (unsigned int i = 0; i < m_AttributeCount; ++i) {
+            distance += (from[i] - to[i]) * (from[i] - to[i]);
+        }
+        return distance;
+    }
+
+    // the wedge of position q still in use whose attributes are closest to vertex's
+    uint32_t closestWedge(uint32_t q, uint32_t vertex) const {
+        uint32_t closest = q;
+        float best = FLT_MAX;
+        uint32_t wedge = q;
+        do {
+            const float distance = attributeDistance(wedge, vertex);
+            if (triangleCount(wedge) && distance < best) {
+                best = distance;
+                closest = wedge;
+            }
+            wedge = m_WedgeNext[wedge];
+        } while (wedge != q);
+        return closest;
+    }
+
+    float collapseCost(uint32_t p, uint32_t q, const std::vector<uint32_t>& partners) const {
+        const Quadric& quadric = m_Quadrics[p];
+        float cost = quadric.evaluate(m_Positions[q]);
+        for (size_t i = 0; i < partners.size(); i += 2) {
+            cost += m_AttributeArea[partners[i]] * attributeDistance(partners[i], partners[i + 1]);
+        }
+        return cost / std::max(quadric.weight, FLT_MIN);
+    }
+
+    // cheapest allowed collapse of position p into one of its neighbours
+    void findCollapse(uint32_t p) {
+        if (m_Flags[p] & Locked) {
+            return;
+        }
+        float best = FLT_MAX;
+        m_Neighbours.clear();
+        uint32_t wedge = p;
+        do {
+            for (uint32_t i = m_TriangleOffsets[wedge]; i < m_TriangleOffsets[wedge + 1]; ++i) {
+                const uint32_t* t = &m_Indices[m_Triangles[i] * 3];
+                for (int k = 0; k < 3; ++k) {
+                    const uint32_t q = m_PositionId[t[k]];
+                    if (q == p || std::find(m_Neighbours.begin(), m_Neighbours.end(), q) != m_Neighbours.end()) {
+                        continue;
+                    }
+                    m_Neighbours.push_back(q);
+                    if ((m_Flags[p] & Border) && m_Edges[edgeKey(p, q)] != 1) {
+                        continue;
+                    }
+                    findPartners(p, q, m_Partners);
+                    const float cost = collapseCost(p, q, m_Partners);
+                    if (cost < best) {
+                        best = cost;
+                        m_Target[p] = q;
+                    }
+                }
+            }
+            wedge = m_WedgeNext[wedge];
+        } while (wedge != p);
+        if (best < FLT_MAX) {
+            uint32_t bits;
+            std::memcpy(&bits, &best, sizeof(bits));
+            m_Candidates.push_back({ (uint64_t) bits << 32, p });
+        }
+    }
+
+    // true if moving position p onto q turns any surviving triangle around
+    // p over (or flat)
+    bool flips(uint32_t p, uint32_t q) const {
+        const glm::vec3& target = m_Positions[q];
+        uint32_t wedge = p;
+        do {
+            for (uint32_t i = m_TriangleOffsets[wedge]; i < m_TriangleOffsets[wedge + 1]; ++i) {
+                const uint32_t* t = &m_Indices[m_Triangles[i] * 3];
+                if (m_PositionId[t[0]] == q || m_PositionId[t[1]] == q || m_PositionId[t[2]] == q) {
+                    continue;
+                }
+                glm::vec3 corners[3] = { m_Positions[t[0]], m_Positions[t[1]], m_Positions[t[2]] };
+                const glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                for (int k = 0; k < 3; ++k) {
+                    if (t[k] == wedge) {
+                        corners[k] = target;
+                    }
+                }
+                const glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                if (glm::dot(before, after) <= 0.0f) {
+                    return true;
+                }
+            }
+            wedge = m_WedgeNext[wedge];
+        } while (wedge != p);
+        return false;
+    }
+
+    static float candidateCost(const SortItem& candidate) {
+        float cost;
+        const uint32_t bits = (uint32_t) (candidate.key >> 32);
+        std::memcpy(&cost, &bits, sizeof(cost));
+        return cost;
+    }
+
+    // one round of collapses, returns how many were done
+    size_t pass(size_t targetIndexCount, float maxCost) {
+        buildAdjacency();
+        countEdges();
+        std::fill(m_Flags.begin(), m_Flags.end(), 0);
+        for (const auto& edge : m_Edges) {
+            const uint32_t a = (uint32_t) (edge.first >> 32), b = (uint32_t) edge.first;
+            if (edge.second == 1) {
+                m_Flags[a] |= Border;
+                m_Flags[b] |= Border;
+            } else if (edge.second > 2) {
+                m_Flags[a] |= Locked;
+                m_Flags[b] |= Locked;
+            }
+        }
+
+        m_Candidates.clear();
+        for (uint32_t index : m_Indices) {
+            const uint32_t p = m_PositionId[index];
+            if (!(m_Flags[p] & Seen)) {
+                m_Flags[p] |= Seen;
+                findCollapse(p);
+            }
+        }
+        radixSort(m_Candidates, m_SortScratch);
+
+        const size_t triangles = m_Indices.size() / 3;
+        const size_t needed = triangles - std::min(triangles, targetIndexCount / 3);
+        if (m_Candidates.empty()) {
+            return 0;
+        }
+        // A collapse removes about two triangles. Past 1.5 times the cost of
+        // the collapse that would just reach the target, the cheaper ones
+        // that the next pass frees up are preferred.
+        const size_t goal = std::min(needed / 2, m_Candidates.size() - 1);
+        const float passCost = std::min(maxCost, 1.5f * candidateCost(m_Candidates[goal]));
+        size_t removed = 0, collapses = 0;
+        for (const SortItem& candidate : m_Candidates) {
+            const float cost = candidateCost(candidate);
+            if (cost > passCost || removed >= needed) {
+                break;
+            }
+            const uint32_t p = candidate.index, q = m_Target[p];
+            if (((m_Flags[p] | m_Flags[q]) & Touched) || flips(p, q)) {
+                continue;
+            }
+            findPartners(p, q, m_Partners);
+            for (size_t i = 0; i < m_Partners.size(); i += 2) {
+                m_Remap[m_Partners[i]] = m_Partners[i + 1];
+                m_AttributeArea[m_Partners[i + 1]] += m_AttributeArea[m_Partners[i]];
+            }
+            m_Quadrics[q].add(m_Quadrics[p]);
+            m_Merged[p] = q;
+            // the triangles around p change, nothing else touching them may collapse this pass
+            uint32_t wedge = p;
+            do {
+                for (uint32_t i = m_TriangleOffsets[wedge]; i < m_TriangleOffsets[wedge + 1]; ++i) {
+                    const uint32_t* t = &m_Indices[m_Triangles[i] * 3];
+                    bool collapsed = false;
+                    for (int k = 0; k < 3; ++k) {
+                        m_Flags[m_PositionId[t[k]]] |= Touched;
+                        collapsed = collapsed || m_PositionId[t[k]] == q;
+                    }
+                    removed += collapsed;
+                }
+                wedge = m_WedgeNext[wedge];
+            } while (wedge != p);
+            m_Cost = std::max(m_Cost, cost);
+            ++collapses;
+        }
+        if (!collapses) {
+            return 0;
+        }
+
+        // partners never collapse in the same pass, one lookup is enough
+        size_t write = 0;
+        for (size_t i = 0; i < m_Indices.size(); i += 3) {
+            const uint32_t a = m_Remap[m_Indices[i]], b = m_Remap[m_Indices[i + 1]], c = m_Remap[m_Indices[i + 2]];
+            const uint32_t pa = m_PositionId[a], pb = m_PositionId[b], pc = m_PositionId[c];
+            if (pa != pb && pb != pc && pa != pc) {
+                m_Indices[write++] = a;
+                m_Indices[write++] = b;
+                m_Indices[write++] = c;
+            }
+        }
+        m_Indices.resize(write);
+        return collapses;
+    }
+
+    unsigned int m_AttributeCount = 0;
+    float m_Extent = 1.0f;
+    float m_Cost = 0.0f;
+    std::vector<glm::vec3> m_Positions;       // scaled to the unit cube
+    std::vector<float> m_Attributes;          // premultiplied by the square root of their weights
+    std::vector<uint32_t> m_PositionId;       // first vertex at the same position
+    std::vector<uint32_t> m_WedgeNext;        // ring through the distinct vertices at one position
+    std::vector<uint32_t> m_Remap;
+    std::vector<uint32_t> m_Merged;           // per position id, the position it collapsed into
+    std::vector<uint32_t> m_InputPositions;   // the position ids the input triangles use
+    std::vector<uint32_t> m_Indices;
+    std::vector<Quadric> m_Quadrics;          // per position id
+    std::vector<float> m_AttributeArea;       // per vertex, the area its attributes cover
+    std::vector<uint8_t> m_Flags;             // per position id
+    std::vector<uint32_t> m_Target;           // per position id, its cheapest collapse
+    std::unordered_map<uint64_t, uint32_t> m_Edges;
+    std::vector<uint32_t> m_TriangleOffsets, m_Triangles;
+    std::vector<uint32_t> m_Neighbours, m_Partners;
+    std::vector<SortItem> m_Candidates, m_SortScratch;
+};
+
+namespace lod_detail {
+// Meshes below this are not worth a second level.
+const size_t MinIndices = 3 * 64;
+}
+
+// Appends up to levels - 1 simplified copies of indices to indices itself,
+// each with about ratio of the triangles of the one before, and returns the
+// ranges of all levels (level 0 is the input). The chain stops early when a
+// level could not get smaller without exceeding maxError (relative to the
+// mesh's size), so it can be shorter than asked for.
+inline std::vector<MeshLod> buildLodChain(const SimplifyMesh& mesh, std::vector<uint32_t>& indices, unsigned int levels,
+                                          float ratio = 0.5f, float maxError = 0.1f) {
+    std::vector<MeshLod> lods(1, MeshLod{ 0, (uint32_t) indices.size(), 0.0f });
+    if (levels < 2 || indices.size() < lod_detail::MinIndices) {
+        return lods;
+    }
+    MeshSimplifier simplifier(mesh, indices.data(), indices.size());
+    for (unsigned int level = 1; level < levels; ++level) {
+        const size_t target = (size_t) (lods.back().indexCount * ratio) / 3 * 3;
+        simplifier.simplify(target, maxError);
+        const std::vector<uint32_t>& simplified = simplifier.indices();
+        // a level that is barely smaller than the one before costs memory and selects almost nothing
+        if (simplified.empty() || simplified.size() > lods.back().indexCount * 0.85f) {
+            break;
+        }
+        // measured rather than taken from the collapse costs, so it bounds what shows on screen;
+        // never below the level before, selectLod relies on errors growing
+        const float error = std::max(lods.back().error, simplifier.deviation() * simplifier.extent());
+        lods.push_back(MeshLod{ (uint32_t) indices.size(), (uint32_t) simplified.size(), error });
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+    }
+    return lods;
+}
+
+// Picks levels by how many pixels their error covers on screen.
+struct LodView {
+    glm::vec3 eye = glm::vec3(0.0f);
+    // pixels a unit long object covers at distance 1: viewport height / (2 tan(fovy / 2))
+    float projectionScale = 0.0f;
+    // error, in pixels, a level must stay under; 0 keeps everything at level 0
+    float maxPixelError = 1.0f;
+
+    // pixels per unit at the nearest point of a bounding sphere, "infinite" inside it
+    float pixelsPerUnit(const glm::vec3& center, float radius) const {
+        const float distance = glm::length(center - eye) - radius;
+        return distance > 0.0f ? projectionScale / distance : FLT_MAX;
+    }
+};
+
+// coarsest level whose error stays under maxPixelError; errors grow with the level
+inline unsigned int selectLod(const std::vector<MeshLod>& lods, float pixelsPerUnit, float maxPixelError) {
+    unsigned int lod = 0;
+    while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit < maxPixelError) {
+        ++lod;
+    }
+    return lod;
+}
+
+// How much a transform can stretch a length, for errors and radii in its
+// source space. The longest column is the largest scale of R * S, the longest
+// row that of S * R (how scene instances are placed), so both are taken.
+inline float maxScale(const glm::mat4& transform) {
+    float longest = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec3 column(transform[i]);
+        const glm::vec3 row(transform[0][i], transform[1][i], transform[2][i]);
+        longest = std::max(longest, std::max(glm::dot(column, column), glm::dot(row, row)));
+    }
+    return std::sqrt(longest);
+}
+
+}
+
+#endif //PROJECT_BASE_MESHLOD_H
@@ -0,0 +1,71 @@
+#ifndef PROJECT_BASE_MIPCHAIN_H
+#define PROJECT_BASE_MIPCHAIN_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace rg {
+
+struct TextureLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Box-filtered mip chain down to 1x1, appended after levels[0]. sRGB images are
+// averaged in linear space. Shared by the texture streamer's decode workers and
+// the offline texture cooker, so neither needs glGenerateMipmap.
+inline void buildMipChain(std::vector<TextureLevel>& levels, int channels, bool srgb) {
+    static float toLinear[256];
+    static unsigned char toSrgb[4096];
+    static bool tablesReady = [] {
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < 4096; ++i) {
+            float l = i / 4095.0f;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = (unsigned char) std::lround(c * 255.0f);
+        }
+        return true;
+    }();
+    (void) tablesReady;
+
+    // alpha is never gamma encoded
+    const int colorChannels = channels == 4 ? 3 : channels;
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const TextureLevel& src = levels.back();
+        TextureLevel dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.pixels.resize((size_t) dst.width * dst.height * channels);
+        for (int y = 0; y < dst.height; ++y) {
+            const int y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+            for (int x = 0; x < dst.width; ++x) {
+                const int x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+                const unsigned char* p[4] = {
+                        &src.pixels[((size_t) y0 * src.width + x0) * channels],
+                        &src.pixels[((size_t) y0 * src.width + x1) * channels],
+                        &src.pixels[((size_t) y1 * src.width + x0) * channels],
+                        &src.pixels[((size_t) y1 * src.width + x1) * channels]
+                };
+                unsigned char* out = &dst.pixels[((size_t) y * dst.width + x) * channels];
+                for (int c = 0; c < channels; ++c) {
+                    if (srgb && c < colorChannels) {
+                        float l = (toLinear[p[0][c]] + toLinear[p[1][c]] + toLinear[p[2][c]] + toLinear[p[3][c]]) * 0.25f;
+                        out[c] = toSrgb[(int) (l * 4095.0f + 0.5f)];
+                    } else {
+                        out[c] = (unsigned char) ((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+                    }
+                }
+            }
+        }
+        levels.push_back(std::move(dst));
+    }
+}
+
+}
+
+#endif //PROJECT_BASE_MIPCHAIN_H
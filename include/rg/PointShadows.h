@@ -0,0 +1,324 @@
+#ifndef PROJECT_BASE_POINTSHADOWS_H
+#define PROJECT_BASE_POINTSHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/Frustum.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// One draw of a light's casters into some faces of its cube map. Layered
+// passes cover every face listed and need point_shadow.gs; single face
+// passes list one face and draw without it.
+struct PointShadowPass {
+    unsigned int light = 0;
+    glm::vec3 position = glm::vec3(0.0f);
+    float range = 0.0f;
+    bool layered = false;
+    int faces[6] = { 0, 0, 0, 0, 0, 0 };
+    int faceCount = 0;
+    glm::mat4 faceMatrices[6];
+    Frustum frustums[6];
+
+    // whether a caster's bounding sphere can reach one of the pass's faces
+    bool reaches(const glm::vec3& center, float radius) const {
+        if (glm::length(center - position) > range + radius) {
+            return false;
+        }
+        for (int i = 0; i < faceCount; ++i) {
+            if (frustums[faces[i]].intersects(center, radius)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // sets the pass on a point_shadow shader, which must be in use
+    void apply(Shader& shader) const {
+        shader.setVec3("lightPosition", position);
+        shader.setFloat("range", range);
+        shader.setInt("faceCount", faceCount);
+        for (int i = 0; i < 6; ++i) {
+            const std::string index = "[" + std::to_string(i) + "]";
+            shader.setMat4("faceMatrices" + index, faceMatrices[i]);
+            shader.setInt("faces" + index, faces[i]);
+        }
+    }
+};
+
+// Cube shadow maps of point lights, storing the distance to the light over
+// its range. Lights move and casters move, so every face goes stale, but only
+// a budget of faces is redrawn per frame: each face waits a number of frames
+// that grows its priority, scaled by the light's importance (brightness,
+// nearness to the camera) and by whether the face looks into the view. Many
+// shadowed lights then share a fixed cost instead of multiplying it, their
+// faces just refresh less often. A stale face keeps the shadow of where its
+// light was when it was drawn.
+class PointShadows {
+public:
+    struct Stats {
+        unsigned int faces = 0;    // redrawn this frame
+        unsigned int passes = 0;
+        unsigned int casters = 0;
+    };
+
+    // light i is sampled from unit FirstUnit + i, below the cascades' units
+    static const GLuint FirstUnit = 11;
+    static const unsigned int MaxLights = 2;
+
+    explicit PointShadows(unsigned int lights, unsigned int resolution = 512)
+        : m_Resolution(resolution), m_Lights(std::min(lights, (unsigned int) MaxLights)) {
+        // one pass for all of a light's faces needs layered framebuffers and geometry shaders
+        m_Layered = GLAD_GL_VERSION_3_2 != 0;
+        GLState& gl = GLState::instance();
+        for (Light& light : m_Lights) {
+            glGenTextures(1, &light.cube);
+            gl.bindTexture(0, GL_TEXTURE_CUBE_MAP, light.cube);
+            for (int face = 0; face < 6; ++face) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0,
+                             GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+            GLLABEL(GL_TEXTURE, light.cube, "point shadow");
+        }
+        gl.bindTexture(0, GL_TEXTURE_CUBE_MAP, 0);
+        glGenFramebuffers(1, &m_Framebuffer);
+        gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLLABEL(GL_FRAMEBUFFER, m_Framebuffer, "point shadows");
+    }
+
+    PointShadows(const PointShadows&) = delete;
+    PointShadows& operator=(const PointShadows&) = delete;
+
+    ~PointShadows() {
+        GLState& gl = GLState::instance();
+        gl.forgetFramebuffer(m_Framebuffer);
+        glDeleteFramebuffers(1, &m_Framebuffer);
+        for (Light& light : m_Lights) {
+            gl.forgetTexture(light.cube);
+            glDeleteTextures(1, &light.cube);
+        }
+    }
+
+    // faces redrawn per frame over all lights, 6 per light redraws everything every frame
+    void setBudget(unsigned int faces) {
+        m_Budget = faces;
+    }
+
+    void setLayered(bool layered) {
+        m_Layered = layered && GLAD_GL_VERSION_3_2;
+    }
+
+    bool layered() const {
+        return m_Layered;
+    }
+
+    // Where the light is this frame, how far its shadows reach and how
+    // bright it is; a range of 0 leaves it without shadows.
+    void setLight(unsigned int index, const glm::vec3& position, float range, float intensity) {
+        Light& light = m_Lights[index];
+        light.position = position;
+        light.range = range;
+        light.intensity = intensity;
+    }
+
+    // Redraws the budget's worth of the stalest, most important faces.
+    // drawCasters(pass) draws the casters pass.reaches() with a
+    // point_shadow shader (the layered one when pass.layered) after
+    // pass.apply(); the framebuffer and depth state are set.
+    template <typename DrawCasters>
+    void render(const Frustum& view, const glm::vec3& eye, DrawCasters drawCasters) {
+        m_Stats = Stats();
+        m_Picks.clear();
+        for (unsigned int l = 0; l < m_Lights.size(); ++l) {
+            Light& light = m_Lights[l];
+            for (int face = 0; face < 6; ++face) {
+                ++light.age[face];
+            }
+            if (light.range <= 0.0f) {
+                continue;
+            }
+            // brighter and closer lights matter more, up to fully at their own range
+            const float nearness = light.range / std::max(light.range, glm::length(light.position - eye));
+            const float importance = light.intensity * nearness;
+            for (int face = 0; face < 6; ++face) {
+                // the box the face sees, faces that look away from the view wait longer
+                const glm::vec3 axis = faceAxis(face);
+                glm::vec3 lateral(light.range);
+                lateral[face / 2] = 0.0f;
+                const glm::vec3 end = light.position + axis * light.range;
+                const bool visible = view.intersects(glm::min(light.position, end) - lateral,
+                                                     glm::max(light.position, end) + lateral);
+                // never drawn faces go first
+                const float age = light.drawn[face] ? (float) light.age[face] : 1e6f;
+                m_Picks.push_back({ age * importance * (visible ? 1.0f : 0.1f), l, face });
+            }
+        }
+        const size_t picked = std::min((size_t) m_Budget, m_Picks.size());
+        if (picked == 0) {
+            return;
+        }
+        std::partial_sort(m_Picks.begin(), m_Picks.begin() + picked, m_Picks.end(),
+                          [](const Pick& a, const Pick& b) { return a.priority > b.priority; });
+
+        GLState& gl = GLState::instance();
+        const GLState::Snapshot saved = gl.save();
+        GLGROUP("Point shadows");
+        gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        gl.viewport(0, 0, m_Resolution, m_Resolution);
+        gl.enable(GL_DEPTH_TEST);
+        gl.depthFunc(GL_LESS);
+        gl.depthMask(true);
+        gl.disable(GL_BLEND);
+        for (unsigned int l = 0; l < m_Lights.size(); ++l) {
+            Light& light = m_Lights[l];
+            PointShadowPass pass;
+            pass.light = l;
+            pass.position = light.position;
+            pass.range = light.range;
+            pass.layered = m_Layered;
+            for (size_t p = 0; p < picked; ++p) {
+                if (m_Picks[p].light == l) {
+                    pass.faces[pass.faceCount++] = m_Picks[p].face;
+                }
+            }
+            if (!pass.faceCount) {
+                continue;
+            }
+            const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, light.range);
+            for (int face = 0; face < 6; ++face) {
+                pass.faceMatrices[face] = projection * glm::lookAt(light.position, light.position + faceAxis(face),
+                                                                   faceUp(face));
+                pass.frustums[face] = Frustum(pass.faceMatrices[face]);
+            }
+            // a layered attachment clears all six faces, the picked ones are cleared one by one
+            for (int i = 0; i < pass.faceCount; ++i) {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + pass.faces[i],
+                                       light.cube, 0);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                light.age[pass.faces[i]] = 0;
+                light.drawn[pass.faces[i]] = true;
+            }
+            m_Stats.faces += pass.faceCount;
+            if (m_Layered) {
+                glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, light.cube, 0);
+                m_Stats.casters += drawCasters(pass);
+                ++m_Stats.passes;
+            } else {
+                // the last face cleared is still attached
+                PointShadowPass single = pass;
+                single.faceCount = 1;
+                for (int i = pass.faceCount - 1; i >= 0; --i) {
+                    single.faces[0] = pass.faces[i];
+                    if (i != pass.faceCount - 1) {
+                        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                               GL_TEXTURE_CUBE_MAP_POSITIVE_X + single.faces[0], light.cube, 0);
+                    }
+                    m_Stats.casters += drawCasters(single);
+                    ++m_Stats.passes;
+                }
+            }
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, 0);
+        gl.restore(saved);
+    }
+
+    // Binds the cube maps and sets the ranges on a shader that receives
+    // point shadows (bloom.fs), which must be in use. A light without a
+    // shadow, or every light when not enabled, gets range 0.
+    void bind(Shader& shader, bool enabled = true) const {
+        GLState& gl = GLState::instance();
+        for (unsigned int l = 0; l < MaxLights; ++l) {
+            const std::string name = "pointShadowRange" + std::to_string(l + 1);
+            if (enabled && l < m_Lights.size() && m_Lights[l].range > 0.0f) {
+                gl.bindTexture(FirstUnit + l, GL_TEXTURE_CUBE_MAP, m_Lights[l].cube);
+                shader.setFloat(name, m_Lights[l].range);
+            } else {
+                shader.setFloat(name, 0.0f);
+            }
+        }
+    }
+
+    // the cube samplers get units of their own even while shadows are off
+    static void setSamplers(Shader& shader) {
+        for (unsigned int l = 0; l < MaxLights; ++l) {
+            shader.setInt("pointShadow" + std::to_string(l + 1), (int) (FirstUnit + l));
+        }
+    }
+
+    // distance at which the light's attenuation falls to 1/32, where its shadow stops mattering
+    static float range(float constant, float linear, float quadratic) {
+        const float target = 32.0f - constant;
+        if (target <= 0.0f) {
+            return 0.0f;
+        }
+        if (quadratic <= 0.0f) {
+            return linear > 0.0f ? std::min(target / linear, 50.0f) : 50.0f;
+        }
+        return std::min((-linear + std::sqrt(linear * linear + 4.0f * quadratic * target)) / (2.0f * quadratic), 50.0f);
+    }
+
+    const Stats& stats() const {
+        return m_Stats;
+    }
+
+private:
+    struct Light {
+        GLuint cube = 0;
+        glm::vec3 position = glm::vec3(0.0f);
+        float range = 0.0f;
+        float intensity = 1.0f;
+        unsigned int age[6] = { 0, 0, 0, 0, 0, 0 };   // frames since the face was drawn
+        bool drawn[6] = { false, false, false, false, false, false };
+    };
+
+    struct Pick {
+        float priority;
+        unsigned int light;
+        int face;
+    };
+
+    // cube map face order, +x -x +y -y +z -z
+    static glm::vec3 faceAxis(int face) {
+        glm::vec3 axis(0.0f);
+        axis[face / 2] = (face & 1) ? -1.0f : 1.0f;
+        return axis;
+    }
+
+    // the up vectors that match the cube map's face orientation
+    static glm::vec3 faceUp(int face) {
+        return face == 2 ? glm::vec3(0.0f, 0.0f, 1.0f) : face == 3 ? glm::vec3(0.0f, 0.0f, -1.0f)
+                                                                   : glm::vec3(0.0f, -1.0f, 0.0f);
+    }
+
+    unsigned int m_Resolution;
+    unsigned int m_Budget = 6;
+    bool m_Layered = false;
+    std::vector<Light> m_Lights;
+    GLuint m_Framebuffer = 0;
+    std::vector<Pick> m_Picks;
+    Stats m_Stats;
+};
+
+}
+
+#endif //PROJECT_BASE_POINTSHADOWS_H
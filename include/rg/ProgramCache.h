@@ -0,0 +1,154 @@
+#ifndef PROJECT_BASE_PROGRAMCACHE_H
+#define PROJECT_BASE_PROGRAMCACHE_H
+
+#include <glad/glad.h>
+#include <common.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+namespace rg {
+
+// Disk cache of linked program binaries (GL_ARB_get_program_binary).
+// Entries are keyed on the shader sources, the injected defines and the driver
+// identification strings, so a driver update or an edited shader simply misses
+// and falls back to compiling from source.
+class ProgramCache {
+public:
+    static ProgramCache& instance() {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    void setDirectory(const std::string& dir) {
+        m_Directory = dir;
+    }
+
+    void setEnabled(bool enabled) {
+        m_Enabled = enabled;
+    }
+
+    // binary formats can only be queried once a context is current
+    bool available() {
+        if (!m_Enabled || !GLAD_GL_ARB_get_program_binary) {
+            return false;
+        }
+        if (m_NumFormats < 0) {
+            m_NumFormats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &m_NumFormats);
+        }
+        return m_NumFormats > 0;
+    }
+
+    uint64_t key(const std::string& vertexCode, const std::string& fragmentCode,
+                 const std::string& geometryCode, const std::string& defines) {
+        uint64_t hash = hashString(driverString());
+        hash = hashString(vertexCode, hash);
+        hash = hashString(fragmentCode, hash);
+        hash = hashString(geometryCode, hash);
+        hash = hashString(defines, hash);
+        return hash;
+    }
+
+    // Tries to fill an empty program object from the cache. Returns false on
+    // any mismatch, in which case the caller compiles from source.
+    bool load(uint64_t key, unsigned int program) {
+        if (!available()) {
+            ++misses;
+            return false;
+        }
+        FILE* file = std::fopen(entryPath(key).c_str(), "rb");
+        if (!file) {
+            ++misses;
+            return false;
+        }
+        Header header = {};
+        std::vector<char> binary;
+        bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+                  && std::memcmp(header.magic, "RGPB", 4) == 0
+                  && header.key == key
+                  && header.length > 0;
+        if (ok) {
+            binary.resize(header.length);
+            ok = std::fread(binary.data(), 1, binary.size(), file) == binary.size();
+        }
+        std::fclose(file);
+
+        if (ok) {
+            glProgramBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+            GLint linked = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+            ok = linked == GL_TRUE;
+        }
+        ok ? ++hits : ++misses;
+        return ok;
+    }
+
+    // must be called on a program linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    void store(uint64_t key, unsigned int program) {
+        if (!available()) {
+            return;
+        }
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+        Header header = {};
+        std::memcpy(header.magic, "RGPB", 4);
+        header.key = key;
+        header.length = (uint32_t) length;
+        std::vector<char> binary(length);
+        glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+
+        mkdir(m_Directory.c_str(), 0755);
+        FILE* file = std::fopen(entryPath(key).c_str(), "wb");
+        if (!file) {
+            return;
+        }
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fwrite(binary.data(), 1, binary.size(), file);
+        std::fclose(file);
+    }
+
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+
+private:
+    struct Header {
+        char magic[4];
+        GLenum format;
+        uint64_t key;
+        uint32_t length;
+    };
+
+    ProgramCache() = default;
+
+    std::string driverString() {
+        if (m_Driver.empty()) {
+            const char* vendor = (const char*) glGetString(GL_VENDOR);
+            const char* renderer = (const char*) glGetString(GL_RENDERER);
+            const char* version = (const char*) glGetString(GL_VERSION);
+            m_Driver = std::string(vendor ? vendor : "") + '|' + (renderer ? renderer : "") + '|' + (version ? version : "");
+        }
+        return m_Driver;
+    }
+
+    std::string entryPath(uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+        return m_Directory + '/' + name;
+    }
+
+    std::string m_Directory = "resources/shader_cache";
+    std::string m_Driver;
+    GLint m_NumFormats = -1;
+    bool m_Enabled = true;
+};
+
+}
+
+#endif //PROJECT_BASE_PROGRAMCACHE_H
@@ -0,0 +1,79 @@
+#ifndef PROJECT_BASE_RADIXSORT_H
+#define PROJECT_BASE_RADIXSORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+// a 64-bit sort key and the index of what it sorts
+struct SortItem {
+    uint64_t key;
+    uint32_t index;
+};
+
+// Stable LSD radix sort on the whole key, one byte per pass. All eight
+// histograms come from a single read of the keys, and a pass where every key
+// has the same byte (the unused high bits of a sparse key, a frame where every
+// draw is in one pass) is skipped without touching the items.
+inline void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch) {
+    const size_t count = items.size();
+    if (count < 2) {
+        return;
+    }
+    scratch.resize(count);
+    size_t histograms[8][256] = {};
+    for (const SortItem& item : items) {
+        for (int b = 0; b < 8; ++b) {
+            ++histograms[b][(item.key >> (b * 8)) & 0xff];
+        }
+    }
+
+    SortItem* src = items.data();
+    SortItem* dst = scratch.data();
+    for (int b = 0; b < 8; ++b) {
+        size_t* histogram = histograms[b];
+        const int shift = b * 8;
+        if (histogram[(src[0].key >> shift) & 0xff] == count) {
+            continue;
+        }
+        size_t offset = 0;
+        for (int v = 0; v < 256; ++v) {
+            size_t n = histogram[v];
+            histogram[v] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != items.data()) {
+        std::copy(src, src + count, items.data());
+    }
+}
+
+// Hands out small dense ids for object names (programs, VAOs) so they fit the
+// few key bits reserved for them. Ids are stable for the object's lifetime;
+// there are only ever a handful of names, so a linear search is the fastest map.
+class DenseIds {
+public:
+    uint32_t get(uint32_t name) {
+        for (size_t i = 0; i < m_Names.size(); ++i) {
+            if (m_Names[i] == name) {
+                return (uint32_t) i;
+            }
+        }
+        m_Names.push_back(name);
+        return (uint32_t) m_Names.size() - 1;
+    }
+
+private:
+    std::vector<uint32_t> m_Names;
+};
+
+}
+
+#endif //PROJECT_BASE_RADIXSORT_H
@@ -0,0 +1,158 @@
+#ifndef PROJECT_BASE_RENDERQUEUE_H
+#define PROJECT_BASE_RENDERQUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/GLState.h>
+#include <rg/RadixSort.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+// Passes run in this order, each with its own fixed-function state.
+enum RenderPass : uint32_t {
+    PassOpaque = 0,
+    PassAlphaTested = 1,   // cut-out geometry that discards in the shader, drawn two-sided
+    PassSky = 2,           // after all opaque geometry, GL_LEQUAL so it only fills what is left
+    PassTransparent = 3,   // blended, back to front
+    PassCount
+};
+
+// Collects the single draws of a frame (billboards, light markers, the
+// skybox), encodes each into a 64-bit key and radix sorts them, so the frame
+// is drawn pass by pass with every program and texture bound once per run
+// instead of in the order the loop happened to submit them. Binds go through
+// GLState, which drops the ones that would not change anything.
+//
+// key, most significant first:
+//   opaque passes       pass:4 | program:12 | material:24 | depth:24   (front to back)
+//   PassTransparent     pass:4 | depth:24 (inverted) | program:12 | material:24
+class RenderQueue {
+public:
+    struct Item {
+        Shader* shader = nullptr;
+        GLuint vao = 0;
+        GLenum mode = GL_TRIANGLES;
+        GLint first = 0;
+        GLsizei count = 0;
+        // the material: one texture on unit 0, none when texture is 0
+        GLenum textureTarget = GL_TEXTURE_2D;
+        GLuint texture = 0;
+        glm::mat4 model = glm::mat4(1.0f);
+        // optional per-draw vec3 uniform, e.g. a light marker's color
+        const char* colorUniform = nullptr;
+        glm::vec3 color = glm::vec3(0.0f);
+    };
+
+    struct Stats {
+        unsigned int items = 0;
+        unsigned int programRuns = 0;   // distinct program runs after sorting
+        unsigned int materialRuns = 0;
+    };
+
+    // depth is the distance from the eye, quantized over [0, farPlane]
+    void setView(const glm::vec3& eye, float farPlane) {
+        m_Eye = eye;
+        m_FarPlane = farPlane;
+    }
+
+    // PassAlphaTested resolves its edges through the samples of a multisampled target
+    void setAlphaToCoverage(bool enabled) {
+        m_AlphaToCoverage = enabled;
+    }
+
+    void submit(RenderPass pass, const Item& item, const glm::vec3& position) {
+        const uint64_t program = m_Programs.get(item.shader->ID) & 0xfff;
+        const uint64_t material = item.texture & 0xffffff;
+        const float distance = glm::length(position - m_Eye) / m_FarPlane;
+        uint64_t depth = (uint64_t) (std::min(std::max(distance, 0.0f), 1.0f) * 0xffffff);
+        uint64_t key = (uint64_t) pass << 60;
+        if (pass == PassTransparent) {
+            key |= (0xffffff - depth) << 36 | program << 24 | material;
+        } else {
+            key |= program << 48 | material << 24 | depth;
+        }
+        m_Keys.push_back({ key, (uint32_t) m_Items.size() });
+        m_Items.push_back(item);
+    }
+
+    // sorts and draws everything submitted since the last flush
+    void flush() {
+        m_Stats = Stats();
+        m_Stats.items = (unsigned int) m_Items.size();
+        GLGROUP("Render queue");
+        radixSort(m_Keys, m_Scratch);
+
+        GLState& gl = GLState::instance();
+        uint32_t pass = PassCount;
+        GLuint program = 0, texture = 0;
+        for (const SortItem& sorted : m_Keys) {
+            const Item& item = m_Items[sorted.index];
+            const uint32_t itemPass = (uint32_t) (sorted.key >> 60);
+            if (itemPass != pass) {
+                setPassState(itemPass);
+                pass = itemPass;
+            }
+            if (item.shader->ID != program) {
+                program = item.shader->ID;
+                ++m_Stats.programRuns;
+                texture = 0;
+            }
+            if (item.texture != texture) {
+                texture = item.texture;
+                ++m_Stats.materialRuns;
+            }
+            gl.useProgram(item.shader->ID);
+            gl.bindVertexArray(item.vao);
+            if (item.texture) {
+                gl.bindTexture(0, item.textureTarget, item.texture);
+            }
+            item.shader->setMat4("model", item.model);
+            if (item.colorUniform) {
+                item.shader->setVec3(item.colorUniform, item.color);
+            }
+            glDrawArrays(item.mode, item.first, item.count);
+        }
+        if (pass != PassCount) {
+            setPassState(PassOpaque);
+        }
+        m_Items.clear();
+        m_Keys.clear();
+    }
+
+    const Stats& stats() const {
+        return m_Stats;
+    }
+
+private:
+    // PassOpaque is also the state the rest of the frame expects
+    void setPassState(uint32_t pass) const {
+        GLState& gl = GLState::instance();
+        gl.setEnabled(GL_CULL_FACE, pass != PassAlphaTested && pass != PassTransparent);
+        gl.setEnabled(GL_SAMPLE_ALPHA_TO_COVERAGE, pass == PassAlphaTested && m_AlphaToCoverage);
+        gl.depthFunc(pass == PassSky ? GL_LEQUAL : GL_LESS);
+        gl.setEnabled(GL_BLEND, pass == PassTransparent);
+        gl.depthMask(pass != PassTransparent);
+        if (pass == PassTransparent) {
+            gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+    }
+
+    glm::vec3 m_Eye = glm::vec3(0.0f);
+    float m_FarPlane = 100.0f;
+    bool m_AlphaToCoverage = false;
+    DenseIds m_Programs;
+    std::vector<Item> m_Items;
+    std::vector<SortItem> m_Keys;
+    std::vector<SortItem> m_Scratch;
+    Stats m_Stats;
+};
+
+}
+
+#endif //PROJECT_BASE_RENDERQUEUE_H
@@ -0,0 +1,840 @@
+#ifndef PROJECT_BASE_SCENE_H
+#define PROJECT_BASE_SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <common.h>
+#include <rg/MappedFile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace rg {
+
+// Scene description: which models to load, where their instances and the
+// alpha-tested billboards go, the lights and the skybox. Everything ends up in
+// flat arrays of plain structs so the frame loop just walks them.
+//
+// The text format is JSON, read by a pull parser without building a document
+// tree. "models" and "materials" must come before the "instances" and
+// "billboards" that name them:
+//
+//   { "models":     [ { "name": "heli", "path": "resources/objects/heli/ah64d.obj", "texturePrefix": "material.",
+//                       "nodeSpins": [ { "node": "rotor", "axis": [0, 1, 0], "speed": 20 } ],
+//                       "impostor": { "distance": 30, "columns": 8, "rows": 4 } } ],
+//     "materials":  [ { "name": "grass", "diffuse": "resources/textures/grass.png" } ],
+//     "instances":  [ { "model": "heli", "position": [0, 16, 0], "scale": 0.4, "rotation": 90, "spin": 1,
+//                       "orbit": { "radius": [4, 4], "speed": 1, "phase": 0 } } ],
+//     "billboards": [ { "material": "grass", "position": [8.44, 7, 5.53] } ],
+//     "pointLights": [ { "position": [0, 11, 0], "orbit": { ... }, "ambient": [...], "diffuse": [...], "specular": [...],
+//                        "constant": 1, "linear": 0.09, "quadratic": 0.032,
+//                        "marker": { "offset": [0, 6, 0], "scale": 0.14, "color": [30, 30, 30] } } ],
+//     "dirLight":   { "direction": [...], "ambient": [...], "diffuse": [...], "specular": [...] },
+//     "spotLight":  { "ambient": [...], "diffuse": [...], "specular": [...], "constant": 1, "linear": 0.09,
+//                     "quadratic": 0.032, "cutOff": 12.5, "outerCutOff": 15 },
+//     "skybox":     { "faces": [ "+x", "-x", "+y", "-y", "+z", "-z" ], "flipVertically": true },
+//     "grass":      { "model": "island", "density": "resources/textures/grass_density.png", "blades": 100000,
+//                     "chunkSize": 4, "distance": 40, "height": [0.15, 0.35], "width": 0.03, "minUp": 0.8 } }
+//
+// Angles are in degrees, spin and orbit speed in radians per second. A node
+// spin turns one node of the model's hierarchy about the center of its own
+// geometry, on every instance of the model. An impostor makes the instances
+// further than distance from the eye one quad each, showing the model baked
+// from columns x rows directions (rg::ImpostorRenderer). An orbit
+// moves the position around itself: position + (r.x cos(speed t + phase), 0,
+// r.y sin(speed t + phase)).
+//
+// Grass grows on the first instance of its model, on the triangles facing up
+// by at least minUp (the normal's y), where the density map is bright.
+//
+// Parsed scenes are cached next to the file as <file>.rgscene, a binary dump of
+// the same arrays that is read back in one go while the size and hash of the
+// JSON it was made from match the file's.
+
+struct SceneOrbit {
+    glm::vec2 radius = glm::vec2(0.0f);
+    float speed = 0.0f;
+    float phase = 0.0f;
+};
+
+enum SceneFlags : uint32_t {
+    SceneOrbiting = 1
+};
+
+struct SceneModel {
+    std::string name;
+    std::string path;
+    std::string texturePrefix;
+    // instances further than impostorDistance are drawn as baked impostors, 0 never
+    float impostorDistance = 0.0f;
+    uint32_t impostorColumns = 8;
+    uint32_t impostorRows = 4;
+};
+
+struct SceneNodeSpin {
+    uint32_t model = 0;
+    std::string node;
+    glm::vec3 axis = glm::vec3(0.0f, 1.0f, 0.0f);
+    float speed = 0.0f;
+};
+
+struct SceneMaterial {
+    std::string name;
+    std::string diffuse;
+};
+
+// a model instance, or for billboards a quad using materials[index]
+struct SceneInstance {
+    uint32_t index = 0;
+    uint32_t flags = 0;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+    float rotation = 0.0f; // radians about +Y
+    float spin = 0.0f;     // radians per second about +Y
+    SceneOrbit orbit;
+};
+
+struct ScenePointLight {
+    uint32_t flags = 0;
+    glm::vec3 position = glm::vec3(0.0f);
+    SceneOrbit orbit;
+    glm::vec3 ambient = glm::vec3(0.05f);
+    glm::vec3 diffuse = glm::vec3(0.8f);
+    glm::vec3 specular = glm::vec3(1.0f);
+    float constant = 1.0f;
+    float linear = 0.09f;
+    float quadratic = 0.032f;
+    // the emissive cube drawn for the light
+    glm::vec3 markerOffset = glm::vec3(0.0f);
+    float markerScale = 0.14f;
+    glm::vec3 markerColor = glm::vec3(30.0f);
+};
+
+struct SceneDirLight {
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 ambient = glm::vec3(0.0f);
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    glm::vec3 specular = glm::vec3(0.0f);
+};
+
+// follows the camera, only the light itself is described here
+struct SceneSpotLight {
+    glm::vec3 ambient = glm::vec3(0.0f);
+    glm::vec3 diffuse = glm::vec3(1.0f);
+    glm::vec3 specular = glm::vec3(1.0f);
+    float constant = 1.0f;
+    float linear = 0.09f;
+    float quadratic = 0.032f;
+    float cutOff = 0.976296f;      // cosine of the inner angle
+    float outerCutOff = 0.965926f; // cosine of the outer angle
+};
+
+// procedural grass over the first instance of a model, see rg::GrassField
+struct SceneGrass {
+    int32_t model = -1;            // none when negative
+    std::string density;           // grayscale image over the surface's XZ bounds, empty for even
+    uint32_t blades = 100000;
+    float chunkSize = 4.0f;
+    float distance = 40.0f;        // draw distance, blades thin out over its second half
+    glm::vec2 height = glm::vec2(0.15f, 0.35f);
+    float width = 0.03f;
+    float minUp = 0.8f;
+};
+
+struct Scene {
+    std::vector<SceneModel> models;
+    std::vector<SceneNodeSpin> nodeSpins;
+    std::vector<SceneMaterial> materials;
+    std::vector<SceneInstance> instances;
+    std::vector<SceneInstance> billboards;
+    std::vector<ScenePointLight> pointLights;
+    SceneDirLight dirLight;
+    SceneSpotLight spotLight;
+    std::vector<std::string> skyboxFaces;
+    bool skyboxFlipVertically = false;
+    SceneGrass grass;
+};
+
+inline glm::vec3 orbitPosition(const glm::vec3& position, uint32_t flags, const SceneOrbit& orbit, float time) {
+    if (!(flags & SceneOrbiting)) {
+        return position;
+    }
+    const float angle = orbit.speed * time + orbit.phase;
+    return position + glm::vec3(orbit.radius.x * std::cos(angle), 0.0f, orbit.radius.y * std::sin(angle));
+}
+
+inline glm::vec3 instancePosition(const SceneInstance& instance, float time) {
+    return orbitPosition(instance.position, instance.flags, instance.orbit, time);
+}
+
+inline glm::vec3 lightPosition(const ScenePointLight& light, float time) {
+    return orbitPosition(light.position, light.flags, light.orbit, time);
+}
+
+inline glm::quat instanceRotation(const SceneInstance& instance, float time) {
+    return glm::angleAxis(instance.rotation + instance.spin * time, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Pull parser over a JSON text. Values are read in the order the caller asks
+// for them; the first error sticks and every later call returns a default.
+class JsonReader {
+public:
+    JsonReader(const char* begin, const char* end)
+            : m_Begin(begin), m_Pos(begin), m_End(end) {}
+
+    bool beginObject() {
+        return expect('{');
+    }
+
+    // next key of the current object, false once its '}' is consumed
+    bool nextKey(std::string& key) {
+        if (!separator('}')) {
+            return false;
+        }
+        key = string();
+        return expect(':');
+    }
+
+    bool beginArray() {
+        return expect('[');
+    }
+
+    // true while the current array has another element
+    bool nextElement() {
+        return separator(']');
+    }
+
+    bool peek(char c) {
+        skipSpace();
+        return m_Pos < m_End && *m_Pos == c;
+    }
+
+    double number() {
+        skipSpace();
+        const char* start = m_Pos;
+        bool negative = m_Pos < m_End && *m_Pos == '-';
+        if (negative) {
+            ++m_Pos;
+        }
+        double value = 0.0;
+        while (m_Pos < m_End && *m_Pos >= '0' && *m_Pos <= '9') {
+            value = value * 10.0 + (*m_Pos++ - '0');
+        }
+        if (m_Pos < m_End && *m_Pos == '.') {
+            double scale = 0.1;
+            for (++m_Pos; m_Pos < m_End && *m_Pos >= '0' && *m_Pos <= '9'; ++m_Pos, scale *= 0.1) {
+                value += (*m_Pos - '0') * scale;
+            }
+        }
+        if (m_Pos < m_End && (*m_Pos == 'e' || *m_Pos == 'E')) {
+            ++m_Pos;
+            bool negativeExponent = m_Pos < m_End && *m_Pos == '-';
+            if (m_Pos < m_End && (*m_Pos == '-' || *m_Pos == '+')) {
+                ++m_Pos;
+            }
+            int exponent = 0;
+            while (m_Pos < m_End && *m_Pos >= '0' && *m_Pos <= '9') {
+                exponent = exponent * 10 + (*m_Pos++ - '0');
+            }
+            value *= std::pow(10.0, negativeExponent ? -exponent : exponent);
+        }
+        if (m_Pos == start || (negative && m_Pos == start + 1)) {
+            fail("number expected");
+            return 0.0;
+        }
+        return negative ? -value : value;
+    }
+
+    std::string string() {
+        std::string value;
+        if (!expect('"')) {
+            return value;
+        }
+        while (m_Pos < m_End && *m_Pos != '"') {
+            char c = *m_Pos++;
+            if (c == '\\' && m_Pos < m_End) {
+                c = *m_Pos++;
+                switch (c) {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'r': c = '\r'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'u': fail("\\u escapes are not supported"); return value;
+                    default: break; // \" \\ and \/ stand for themselves
+                }
+            }
+            value += c;
+        }
+        expect('"');
+        return value;
+    }
+
+    bool boolean() {
+        skipSpace();
+        if (literal("true")) {
+            return true;
+        }
+        if (!literal("false")) {
+            fail("true or false expected");
+        }
+        return false;
+    }
+
+    glm::vec2 vec2() {
+        glm::vec2 v(0.0f);
+        readFloats(&v.x, 2);
+        return v;
+    }
+
+    glm::vec3 vec3() {
+        glm::vec3 v(0.0f);
+        readFloats(&v.x, 3);
+        return v;
+    }
+
+    // skips a value of any type, used for keys we do not know
+    void skip() {
+        skipSpace();
+        if (m_Pos >= m_End) {
+            fail("value expected");
+        } else if (*m_Pos == '{') {
+            beginObject();
+            std::string key;
+            while (!failed() && nextKey(key)) {
+                skip();
+            }
+        } else if (*m_Pos == '[') {
+            beginArray();
+            while (!failed() && nextElement()) {
+                skip();
+            }
+        } else if (*m_Pos == '"') {
+            string();
+        } else if (*m_Pos == 't' || *m_Pos == 'f') {
+            boolean();
+        } else if (!literal("null")) {
+            number();
+        }
+    }
+
+    void fail(const std::string& message) {
+        if (m_Error.empty()) {
+            int line = 1 + (int) std::count(m_Begin, std::min(m_Pos, m_End), '\n');
+            m_Error = "line " + std::to_string(line) + ": " + message;
+        }
+        m_Pos = m_End;
+    }
+
+    bool failed() const {
+        return !m_Error.empty();
+    }
+
+    const std::string& error() const {
+        return m_Error;
+    }
+
+private:
+    void skipSpace() {
+        while (m_Pos < m_End && (*m_Pos == ' ' || *m_Pos == '\n' || *m_Pos == '\r' || *m_Pos == '\t')) {
+            ++m_Pos;
+        }
+    }
+
+    bool expect(char c) {
+        skipSpace();
+        if (m_Pos < m_End && *m_Pos == c) {
+            ++m_Pos;
+            return true;
+        }
+        fail(std::string("'") + c + "' expected");
+        return false;
+    }
+
+    // consumes the closing bracket (returning false) or the comma before the next item
+    bool separator(char close) {
+        skipSpace();
+        if (m_Pos >= m_End) {
+            fail(std::string("'") + close + "' expected");
+            return false;
+        }
+        if (*m_Pos == close) {
+            ++m_Pos;
+            return false;
+        }
+        if (*m_Pos == ',') {
+            ++m_Pos;
+        }
+        return true;
+    }
+
+    bool literal(const char* word) {
+        size_t length = std::strlen(word);
+        if ((size_t) (m_End - m_Pos) >= length && std::memcmp(m_Pos, word, length) == 0) {
+            m_Pos += length;
+            return true;
+        }
+        return false;
+    }
+
+    void readFloats(float* values, int count) {
+        beginArray();
+        int i = 0;
+        while (!failed() && nextElement()) {
+            float value = (float) number();
+            if (i < count) {
+                values[i] = value;
+            }
+            ++i;
+        }
+        if (!failed() && i != count) {
+            fail("array of " + std::to_string(count) + " numbers expected");
+        }
+    }
+
+    const char* m_Begin;
+    const char* m_Pos;
+    const char* m_End;
+    std::string m_Error;
+};
+
+namespace scene {
+
+inline int findByName(const std::string& name, const std::vector<SceneModel>& models) {
+    for (size_t i = 0; i < models.size(); ++i) {
+        if (models[i].name == name) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+inline int findByName(const std::string& name, const std::vector<SceneMaterial>& materials) {
+    for (size_t i = 0; i < materials.size(); ++i) {
+        if (materials[i].name == name) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+inline void readOrbit(JsonReader& json, SceneOrbit& orbit) {
+    json.beginObject();
+    std::string key;
+    while (json.nextKey(key)) {
+        if (key == "radius") orbit.radius = json.vec2();
+        else if (key == "speed") orbit.speed = (float) json.number();
+        else if (key == "phase") orbit.phase = (float) json.number();
+        else json.skip();
+    }
+}
+
+// instances and billboards, reference is the key naming the model or material
+template <typename Named>
+inline void readInstances(JsonReader& json, const char* reference, const std::vector<Named>& targets,
+                          std::vector<SceneInstance>& out) {
+    json.beginArray();
+    while (json.nextElement()) {
+        SceneInstance instance;
+        json.beginObject();
+        std::string key;
+        while (json.nextKey(key)) {
+            if (key == reference) {
+                std::string name = json.string();
+                int index = findByName(name, targets);
+                if (index < 0) {
+                    json.fail("unknown " + std::string(reference) + " \"" + name + "\", declare it first");
+                }
+                instance.index = (uint32_t) index;
+            } else if (key == "position") {
+                instance.position = json.vec3();
+            } else if (key == "scale") {
+                instance.scale = json.peek('[') ? json.vec3() : glm::vec3((float) json.number());
+            } else if (key == "rotation") {
+                instance.rotation = glm::radians((float) json.number());
+            } else if (key == "spin") {
+                instance.spin = (float) json.number();
+            } else if (key == "orbit") {
+                readOrbit(json, instance.orbit);
+                instance.flags |= SceneOrbiting;
+            } else {
+                json.skip();
+            }
+        }
+        out.push_back(instance);
+    }
+}
+
+inline void readNodeSpins(JsonReader& json, uint32_t model, std::vector<SceneNodeSpin>& out) {
+    json.beginArray();
+    while (json.nextElement()) {
+        SceneNodeSpin spin;
+        spin.model = model;
+        json.beginObject();
+        std::string key;
+        while (json.nextKey(key)) {
+            if (key == "node") spin.node = json.string();
+            else if (key == "axis") spin.axis = json.vec3();
+            else if (key == "speed") spin.speed = (float) json.number();
+            else json.skip();
+        }
+        out.push_back(spin);
+    }
+}
+
+inline void readPointLights(JsonReader& json, std::vector<ScenePointLight>& out) {
+    json.beginArray();
+    while (json.nextElement()) {
+        ScenePointLight light;
+        json.beginObject();
+        std::string key;
+        while (json.nextKey(key)) {
+            if (key == "position") light.position = json.vec3();
+            else if (key == "orbit") { readOrbit(json, light.orbit); light.flags |= SceneOrbiting; }
+            else if (key == "ambient") light.ambient = json.vec3();
+            else if (key == "diffuse") light.diffuse = json.vec3();
+            else if (key == "specular") light.specular = json.vec3();
+            else if (key == "constant") light.constant = (float) json.number();
+            else if (key == "linear") light.linear = (float) json.number();
+            else if (key == "quadratic") light.quadratic = (float) json.number();
+            else if (key == "marker") {
+                json.beginObject();
+                std::string markerKey;
+                while (json.nextKey(markerKey)) {
+                    if (markerKey == "offset") light.markerOffset = json.vec3();
+                    else if (markerKey == "scale") light.markerScale = (float) json.number();
+                    else if (markerKey == "color") light.markerColor = json.vec3();
+                    else json.skip();
+                }
+            }
+            else json.skip();
+        }
+        out.push_back(light);
+    }
+}
+
+inline bool parse(JsonReader& json, Scene& scene) {
+    json.beginObject();
+    std::string key;
+    while (json.nextKey(key)) {
+        if (key == "models") {
+            json.beginArray();
+            while (json.nextElement()) {
+                SceneModel model;
+                json.beginObject();
+                std::string field;
+                while (json.nextKey(field)) {
+                    if (field == "name") model.name = json.string();
+                    else if (field == "path") model.path = json.string();
+                    else if (field == "texturePrefix") model.texturePrefix = json.string();
+                    else if (field == "nodeSpins") readNodeSpins(json, (uint32_t) scene.models.size(), scene.nodeSpins);
+                    else if (field == "impostor") {
+                        json.beginObject();
+                        std::string impostorKey;
+                        while (json.nextKey(impostorKey)) {
+                            if (impostorKey == "distance") model.impostorDistance = (float) json.number();
+                            else if (impostorKey == "columns") model.impostorColumns = (uint32_t) std::max(1.0, json.number());
+                            else if (impostorKey == "rows") model.impostorRows = (uint32_t) std::max(1.0, json.number());
+                            else json.skip();
+                        }
+                    }
+                    else json.skip();
+                }
+                scene.models.push_back(model);
+            }
+        } else if (key == "materials") {
+            json.beginArray();
+            while (json.nextElement()) {
+                SceneMaterial material;
+                json.beginObject();
+                std::string field;
+                while (json.nextKey(field)) {
+                    if (field == "name") material.name = json.string();
+                    else if (field == "diffuse") material.diffuse = json.string();
+                    else json.skip();
+                }
+                scene.materials.push_back(material);
+            }
+        } else if (key == "instances") {
+            readInstances(json, "model", scene.models, scene.instances);
+        } else if (key == "billboards") {
+            readInstances(json, "material", scene.materials, scene.billboards);
+        } else if (key == "pointLights") {
+            readPointLights(json, scene.pointLights);
+        } else if (key == "grass") {
+            SceneGrass& grass = scene.grass;
+            json.beginObject();
+            std::string field;
+            while (json.nextKey(field)) {
+                if (field == "model") {
+                    const std::string name = json.string();
+                    grass.model = findByName(name, scene.models);
+                    if (grass.model < 0) {
+                        std::cout << "Scene: grass on unknown model " << name << std::endl;
+                    }
+                }
+                else if (field == "density") grass.density = json.string();
+                else if (field == "blades") grass.blades = (uint32_t) std::max(0.0, json.number());
+                else if (field == "chunkSize") grass.chunkSize = (float) json.number();
+                else if (field == "distance") grass.distance = (float) json.number();
+                else if (field == "height") grass.height = json.vec2();
+                else if (field == "width") grass.width = (float) json.number();
+                else if (field == "minUp") grass.minUp = (float) json.number();
+                else json.skip();
+            }
+        } else if (key == "dirLight") {
+            SceneDirLight& light = scene.dirLight;
+            json.beginObject();
+            std::string field;
+            while (json.nextKey(field)) {
+                if (field == "direction") light.direction = json.vec3();
+                else if (field == "ambient") light.ambient = json.vec3();
+                else if (field == "diffuse") light.diffuse = json.vec3();
+                else if (field == "specular") light.specular = json.vec3();
+                else json.skip();
+            }
+        } else if (key == "spotLight") {
+            SceneSpotLight& light = scene.spotLight;
+            json.beginObject();
+            std::string field;
+            while (json.nextKey(field)) {
+                if (field == "ambient") light.ambient = json.vec3();
+                else if (field == "diffuse") light.diffuse = json.vec3();
+                else if (field == "specular") light.specular = json.vec3();
+                else if (field == "constant") light.constant = (float) json.number();
+                else if (field == "linear") light.linear = (float) json.number();
+                else if (field == "quadratic") light.quadratic = (float) json.number();
+                else if (field == "cutOff") light.cutOff = std::cos(glm::radians((float) json.number()));
+                else if (field == "outerCutOff") light.outerCutOff = std::cos(glm::radians((float) json.number()));
+                else json.skip();
+            }
+        } else if (key == "skybox") {
+            json.beginObject();
+            std::string field;
+            while (json.nextKey(field)) {
+                if (field == "faces") {
+                    json.beginArray();
+                    while (json.nextElement()) {
+                        scene.skyboxFaces.push_back(json.string());
+                    }
+                } else if (field == "flipVertically") {
+                    scene.skyboxFlipVertically = json.boolean();
+                } else {
+                    json.skip();
+                }
+            }
+        } else {
+            json.skip();
+        }
+    }
+    return !json.failed();
+}
+
+// binary cache ---------------------------------------------------------------
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t models, nodeSpins, materials, instances, billboards, pointLights, skyboxFaces;
+    uint32_t skyboxFlipVertically;
+    // the JSON the cache was parsed from; modification times are too coarse to tell an edit apart
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+};
+
+const uint32_t Version = 5;
+
+inline void writeString(FILE* file, const std::string& s) {
+    uint32_t length = (uint32_t) s.size();
+    std::fwrite(&length, sizeof(length), 1, file);
+    std::fwrite(s.data(), 1, length, file);
+}
+
+inline bool readString(FILE* file, std::string& s) {
+    uint32_t length;
+    if (std::fread(&length, sizeof(length), 1, file) != 1 || length > (1u << 20)) {
+        return false;
+    }
+    s.resize(length);
+    return std::fread(&s[0], 1, length, file) == length;
+}
+
+template <typename T>
+inline void writeArray(FILE* file, const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable<T>::value, "binary scene arrays must be plain data");
+    std::fwrite(values.data(), sizeof(T), values.size(), file);
+}
+
+template <typename T>
+inline bool readArray(FILE* file, std::vector<T>& values, uint32_t count) {
+    values.resize(count);
+    return std::fread(values.data(), sizeof(T), count, file) == count;
+}
+
+inline bool writeBinary(const std::string& path, const Scene& scene, uint64_t sourceSize, uint64_t sourceHash) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    Header header = {};
+    std::memcpy(header.magic, "RGSC", 4);
+    header.version = Version;
+    header.models = (uint32_t) scene.models.size();
+    header.nodeSpins = (uint32_t) scene.nodeSpins.size();
+    header.materials = (uint32_t) scene.materials.size();
+    header.instances = (uint32_t) scene.instances.size();
+    header.billboards = (uint32_t) scene.billboards.size();
+    header.pointLights = (uint32_t) scene.pointLights.size();
+    header.skyboxFaces = (uint32_t) scene.skyboxFaces.size();
+    header.skyboxFlipVertically = scene.skyboxFlipVertically;
+    header.sourceSize = sourceSize;
+    header.sourceHash = sourceHash;
+    std::fwrite(&header, sizeof(header), 1, file);
+    for (const SceneModel& model : scene.models) {
+        writeString(file, model.name);
+        writeString(file, model.path);
+        writeString(file, model.texturePrefix);
+        std::fwrite(&model.impostorDistance, sizeof(model.impostorDistance), 1, file);
+        std::fwrite(&model.impostorColumns, sizeof(model.impostorColumns), 1, file);
+        std::fwrite(&model.impostorRows, sizeof(model.impostorRows), 1, file);
+    }
+    for (const SceneNodeSpin& spin : scene.nodeSpins) {
+        std::fwrite(&spin.model, sizeof(spin.model), 1, file);
+        writeString(file, spin.node);
+        std::fwrite(&spin.axis, sizeof(spin.axis), 1, file);
+        std::fwrite(&spin.speed, sizeof(spin.speed), 1, file);
+    }
+    for (const SceneMaterial& material : scene.materials) {
+        writeString(file, material.name);
+        writeString(file, material.diffuse);
+    }
+    for (const std::string& face : scene.skyboxFaces) {
+        writeString(file, face);
+    }
+    writeArray(file, scene.instances);
+    writeArray(file, scene.billboards);
+    writeArray(file, scene.pointLights);
+    std::fwrite(&scene.dirLight, sizeof(scene.dirLight), 1, file);
+    std::fwrite(&scene.spotLight, sizeof(scene.spotLight), 1, file);
+    const SceneGrass& grass = scene.grass;
+    std::fwrite(&grass.model, sizeof(grass.model), 1, file);
+    writeString(file, grass.density);
+    std::fwrite(&grass.blades, sizeof(grass.blades), 1, file);
+    std::fwrite(&grass.chunkSize, sizeof(grass.chunkSize), 1, file);
+    std::fwrite(&grass.distance, sizeof(grass.distance), 1, file);
+    std::fwrite(&grass.height, sizeof(grass.height), 1, file);
+    std::fwrite(&grass.width, sizeof(grass.width), 1, file);
+    std::fwrite(&grass.minUp, sizeof(grass.minUp), 1, file);
+    bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    return ok;
+}
+
+// checkSource rejects a cache made from other JSON than sourceSize bytes hashing to sourceHash
+inline bool readBinary(const std::string& path, Scene& scene, bool checkSource, uint64_t sourceSize, uint64_t sourceHash) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    Header header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+              && std::memcmp(header.magic, "RGSC", 4) == 0
+              && header.version == Version
+              && (!checkSource || (header.sourceSize == sourceSize && header.sourceHash == sourceHash));
+    if (ok) {
+        scene.models.resize(header.models);
+        for (SceneModel& model : scene.models) {
+            ok = ok && readString(file, model.name) && readString(file, model.path) && readString(file, model.texturePrefix)
+                 && std::fread(&model.impostorDistance, sizeof(model.impostorDistance), 1, file) == 1
+                 && std::fread(&model.impostorColumns, sizeof(model.impostorColumns), 1, file) == 1
+                 && std::fread(&model.impostorRows, sizeof(model.impostorRows), 1, file) == 1;
+        }
+        scene.nodeSpins.resize(header.nodeSpins);
+        for (SceneNodeSpin& spin : scene.nodeSpins) {
+            ok = ok && std::fread(&spin.model, sizeof(spin.model), 1, file) == 1 && readString(file, spin.node)
+                 && std::fread(&spin.axis, sizeof(spin.axis), 1, file) == 1
+                 && std::fread(&spin.speed, sizeof(spin.speed), 1, file) == 1;
+        }
+        scene.materials.resize(header.materials);
+        for (SceneMaterial& material : scene.materials) {
+            ok = ok && readString(file, material.name) && readString(file, material.diffuse);
+        }
+        scene.skyboxFaces.resize(header.skyboxFaces);
+        for (std::string& face : scene.skyboxFaces) {
+            ok = ok && readString(file, face);
+        }
+        scene.skyboxFlipVertically = header.skyboxFlipVertically != 0;
+        ok = ok && readArray(file, scene.instances, header.instances)
+             && readArray(file, scene.billboards, header.billboards)
+             && readArray(file, scene.pointLights, header.pointLights)
+             && std::fread(&scene.dirLight, sizeof(scene.dirLight), 1, file) == 1
+             && std::fread(&scene.spotLight, sizeof(scene.spotLight), 1, file) == 1;
+        SceneGrass& grass = scene.grass;
+        ok = ok && std::fread(&grass.model, sizeof(grass.model), 1, file) == 1 && readString(file, grass.density)
+             && std::fread(&grass.blades, sizeof(grass.blades), 1, file) == 1
+             && std::fread(&grass.chunkSize, sizeof(grass.chunkSize), 1, file) == 1
+             && std::fread(&grass.distance, sizeof(grass.distance), 1, file) == 1
+             && std::fread(&grass.height, sizeof(grass.height), 1, file) == 1
+             && std::fread(&grass.width, sizeof(grass.width), 1, file) == 1
+             && std::fread(&grass.minUp, sizeof(grass.minUp), 1, file) == 1;
+    }
+    std::fclose(file);
+    for (const SceneInstance& instance : scene.instances) {
+        ok = ok && instance.index < scene.models.size();
+    }
+    for (const SceneNodeSpin& spin : scene.nodeSpins) {
+        ok = ok && spin.model < scene.models.size();
+    }
+    ok = ok && scene.grass.model < (int32_t) scene.models.size();
+    for (const SceneInstance& billboard : scene.billboards) {
+        ok = ok && billboard.index < scene.materials.size();
+    }
+    return ok;
+}
+
+}
+
+inline std::string sceneCachePath(const std::string& path) {
+    return path + ".rgscene";
+}
+
+// Loads a scene, from the binary cache when it was made from the same JSON,
+// or from the cache alone when the JSON is missing. Prints the reason and
+// returns false when neither can be read or the JSON cannot be parsed.
+inline bool loadScene(const std::string& path, Scene& scene) {
+    const std::string cache = sceneCachePath(path);
+    MappedFile file(path);
+    // hashing the JSON is far cheaper than parsing it
+    const uint64_t sourceHash = file.valid() ? hashBytes(file.data(), file.size()) : 0;
+    Scene binary;
+    if (scene::readBinary(cache, binary, file.valid(), file.size(), sourceHash)) {
+        scene = std::move(binary);
+        return true;
+    }
+    if (!file.valid()) {
+        std::cout << "Scene file not found: " << path << std::endl;
+        return false;
+    }
+    const char* text = reinterpret_cast<const char*>(file.data());
+    JsonReader json(text, text + file.size());
+    Scene parsed;
+    if (!scene::parse(json, parsed)) {
+        std::cout << "Scene " << path << ", " << json.error() << std::endl;
+        return false;
+    }
+    scene::writeBinary(cache, parsed, file.size(), sourceHash);
+    scene = std::move(parsed);
+    return true;
+}
+
+}
+
+#endif //PROJECT_BASE_SCENE_H
@@ -0,0 +1,105 @@
+#ifndef PROJECT_BASE_SHADERWATCHER_H
+#define PROJECT_BASE_SHADERWATCHER_H
+
+#include <learnopengl/shader.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace rg {
+
+// Watches a shader directory on a background thread and triggers Shader::reload()
+// for every registered program that uses a changed file. The thread only records
+// file names; all GL work happens in update(), called from the render thread.
+class ShaderWatcher {
+public:
+    explicit ShaderWatcher(const std::string& directory)
+        : m_Directory(directory) {
+        m_Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_Fd < 0 || inotify_add_watch(m_Fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cerr << "Shader hot-reload disabled, cannot watch " << directory << '\n';
+            return;
+        }
+        m_Running = true;
+        m_Thread = std::thread(&ShaderWatcher::run, this);
+    }
+
+    ~ShaderWatcher() {
+        m_Running = false;
+        if (m_Thread.joinable()) {
+            m_Thread.join();
+        }
+        if (m_Fd >= 0) {
+            close(m_Fd);
+        }
+    }
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    void add(Shader& shader) {
+        m_Shaders.push_back(&shader);
+    }
+
+    // starts recompiles for changed files and swaps in programs that finished
+    void update() {
+        std::set<std::string> changed;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            changed.swap(m_Changed);
+        }
+        for (const std::string& file : changed) {
+            for (Shader* shader : m_Shaders) {
+                if (shader->dependsOn(m_Directory + '/' + file)) {
+                    shader->reload();
+                }
+            }
+        }
+        for (Shader* shader : m_Shaders) {
+            shader->pollReload();
+        }
+    }
+
+private:
+    void run() {
+        alignas(inotify_event) char buffer[4096];
+        pollfd pfd = { m_Fd, POLLIN, 0 };
+        while (m_Running) {
+            // short timeout so the destructor never waits long for the join
+            if (poll(&pfd, 1, 100) <= 0) {
+                continue;
+            }
+            ssize_t length;
+            while ((length = read(m_Fd, buffer, sizeof(buffer))) > 0) {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                for (char* p = buffer; p < buffer + length; ) {
+                    inotify_event* event = reinterpret_cast<inotify_event*>(p);
+                    if (event->len > 0) {
+                        m_Changed.insert(event->name);
+                    }
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+    }
+
+    std::string m_Directory;
+    std::vector<Shader*> m_Shaders;
+    std::set<std::string> m_Changed;
+    std::mutex m_Mutex;
+    std::thread m_Thread;
+    std::atomic<bool> m_Running{false};
+    int m_Fd = -1;
+};
+
+}
+
+#endif //PROJECT_BASE_SHADERWATCHER_H
@@ -0,0 +1,123 @@
+#ifndef PROJECT_BASE_SHADOWCASCADES_H
+#define PROJECT_BASE_SHADOWCASCADES_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace rg {
+
+struct ShadowSettings {
+    unsigned int cascades = 4;
+    unsigned int resolution = 1024;   // texels per side of every layer
+    float distance = 60.0f;           // shadows end this far along the view direction
+    float splitLambda = 0.75f;        // 0 spaces the splits evenly, 1 logarithmically
+    // a cascade moves in steps of this many texels; its static casters are
+    // redrawn once per step instead of every time the camera moves
+    float snapTexels = 16.0f;
+};
+
+struct ShadowCascade {
+    glm::mat4 viewProjection = glm::mat4(1.0f);   // world to the layer's clip space
+    float splitFar = 0.0f;                         // view depth where the cascade ends
+    float texelSize = 0.0f;                        // world units per texel
+};
+
+// Fits the cascades of a directional light's shadow map to the view frustum.
+// Every cascade covers the bounding sphere of its slice of the frustum, which
+// keeps its size the same however the camera turns, and its position in light
+// space is snapped to whole steps of snapTexels texels, so a cascade stays put
+// while the camera moves within a step and shadow edges do not crawl when it
+// does move. Depth covers the casters' bounds along the light, not the slice,
+// so casters behind the camera still land in the map.
+class ShadowCascades {
+public:
+    static const unsigned int MaxCascades = 4;
+
+    // world space box around everything that can cast a shadow
+    void setCasterBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        m_BoundsMin = boundsMin;
+        m_BoundsMax = boundsMax;
+    }
+
+    // Fits the cascades to a perspective camera looking along forward.
+    // Returns a bit per cascade whose matrix changed since the last call.
+    unsigned int update(const ShadowSettings& settings, const glm::vec3& eye, const glm::vec3& forward, float fovY,
+                        float aspect, float nearPlane, const glm::vec3& lightDirection) {
+        m_Count = std::min(std::max(settings.cascades, 1u), (unsigned int) MaxCascades);
+        const glm::vec3 direction = glm::normalize(lightDirection);
+        const glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        const glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+        // depth range of the casters, distances along the light
+        float depthMin = INFINITY, depthMax = -INFINITY;
+        for (int corner = 0; corner < 8; ++corner) {
+            const glm::vec3 p((corner & 1) ? m_BoundsMax.x : m_BoundsMin.x, (corner & 2) ? m_BoundsMax.y : m_BoundsMin.y,
+                              (corner & 4) ? m_BoundsMax.z : m_BoundsMin.z);
+            const float depth = -(lightView * glm::vec4(p, 1.0f)).z;
+            depthMin = std::min(depthMin, depth);
+            depthMax = std::max(depthMax, depth);
+        }
+
+        // half the size of a slice's cross-section per unit of view depth, corner to corner
+        const float tanHalf = std::tan(fovY * 0.5f);
+        const float spread = tanHalf * tanHalf * (1.0f + aspect * aspect);
+        // the padding covers the sphere however far its center is snapped
+        const float snap = std::min(settings.snapTexels, settings.resolution * 0.25f);
+        const float padding = 1.0f / (1.0f - 2.0f * snap / settings.resolution);
+        unsigned int changed = 0;
+        float splitNear = nearPlane;
+        for (unsigned int i = 0; i < m_Count; ++i) {
+            const float t = (float) (i + 1) / m_Count;
+            const float logarithmic = nearPlane * std::pow(settings.distance / nearPlane, t);
+            const float uniform = nearPlane + (settings.distance - nearPlane) * t;
+            const float splitFar = settings.splitLambda * logarithmic + (1.0f - settings.splitLambda) * uniform;
+
+            // the center along the view axis that puts the near and far corners on the sphere
+            const float center = std::min(splitFar, 0.5f * (splitNear + splitFar) * (1.0f + spread));
+            const float radius = std::sqrt(std::max((splitFar - center) * (splitFar - center) + splitFar * splitFar * spread,
+                                                    (center - splitNear) * (center - splitNear) + splitNear * splitNear * spread));
+            // rounded up so float noise from turning the camera never changes the size
+            const float half = std::ceil(radius * padding * 16.0f) / 16.0f;
+            const float texel = 2.0f * half / settings.resolution;
+            const float step = texel * snap;
+
+            glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(eye + forward * center, 1.0f));
+            lightCenter.x = std::floor(lightCenter.x / step + 0.5f) * step;
+            lightCenter.y = std::floor(lightCenter.y / step + 0.5f) * step;
+            const glm::mat4 projection = glm::ortho(lightCenter.x - half, lightCenter.x + half, lightCenter.y - half,
+                                                    lightCenter.y + half, depthMin, depthMax);
+
+            ShadowCascade& cascade = m_Cascades[i];
+            const glm::mat4 viewProjection = projection * lightView;
+            if (viewProjection != cascade.viewProjection) {
+                changed |= 1u << i;
+            }
+            cascade.viewProjection = viewProjection;
+            cascade.splitFar = splitFar;
+            cascade.texelSize = texel;
+            splitNear = splitFar;
+        }
+        return changed;
+    }
+
+    unsigned int count() const {
+        return m_Count;
+    }
+
+    const ShadowCascade& cascade(unsigned int i) const {
+        return m_Cascades[i];
+    }
+
+private:
+    ShadowCascade m_Cascades[MaxCascades];
+    unsigned int m_Count = 0;
+    glm::vec3 m_BoundsMin = glm::vec3(-1.0f);
+    glm::vec3 m_BoundsMax = glm::vec3(1.0f);
+};
+
+}
+
+#endif //PROJECT_BASE_SHADOWCASCADES_H
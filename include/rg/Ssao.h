@@ -0,0 +1,191 @@
+#ifndef PROJECT_BASE_SSAO_H
+#define PROJECT_BASE_SSAO_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Error.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+struct SsaoSettings {
+    int samples;       // hemisphere samples per pixel
+    float radius;      // world units around the surface that can occlude it
+    int blurRadius;    // texels on each side, per direction of the separable blur
+};
+
+// Screen-space ambient occlusion from the scene's depth alone, at half the
+// screen's resolution. Normals are rebuilt from the depth (the neighbour on
+// each axis with the smaller step, so silhouettes do not bend them), a small
+// hemisphere kernel turned by a 4x4 noise tile is tested against the depth,
+// and the noise is removed by a separable blur that does not mix texels of
+// different depths. The result is RG16F, occlusion and view depth, so the
+// lighting shader can upsample it to full resolution by depth as well.
+class AmbientOcclusion {
+public:
+    enum Preset {
+        Performance = 0,
+        Quality = 1
+    };
+
+    // bloom.fs samples the result here, below the point shadows' units
+    static const GLuint Unit = 10;
+    static const int MaxSamples = 32;
+
+    AmbientOcclusion(int width, int height) : m_Width(std::max(width / 2, 1)), m_Height(std::max(height / 2, 1)) {
+        GLState& gl = GLState::instance();
+        glGenTextures(2, m_Targets);
+        glGenFramebuffers(2, m_Framebuffers);
+        for (int i = 0; i < 2; ++i) {
+            gl.bindTexture(0, GL_TEXTURE_2D, m_Targets[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, m_Width, m_Height, 0, GL_RG, GL_FLOAT, nullptr);
+            // read texel by texel, filtering would mix depths
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Targets[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cout << "SSAO: framebuffer not complete" << std::endl;
+            }
+            GLLABEL(GL_TEXTURE, m_Targets[i], i == 0 ? "SSAO" : "SSAO blur");
+            GLLABEL(GL_FRAMEBUFFER, m_Framebuffers[i], i == 0 ? "SSAO" : "SSAO blur");
+        }
+        gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // unit vectors in the tangent plane that turn the kernel per pixel
+        uint32_t state = 0x9e3779b9u;
+        std::vector<float> noise;
+        for (int i = 0; i < 16; ++i) {
+            const float angle = random(state) * 6.2831853f;
+            noise.push_back(std::cos(angle));
+            noise.push_back(std::sin(angle));
+        }
+        glGenTextures(1, &m_Noise);
+        gl.bindTexture(0, GL_TEXTURE_2D, m_Noise);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 4, 4, 0, GL_RG, GL_FLOAT, noise.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        gl.bindTexture(0, GL_TEXTURE_2D, 0);
+        GLLABEL(GL_TEXTURE, m_Noise, "SSAO noise");
+
+        // points in the +z hemisphere, denser close to the center where occluders matter most
+        for (int i = 0; i < MaxSamples; ++i) {
+            glm::vec3 sample(random(state) * 2.0f - 1.0f, random(state) * 2.0f - 1.0f, random(state));
+            sample = glm::normalize(sample) * random(state);
+            const float t = (float) i / MaxSamples;
+            m_Kernel[i] = sample * (0.1f + 0.9f * t * t);
+        }
+        setPreset(Performance);
+    }
+
+    AmbientOcclusion(const AmbientOcclusion&) = delete;
+    AmbientOcclusion& operator=(const AmbientOcclusion&) = delete;
+
+    ~AmbientOcclusion() {
+        GLState& gl = GLState::instance();
+        for (int i = 0; i < 2; ++i) {
+            gl.forgetFramebuffer(m_Framebuffers[i]);
+            gl.forgetTexture(m_Targets[i]);
+        }
+        gl.forgetTexture(m_Noise);
+        glDeleteFramebuffers(2, m_Framebuffers);
+        glDeleteTextures(2, m_Targets);
+        glDeleteTextures(1, &m_Noise);
+    }
+
+    void setPreset(Preset preset) {
+        m_Settings = preset == Quality ? SsaoSettings{ 16, 0.6f, 4 } : SsaoSettings{ 8, 0.5f, 2 };
+    }
+
+    const SsaoSettings& settings() const {
+        return m_Settings;
+    }
+
+    // Occlusion of the depth in depthTexture (full resolution, the scene's
+    // projection) into the half resolution target, then blurred twice.
+    // drawQuad() draws a screen filling quad with positions and texture
+    // coordinates in attributes 0 and 1, what ssao.fs and ssao_blur.fs expect.
+    template <typename DrawQuad>
+    void render(GLuint depthTexture, const glm::mat4& projection, Shader& ssaoShader, Shader& blurShader,
+                DrawQuad drawQuad) {
+        GLState& gl = GLState::instance();
+        const GLState::Snapshot saved = gl.save();
+        GLGROUP("SSAO");
+        gl.viewport(0, 0, m_Width, m_Height);
+        gl.disable(GL_DEPTH_TEST);
+        gl.disable(GL_BLEND);
+        gl.bindTexture(0, GL_TEXTURE_2D, depthTexture);
+
+        gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[0]);
+        ssaoShader.use();
+        ssaoShader.setInt("depth", 0);
+        ssaoShader.setInt("noise", 1);
+        ssaoShader.setMat4("projection", projection);
+        ssaoShader.setMat4("inverseProjection", glm::inverse(projection));
+        ssaoShader.setInt("sampleCount", m_Settings.samples);
+        ssaoShader.setFloat("radius", m_Settings.radius);
+        ssaoShader.setVec2("noiseScale", glm::vec2(m_Width / 4.0f, m_Height / 4.0f));
+        for (int i = 0; i < m_Settings.samples; ++i) {
+            ssaoShader.setVec3("samples[" + std::to_string(i) + "]", m_Kernel[i]);
+        }
+        gl.bindTexture(1, GL_TEXTURE_2D, m_Noise);
+        drawQuad();
+
+        // horizontally into the second target, vertically back into the first
+        blurShader.use();
+        blurShader.setInt("image", 0);
+        blurShader.setInt("blurRadius", m_Settings.blurRadius);
+        for (int pass = 0; pass < 2; ++pass) {
+            gl.bindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[1 - pass]);
+            gl.bindTexture(0, GL_TEXTURE_2D, m_Targets[pass]);
+            blurShader.setVec2("direction", pass == 0 ? glm::vec2(1.0f / m_Width, 0.0f) : glm::vec2(0.0f, 1.0f / m_Height));
+            drawQuad();
+        }
+        gl.restore(saved);
+    }
+
+    // Binds the result for a shader that applies it (bloom.fs), which must
+    // be in use; not enabled leaves the ambient light unoccluded.
+    void bind(Shader& shader, bool enabled) const {
+        if (enabled) {
+            GLState::instance().bindTexture(Unit, GL_TEXTURE_2D, m_Targets[0]);
+        }
+        shader.setBool("ssaoEnabled", enabled);
+    }
+
+    static void setSamplers(Shader& shader) {
+        shader.setInt("ssao", Unit);
+    }
+
+private:
+    // xorshift32, the top 24 bits as a float in [0, 1)
+    static float random(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state >> 8) / 16777216.0f;
+    }
+
+    int m_Width, m_Height;
+    GLuint m_Targets[2] = { 0, 0 };   // occlusion and view depth; the second is the blur's scratch
+    GLuint m_Framebuffers[2] = { 0, 0 };
+    GLuint m_Noise = 0;
+    glm::vec3 m_Kernel[MaxSamples];
+    SsaoSettings m_Settings;
+};
+
+}
+
+#endif //PROJECT_BASE_SSAO_H
@@ -0,0 +1,250 @@
+#ifndef PROJECT_BASE_TEXTUREREGISTRY_H
+#define PROJECT_BASE_TEXTUREREGISTRY_H
+
+#include <glad/glad.h>
+#include <common.h>
+#include <rg/Error.h>
+#include <rg/MappedFile.h>
+#include <rg/TextureStreamer.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rg {
+
+// Process-wide owner of every texture loaded from disk. Requests are looked up
+// by normalized path first and by a content key second, so the same image
+// reached through different paths, different models or a copied file is only
+// decoded and uploaded once. The content key is the file's size and its first
+// and last few kilobytes, two small reads, so a miss never reads more; a hit
+// is only shared after the files compare equal to the ones the texture was
+// made from. Each acquire() takes a reference; the GL texture is deleted when
+// the last one is released, or at shutdown().
+class TextureRegistry {
+public:
+    static TextureRegistry& instance() {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    // 2D texture streamed in by TextureStreamer
+    unsigned int acquire(const std::string& path, const TextureParams& params = TextureParams()) {
+        return acquire(std::vector<std::string>{ path }, variant(params), GL_TEXTURE_2D,
+                       [&path, &params] { return TextureStreamer::instance().request(path, params); });
+    }
+
+    // Any texture built from one or more files, e.g. the six faces of a cubemap.
+    // variant tells apart textures made from the same files with different
+    // sampling or format settings; create() is only called on a miss.
+    unsigned int acquire(const std::vector<std::string>& files, uint64_t variant, GLenum target,
+                         const std::function<unsigned int()>& create) {
+        std::string pathKey = std::to_string(target) + ':' + std::to_string(variant);
+        for (const std::string& file : files) {
+            pathKey += '|' + normalizePath(file);
+        }
+        auto byPath = m_ByPath.find(pathKey);
+        if (byPath != m_ByPath.end()) {
+            ++pathHits;
+            return retain(byPath->second);
+        }
+
+        uint64_t contentKey = hashBytes(&target, sizeof(target), variant);
+        bool keyed = true;
+        for (const std::string& file : files) {
+            keyed = hashFile(file, contentKey) && keyed;
+        }
+        if (keyed) {
+            auto byContent = m_ByContent.find(contentKey);
+            if (byContent != m_ByContent.end()) {
+                if (sameFiles(files, m_Entries[byContent->second].files)) {
+                    ++contentHits;
+                    m_ByPath[pathKey] = byContent->second;
+                    m_Entries[byContent->second].pathKeys.push_back(pathKey);
+                    return retain(byContent->second);
+                }
+                // same ends and size, different image: loaded on its own
+                keyed = false;
+            }
+        }
+
+        ++loads;
+        unsigned int id = create();
+        GLLABEL(GL_TEXTURE, id, files.front());
+        Entry& entry = m_Entries[id];
+        entry.refs = 1;
+        entry.target = target;
+        entry.pathKeys.push_back(pathKey);
+        entry.files = files;
+        m_ByPath[pathKey] = id;
+        // unreadable files still get a (placeholder) texture, but must not all
+        // end up sharing the same empty content key; a collision keeps the key
+        // with the texture that had it first
+        if (keyed) {
+            entry.contentKey = contentKey;
+            entry.hasContentKey = true;
+            m_ByContent[contentKey] = id;
+        }
+        return id;
+    }
+
+    // another reference to a texture handed out by acquire()
+    unsigned int retain(unsigned int id) {
+        auto it = m_Entries.find(id);
+        if (it != m_Entries.end()) {
+            ++it->second.refs;
+        }
+        return id;
+    }
+
+    void release(unsigned int id) {
+        auto it = m_Entries.find(id);
+        if (it == m_Entries.end() || --it->second.refs > 0) {
+            return;
+        }
+        for (const std::string& key : it->second.pathKeys) {
+            m_ByPath.erase(key);
+        }
+        if (it->second.hasContentKey) {
+            m_ByContent.erase(it->second.contentKey);
+        }
+        destroy(id);
+        m_Entries.erase(it);
+    }
+
+    // Deletes everything still alive; later release() calls become no-ops, so
+    // objects destroyed after the context is gone are harmless.
+    void shutdown() {
+        for (auto& entry : m_Entries) {
+            destroy(entry.first);
+        }
+        m_Entries.clear();
+        m_ByPath.clear();
+        m_ByContent.clear();
+    }
+
+    size_t size() const {
+        return m_Entries.size();
+    }
+
+    unsigned int loads = 0;
+    unsigned int pathHits = 0;
+    unsigned int contentHits = 0;
+
+    // Canonical absolute path when the file exists, otherwise the path with
+    // "." and "dir/.." components and repeated slashes removed.
+    static std::string normalizePath(const std::string& path) {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved)) {
+            return resolved;
+        }
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = path.find('/', start);
+            if (end == std::string::npos) {
+                end = path.size();
+            }
+            std::string part = path.substr(start, end - start);
+            if (part == "..") {
+                if (!parts.empty() && parts.back() != "..") {
+                    parts.pop_back();
+                } else {
+                    parts.push_back(part);
+                }
+            } else if (!part.empty() && part != ".") {
+                parts.push_back(part);
+            }
+            start = end + 1;
+        }
+        std::string normalized = !path.empty() && path[0] == '/' ? "/" : "";
+        for (size_t i = 0; i < parts.size(); ++i) {
+            normalized += (i ? "/" : "") + parts[i];
+        }
+        return normalized;
+    }
+
+private:
+    struct Entry {
+        unsigned int refs = 0;
+        GLenum target = GL_TEXTURE_2D;
+        uint64_t contentKey = 0;
+        bool hasContentKey = false;
+        std::vector<std::string> pathKeys;
+        std::vector<std::string> files;   // what the texture was made from, to confirm content matches
+    };
+
+    TextureRegistry() = default;
+
+    static uint64_t variant(const TextureParams& params) {
+        const int fields[] = { params.wrapS, params.wrapT, params.minFilter, params.magFilter,
+                               params.gammaCorrection, params.flipVertically, params.clampIfAlpha };
+        return hashBytes(fields, sizeof(fields));
+    }
+
+    // Bytes read from each end of a file for its content key. The key only
+    // finds candidates, uncompressed images of one size can share both ends.
+    static const size_t SampleBytes = 16 * 1024;
+
+    static bool hashFile(const std::string& path, uint64_t& hash) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 && st.st_size > 0;
+        if (ok) {
+            const uint64_t size = (uint64_t) st.st_size;
+            const size_t head = (size_t) std::min(size, (uint64_t) SampleBytes);
+            const size_t tail = (size_t) std::min(size - head, (uint64_t) SampleBytes);
+            std::vector<unsigned char> sample(head + tail);
+            ok = pread(fd, sample.data(), head, 0) == (ssize_t) head &&
+                 pread(fd, sample.data() + head, tail, (off_t) (size - tail)) == (ssize_t) tail;
+            hash = hashBytes(&size, sizeof(size), hash);
+            hash = hashBytes(sample.data(), sample.size(), hash);
+        }
+        close(fd);
+        return ok;
+    }
+
+    // byte for byte, only reached when the content keys (and so the sizes) match
+    static bool sameFiles(const std::vector<std::string>& files, const std::vector<std::string>& others) {
+        if (files.size() != others.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (normalizePath(files[i]) == normalizePath(others[i])) {
+                continue;
+            }
+            MappedFile file(files[i]), other(others[i]);
+            if (!file.valid() || !other.valid() || file.size() != other.size() ||
+                std::memcmp(file.data(), other.data(), file.size()) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void destroy(unsigned int id) {
+        TextureStreamer::instance().cancel(id);
+        GLState::instance().forgetTexture(id);
+        glDeleteTextures(1, &id);
+    }
+
+    std::unordered_map<unsigned int, Entry> m_Entries;
+    std::unordered_map<std::string, unsigned int> m_ByPath;
+    std::unordered_map<uint64_t, unsigned int> m_ByContent;
+};
+
+}
+
+#endif //PROJECT_BASE_TEXTUREREGISTRY_H
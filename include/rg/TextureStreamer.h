@@ -0,0 +1,478 @@
+#ifndef PROJECT_BASE_TEXTURESTREAMER_H
+#define PROJECT_BASE_TEXTURESTREAMER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <rg/CookedTexture.h>
+#include <rg/GLState.h>
+#include <rg/MappedFile.h>
+#include <rg/MipChain.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+
+namespace rg {
+
+struct TextureParams {
+    GLint wrapS = GL_REPEAT;
+    GLint wrapT = GL_REPEAT;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+    bool gammaCorrection = false;
+    bool flipVertically = false;
+    // loadTexture() clamps RGBA textures so alpha-tested quads get no bleeding edges
+    bool clampIfAlpha = false;
+};
+
+struct TextureImage {
+    int channels = 0;
+    GLenum internalFormat = GL_RGBA8;
+    GLenum format = GL_RGBA;
+    // block compressed levels are uploaded in rows of 4x4 blocks
+    bool compressed = false;
+    int blockBytes = 0;
+    std::vector<TextureLevel> levels; // full resolution first
+};
+
+// Asynchronous texture loading. request() hands out a texture name right away,
+// backed by a 1x1 placeholder; worker threads decode the file and build the mip
+// chain, and update() streams the levels through a ring of pixel buffer objects,
+// smallest first, within a per-frame byte budget. Fences on the ring slots keep
+// the render thread from ever waiting on the driver.
+class TextureStreamer {
+public:
+    static TextureStreamer& instance() {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+
+    unsigned int request(const std::string& path, const TextureParams& params = TextureParams()) {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        GLState::instance().bindTexture(GL_TEXTURE_2D, textureID);
+        const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, params.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, params.wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, params.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, params.magFilter);
+
+        startWorkers();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Jobs.push_back(Job{ textureID, ++m_Serial, path, params, TextureImage() });
+            m_Active[textureID] = m_Serial;
+            ++m_Pending;
+        }
+        m_JobAdded.notify_one();
+        return textureID;
+    }
+
+    // Uploads at most byteBudget bytes of decoded texels. Call once per frame on
+    // the thread that owns the GL context.
+    void update(size_t byteBudget = 8 * 1024 * 1024) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            while (!m_Decoded.empty()) {
+                if (active(m_Decoded.front().job)) {
+                    m_Uploads.push_back(std::move(m_Decoded.front()));
+                }
+                m_Decoded.pop_front();
+            }
+        }
+        if (m_Uploads.empty()) {
+            return;
+        }
+        if (m_Slots.empty()) {
+            createSlots();
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        size_t uploaded = 0;
+        while (!m_Uploads.empty() && uploaded < byteBudget) {
+            Upload& up = m_Uploads.front();
+            TextureImage& image = up.job.image;
+            if (image.levels.empty()) {
+                // decode failed, the placeholder stays
+                finish();
+                continue;
+            }
+            const TextureLevel& level = image.levels[up.level];
+            // for compressed images a "row" is a row of blocks, four texels high
+            const int rowHeight = image.compressed ? 4 : 1;
+            const int rowCount = (level.height + rowHeight - 1) / rowHeight;
+            const size_t rowBytes = image.compressed ? (size_t) ((level.width + 3) / 4) * image.blockBytes
+                                                     : (size_t) level.width * image.channels;
+            const int rows = std::min(rowCount - up.row, (int) std::max<size_t>(1, m_SlotSize / rowBytes));
+            const size_t bytes = rows * rowBytes;
+            const unsigned char* src = level.pixels.data() + up.row * rowBytes;
+            const int y = up.row * rowHeight;
+            const int height = std::min(level.height - y, rows * rowHeight);
+
+            Slot* slot = nullptr;
+            if (bytes <= m_SlotSize) {
+                slot = acquireSlot();
+                if (!slot) {
+                    break;
+                }
+            }
+            GLState::instance().bindTexture(GL_TEXTURE_2D, up.job.texture);
+            if (!up.allocated) {
+                allocate(up);
+            }
+            if (slot) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer);
+                // the slot's fence has signalled, so nothing still reads from it
+                void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+                std::memcpy(dst, src, bytes);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                subImage(image, up.level, y, level.width, height, bytes, nullptr);
+                slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            } else {
+                subImage(image, up.level, y, level.width, height, bytes, src);
+            }
+            uploaded += bytes;
+            up.row += rows;
+
+            if (up.row == rowCount) {
+                // the finished level becomes the sharpest one the sampler may use
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, up.level);
+                up.row = 0;
+                if (up.level == 0) {
+                    finish();
+                } else {
+                    --up.level;
+                }
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // textures requested but not fully resident yet
+    unsigned int pending() const {
+        return m_Pending;
+    }
+
+    // Forgets a request whose texture is about to be deleted; render thread only.
+    // A job that a worker is decoding right now is dropped when it comes back.
+    void cancel(unsigned int texture) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Active.erase(texture) == 0) {
+            return;
+        }
+        --m_Pending;
+        auto queued = std::find_if(m_Jobs.begin(), m_Jobs.end(), [texture](const Job& job) { return job.texture == texture; });
+        if (queued != m_Jobs.end()) {
+            m_Jobs.erase(queued);
+        }
+        auto uploading = std::find_if(m_Uploads.begin(), m_Uploads.end(), [texture](const Upload& up) { return up.job.texture == texture; });
+        if (uploading != m_Uploads.end()) {
+            m_Uploads.erase(uploading);
+        }
+    }
+
+    // releases the GL objects, must run before the context goes away
+    void shutdown() {
+        stopWorkers();
+        for (Slot& slot : m_Slots) {
+            if (slot.fence) {
+                glDeleteSync(slot.fence);
+            }
+            glDeleteBuffers(1, &slot.buffer);
+        }
+        m_Slots.clear();
+        m_Uploads.clear();
+        m_Decoded.clear();
+        m_Active.clear();
+        m_Pending = 0;
+    }
+
+    ~TextureStreamer() {
+        stopWorkers();
+    }
+
+private:
+    struct Job {
+        unsigned int texture;
+        // texture names are recycled once deleted, the serial tells requests apart
+        uint64_t serial;
+        std::string path;
+        TextureParams params;
+        TextureImage image;
+    };
+
+    struct Upload {
+        Job job;
+        int level;
+        int row = 0;
+        bool allocated = false;
+
+        Upload(Job&& j)
+                : job(std::move(j)), level((int) job.image.levels.size() - 1) {}
+    };
+
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+    };
+
+    static const int SlotCount = 3;
+
+    TextureStreamer() = default;
+
+    void startWorkers() {
+        if (!m_Workers.empty()) {
+            return;
+        }
+        m_Stop = false;
+        // one core is left to the render thread; hardware_concurrency() is 0 when unknown
+        unsigned int count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        for (unsigned int i = 0; i < count; ++i) {
+            m_Workers.emplace_back(&TextureStreamer::work, this);
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+            m_Jobs.clear();
+        }
+        m_JobAdded.notify_all();
+        for (std::thread& worker : m_Workers) {
+            worker.join();
+        }
+        m_Workers.clear();
+    }
+
+    void work() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_JobAdded.wait(lock, [this] { return m_Stop || !m_Jobs.empty(); });
+                if (m_Stop) {
+                    return;
+                }
+                job = std::move(m_Jobs.front());
+                m_Jobs.pop_front();
+            }
+            decode(job);
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Decoded.push_back(Upload(std::move(job)));
+        }
+    }
+
+    static void decode(Job& job) {
+        if (!job.params.flipVertically && loadCooked(job)) {
+            return;
+        }
+        stbi_set_flip_vertically_on_load_thread(job.params.flipVertically);
+        int width, height, nrComponents;
+        unsigned char* data = nullptr;
+        {
+            MappedFile file(job.path);
+            if (file.valid()) {
+                data = stbi_load_from_memory(file.data(), (int) file.size(), &width, &height, &nrComponents, 0);
+            }
+        }
+        if (!data) {
+            std::cout << "Texture failed to load at path: " << job.path << std::endl;
+            return;
+        }
+        TextureImage& image = job.image;
+        image.channels = nrComponents;
+        const bool srgb = job.params.gammaCorrection && nrComponents >= 3;
+        if (nrComponents == 1) {
+            image.internalFormat = GL_R8;
+            image.format = GL_RED;
+        } else if (nrComponents == 2) {
+            image.internalFormat = GL_RG8;
+            image.format = GL_RG;
+        } else if (nrComponents == 3) {
+            image.internalFormat = srgb ? GL_SRGB8 : GL_RGB8;
+            image.format = GL_RGB;
+        } else {
+            image.internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+            image.format = GL_RGBA;
+        }
+        TextureLevel base;
+        base.width = width;
+        base.height = height;
+        base.pixels.assign(data, data + (size_t) width * height * nrComponents);
+        stbi_image_free(data);
+        image.levels.push_back(std::move(base));
+        if (job.params.minFilter != GL_LINEAR && job.params.minFilter != GL_NEAREST) {
+            buildMipChain(image.levels, image.channels, srgb);
+        }
+    }
+
+    // Uses <path>.rgtex from tools/texture_cooker when it is at least as new as
+    // the source image and the driver can sample its format. Cooked textures are
+    // stored top row first, so flipped requests always decode the source.
+    static bool loadCooked(Job& job) {
+        const std::string path = cookedPath(job.path);
+        struct stat source, cooked;
+        if (stat(path.c_str(), &cooked) != 0 || (stat(job.path.c_str(), &source) == 0 && source.st_mtime > cooked.st_mtime)) {
+            return false;
+        }
+        CookedTexture texture;
+        if (!readCookedTexture(path, texture)) {
+            std::cout << "Ignoring unreadable cooked texture " << path << std::endl;
+            return false;
+        }
+        TextureImage& image = job.image;
+        const bool srgb = job.params.gammaCorrection && (texture.flags & CookedSRGB);
+        const bool s3tc = GLAD_GL_EXT_texture_compression_s3tc;
+        const bool s3tcSrgb = s3tc && GLAD_GL_EXT_texture_sRGB;
+        switch (texture.format) {
+            case CookedFormat::R8:
+                image.channels = 1; image.internalFormat = GL_R8; image.format = GL_RED;
+                break;
+            case CookedFormat::RG8:
+                image.channels = 2; image.internalFormat = GL_RG8; image.format = GL_RG;
+                break;
+            case CookedFormat::RGB8:
+                image.channels = 3; image.internalFormat = srgb ? GL_SRGB8 : GL_RGB8; image.format = GL_RGB;
+                break;
+            case CookedFormat::RGBA8:
+                image.channels = 4; image.internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8; image.format = GL_RGBA;
+                break;
+            case CookedFormat::BC1:
+                if (!s3tc || (srgb && !s3tcSrgb)) {
+                    return false;
+                }
+                image.channels = 3; image.blockBytes = 8;
+                image.internalFormat = srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+                break;
+            case CookedFormat::BC3:
+                if (!s3tc || (srgb && !s3tcSrgb)) {
+                    return false;
+                }
+                image.channels = 4; image.blockBytes = 16;
+                image.internalFormat = srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+                break;
+            case CookedFormat::BC5:
+                // RGTC is core since 3.0
+                image.channels = 2; image.blockBytes = 16;
+                image.internalFormat = GL_COMPRESSED_RG_RGTC2;
+                break;
+        }
+        image.compressed = image.blockBytes > 0;
+        // a linear min filter only ever samples the base level
+        const bool mips = job.params.minFilter != GL_LINEAR && job.params.minFilter != GL_NEAREST;
+        const size_t count = mips ? texture.levels.size() : 1;
+        for (size_t i = 0; i < count; ++i) {
+            TextureLevel level;
+            level.width = texture.levels[i].width;
+            level.height = texture.levels[i].height;
+            level.pixels = std::move(texture.levels[i].data);
+            image.levels.push_back(std::move(level));
+        }
+        return true;
+    }
+
+    static void subImage(const TextureImage& image, int level, int y, int width, int height,
+                         size_t bytes, const void* data) {
+        if (image.compressed) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, height, image.internalFormat, (GLsizei) bytes, data);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, height, image.format, GL_UNSIGNED_BYTE, data);
+        }
+    }
+
+    // replaces the placeholder with storage for the whole chain, sampling
+    // starts at the 1x1 level that is uploaded right after this
+    void allocate(Upload& up) {
+        const TextureImage& image = up.job.image;
+        for (size_t i = 0; i < image.levels.size(); ++i) {
+            const TextureLevel& level = image.levels[i];
+            if (image.compressed) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint) i, image.internalFormat, level.width, level.height, 0,
+                                       (GLsizei) level.pixels.size(), nullptr);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, (GLint) i, image.internalFormat, level.width, level.height,
+                             0, image.format, GL_UNSIGNED_BYTE, nullptr);
+            }
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, up.level);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, up.level);
+        if (up.job.params.clampIfAlpha && image.channels == 4) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        up.allocated = true;
+    }
+
+    // the job has not been cancelled, m_Mutex must be held
+    bool active(const Job& job) const {
+        auto it = m_Active.find(job.texture);
+        return it != m_Active.end() && it->second == job.serial;
+    }
+
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Active.erase(m_Uploads.front().job.texture);
+        }
+        m_Uploads.pop_front();
+        --m_Pending;
+    }
+
+    void createSlots() {
+        m_Slots.resize(SlotCount);
+        for (Slot& slot : m_Slots) {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, m_SlotSize, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // next ring slot, or null when the GPU has not consumed it yet
+    Slot* acquireSlot() {
+        Slot& slot = m_Slots[m_NextSlot];
+        if (slot.fence) {
+            if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+                return nullptr;
+            }
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        m_NextSlot = (m_NextSlot + 1) % SlotCount;
+        return &slot;
+    }
+
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_JobAdded;
+    std::deque<Job> m_Jobs;
+    std::deque<Upload> m_Decoded;
+    std::unordered_map<unsigned int, uint64_t> m_Active;
+    uint64_t m_Serial = 0;
+    bool m_Stop = false;
+
+    // render thread only
+    std::deque<Upload> m_Uploads;
+    std::vector<Slot> m_Slots;
+    size_t m_SlotSize = 4 * 1024 * 1024;
+    int m_NextSlot = 0;
+    std::atomic<unsigned int> m_Pending{0};
+};
+
+}
+
+#endif //PROJECT_BASE_TEXTURESTREAMER_H
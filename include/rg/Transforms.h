@@ -0,0 +1,265 @@
+#ifndef PROJECT_BASE_TRANSFORMS_H
+#define PROJECT_BASE_TRANSFORMS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RG_TRANSFORMS_SSE2 1
+#endif
+
+namespace rg {
+
+using Entity = uint32_t;
+
+const Entity InvalidEntity = 0xffffffffu;
+
+// Position/rotation/scale of every entity, stored as one array per component
+// so the batch update streams through them four entities at a time. Setters
+// only mark the entity dirty; update() rebuilds the world matrices (T * S * R,
+// scaled along the world axes after rotating, as the scene always placed its
+// instances) of the dirty ones into one contiguous array, in the layout an instance
+// buffer wants, and reports the range it rewrote for a glBufferSubData.
+//
+// Entities are handles: destroy() moves the last entity into the hole, so
+// dense indices (and matrix slots) change but handles stay valid.
+class TransformStore {
+public:
+    Entity create(const glm::vec3& position = glm::vec3(0.0f), const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                  const glm::vec3& scale = glm::vec3(1.0f)) {
+        Entity entity;
+        if (!m_Free.empty()) {
+            entity = m_Free.back();
+            m_Free.pop_back();
+        } else {
+            entity = (Entity) m_Index.size();
+            m_Index.push_back(InvalidEntity);
+        }
+        uint32_t index = (uint32_t) m_Count++;
+        if (m_Count > m_Entities.size()) {
+            grow();
+        }
+        m_Index[entity] = index;
+        m_Entities[index] = entity;
+        write(index, position, rotation, scale);
+        return entity;
+    }
+
+    void destroy(Entity entity) {
+        if (!alive(entity)) {
+            return;
+        }
+        uint32_t index = m_Index[entity];
+        uint32_t last = (uint32_t) --m_Count;
+        if (index != last) {
+            Entity moved = m_Entities[last];
+            write(index, position(moved), rotation(moved), scale(moved));
+            m_Entities[index] = moved;
+            m_Index[moved] = index;
+        }
+        write(last, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+        m_Dirty[last] = 0;
+        m_Entities[last] = InvalidEntity;
+        m_Index[entity] = InvalidEntity;
+        m_Free.push_back(entity);
+    }
+
+    bool alive(Entity entity) const {
+        return entity < m_Index.size() && m_Index[entity] != InvalidEntity;
+    }
+
+    size_t size() const {
+        return m_Count;
+    }
+
+    void setPosition(Entity entity, const glm::vec3& position) {
+        uint32_t i = m_Index[entity];
+        m_PX[i] = position.x;
+        m_PY[i] = position.y;
+        m_PZ[i] = position.z;
+        markDirty(i);
+    }
+
+    // unit quaternion
+    void setRotation(Entity entity, const glm::quat& rotation) {
+        uint32_t i = m_Index[entity];
+        m_QX[i] = rotation.x;
+        m_QY[i] = rotation.y;
+        m_QZ[i] = rotation.z;
+        m_QW[i] = rotation.w;
+        markDirty(i);
+    }
+
+    void setScale(Entity entity, const glm::vec3& scale) {
+        uint32_t i = m_Index[entity];
+        m_SX[i] = scale.x;
+        m_SY[i] = scale.y;
+        m_SZ[i] = scale.z;
+        markDirty(i);
+    }
+
+    glm::vec3 position(Entity entity) const {
+        uint32_t i = m_Index[entity];
+        return glm::vec3(m_PX[i], m_PY[i], m_PZ[i]);
+    }
+
+    glm::quat rotation(Entity entity) const {
+        uint32_t i = m_Index[entity];
+        return glm::quat(m_QW[i], m_QX[i], m_QY[i], m_QZ[i]);
+    }
+
+    glm::vec3 scale(Entity entity) const {
+        uint32_t i = m_Index[entity];
+        return glm::vec3(m_SX[i], m_SY[i], m_SZ[i]);
+    }
+
+    // Rebuilds the world matrices of everything changed since the last call
+    // and returns how many entities were dirty.
+    size_t update() {
+        m_ChangedBegin = m_DirtyBegin;
+        m_ChangedEnd = std::min(m_DirtyEnd, m_Count);
+        size_t updated = 0;
+        size_t i = m_ChangedBegin & ~(size_t) 3;
+        for (; i < m_ChangedEnd; i += 4) {
+            uint32_t dirty;
+            std::memcpy(&dirty, &m_Dirty[i], sizeof(dirty));
+            if (!dirty) {
+                continue;
+            }
+            updated += (dirty & 0xff) + ((dirty >> 8) & 0xff) + ((dirty >> 16) & 0xff) + (dirty >> 24);
+            std::memset(&m_Dirty[i], 0, 4);
+#ifdef RG_TRANSFORMS_SSE2
+            composeBlock(i);
+#else
+            for (size_t j = i; j < i + 4; ++j) {
+                compose(j);
+            }
+#endif
+        }
+        m_DirtyBegin = m_Entities.size();
+        m_DirtyEnd = 0;
+        if (m_ChangedBegin >= m_ChangedEnd) {
+            m_ChangedBegin = m_ChangedEnd = 0;
+        }
+        return updated;
+    }
+
+    const glm::mat4& world(Entity entity) const {
+        return m_World[m_Index[entity]];
+    }
+
+    // world matrices in dense order, size() of them
+    const glm::mat4* worlds() const {
+        return m_World.data();
+    }
+
+    uint32_t index(Entity entity) const {
+        return m_Index[entity];
+    }
+
+    // dense index range [changedBegin, changedEnd) rewritten by the last update()
+    size_t changedBegin() const {
+        return m_ChangedBegin;
+    }
+
+    size_t changedEnd() const {
+        return m_ChangedEnd;
+    }
+
+private:
+    void markDirty(size_t i) {
+        m_Dirty[i] = 1;
+        m_DirtyBegin = std::min(m_DirtyBegin, i);
+        m_DirtyEnd = std::max(m_DirtyEnd, i + 1);
+    }
+
+    void write(size_t i, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+        m_PX[i] = position.x; m_PY[i] = position.y; m_PZ[i] = position.z;
+        m_QX[i] = rotation.x; m_QY[i] = rotation.y; m_QZ[i] = rotation.z; m_QW[i] = rotation.w;
+        m_SX[i] = scale.x; m_SY[i] = scale.y; m_SZ[i] = scale.z;
+        markDirty(i);
+    }
+
+    // arrays stay a multiple of four long so the block update never reads past them
+    void grow() {
+        size_t capacity = std::max<size_t>(16, m_Entities.size() * 2);
+        m_PX.resize(capacity, 0.0f); m_PY.resize(capacity, 0.0f); m_PZ.resize(capacity, 0.0f);
+        m_QX.resize(capacity, 0.0f); m_QY.resize(capacity, 0.0f); m_QZ.resize(capacity, 0.0f); m_QW.resize(capacity, 1.0f);
+        m_SX.resize(capacity, 1.0f); m_SY.resize(capacity, 1.0f); m_SZ.resize(capacity, 1.0f);
+        m_Dirty.resize(capacity, 0);
+        m_World.resize(capacity, glm::mat4(1.0f));
+        m_Entities.resize(capacity, InvalidEntity);
+    }
+
+    void compose(size_t i) {
+        const float x = m_QX[i], y = m_QY[i], z = m_QZ[i], w = m_QW[i];
+        const float x2 = x + x, y2 = y + y, z2 = z + z;
+        const float xx = x * x2, yy = y * y2, zz = z * z2;
+        const float xy = x * y2, xz = x * z2, yz = y * z2;
+        const float wx = w * x2, wy = w * y2, wz = w * z2;
+        float* m = &m_World[i][0][0];
+        // S * R scales the rows of the rotation
+        const float sx = m_SX[i], sy = m_SY[i], sz = m_SZ[i];
+        m[0] = (1.0f - (yy + zz)) * sx; m[1] = (xy + wz) * sy; m[2] = (xz - wy) * sz; m[3] = 0.0f;
+        m[4] = (xy - wz) * sx; m[5] = (1.0f - (xx + zz)) * sy; m[6] = (yz + wx) * sz; m[7] = 0.0f;
+        m[8] = (xz + wy) * sx; m[9] = (yz - wx) * sy; m[10] = (1.0f - (xx + yy)) * sz; m[11] = 0.0f;
+        m[12] = m_PX[i]; m[13] = m_PY[i]; m[14] = m_PZ[i]; m[15] = 1.0f;
+    }
+
+#ifdef RG_TRANSFORMS_SSE2
+    // same arithmetic as compose(), one lane per entity, transposed into four
+    // column-major matrices on the way out
+    void composeBlock(size_t i) {
+        const __m128 x = _mm_loadu_ps(&m_QX[i]), y = _mm_loadu_ps(&m_QY[i]);
+        const __m128 z = _mm_loadu_ps(&m_QZ[i]), w = _mm_loadu_ps(&m_QW[i]);
+        const __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+        const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+        const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        const __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+        const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+        const __m128 sx = _mm_loadu_ps(&m_SX[i]), sy = _mm_loadu_ps(&m_SY[i]), sz = _mm_loadu_ps(&m_SZ[i]);
+
+        __m128 columns[4][4] = {
+                { _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_add_ps(xy, wz), sy),
+                  _mm_mul_ps(_mm_sub_ps(xz, wy), sz), zero },
+                { _mm_mul_ps(_mm_sub_ps(xy, wz), sx), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+                  _mm_mul_ps(_mm_add_ps(yz, wx), sz), zero },
+                { _mm_mul_ps(_mm_add_ps(xz, wy), sx), _mm_mul_ps(_mm_sub_ps(yz, wx), sy),
+                  _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), zero },
+                { _mm_loadu_ps(&m_PX[i]), _mm_loadu_ps(&m_PY[i]), _mm_loadu_ps(&m_PZ[i]), one }
+        };
+        float* out = &m_World[i][0][0];
+        for (int c = 0; c < 4; ++c) {
+            // rows hold one matrix element for four entities, turn them into four columns
+            _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+            for (int e = 0; e < 4; ++e) {
+                _mm_storeu_ps(out + e * 16 + c * 4, columns[c][e]);
+            }
+        }
+    }
+#endif
+
+    std::vector<float> m_PX, m_PY, m_PZ;
+    std::vector<float> m_QX, m_QY, m_QZ, m_QW;
+    std::vector<float> m_SX, m_SY, m_SZ;
+    std::vector<uint8_t> m_Dirty;
+    std::vector<glm::mat4> m_World;
+    std::vector<Entity> m_Entities;  // dense index -> entity
+    std::vector<uint32_t> m_Index;   // entity -> dense index
+    std::vector<Entity> m_Free;
+    size_t m_Count = 0;
+    size_t m_DirtyBegin = 0;
+    size_t m_DirtyEnd = 0;
+    size_t m_ChangedBegin = 0;
+    size_t m_ChangedEnd = 0;
+};
+
+}
+
+#endif //PROJECT_BASE_TRANSFORMS_H
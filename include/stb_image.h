@@ -510,6 +510,10 @@ extern "C" {
     // flip the image vertically, so the first pixel in the output array is the bottom left
     STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+    // as above, but only applies to images loaded on the thread that calls the
+    // function (backported from stb_image 2.26, needs C++11 or C11 thread locals)
+    STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
+
     // ZLIB client - used by PNG, available for other purposes
 
     STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -1021,13 +1025,45 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp);
 static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp);
 #endif
 
-static int stbi__vertically_flip_on_load = 0;
+#ifndef STBI_THREAD_LOCAL
+   #if defined(__cplusplus) &&  __cplusplus >= 201103L
+      #define STBI_THREAD_LOCAL       thread_local
+   #elif defined(__GNUC__) && __GNUC__ < 5
+      #define STBI_THREAD_LOCAL       __thread
+   #elif defined(_MSC_VER)
+      #define STBI_THREAD_LOCAL       __declspec(thread)
+   #elif defined (__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STBI_THREAD_LOCAL       _Thread_local
+   #endif
+#endif
+
+static int stbi__vertically_flip_on_load_global = 0;
 
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 {
-    stbi__vertically_flip_on_load = flag_true_if_should_flip;
+    stbi__vertically_flip_on_load_global = flag_true_if_should_flip;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__vertically_flip_on_load  stbi__vertically_flip_on_load_global
+STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip)
+{
+    stbi__vertically_flip_on_load_global = flag_true_if_should_flip;
+}
+#else
+static STBI_THREAD_LOCAL int stbi__vertically_flip_on_load_local, stbi__vertically_flip_on_load_set;
+
+STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip)
+{
+    stbi__vertically_flip_on_load_local = flag_true_if_should_flip;
+    stbi__vertically_flip_on_load_set = 1;
 }
 
+#define stbi__vertically_flip_on_load  (stbi__vertically_flip_on_load_set       \
+                                         ? stbi__vertically_flip_on_load_local  \
+                                         : stbi__vertically_flip_on_load_global)
+#endif // STBI_THREAD_LOCAL
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
     memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1105,6 +1141,33 @@ static stbi__uint16 *stbi__convert_8_to_16(stbi_uc *orig, int w, int h, int chan
     return enlarged;
 }
 
+// swaps whole rows instead of single components; 16 bytes per step with SSE2
+static void stbi__vertical_flip(void *image, int w, int h, int bytes_per_pixel)
+{
+    int row;
+    size_t bytes_per_row = (size_t)w * bytes_per_pixel;
+    stbi_uc *bytes = (stbi_uc *)image;
+
+    for (row = 0; row < (h >> 1); row++) {
+        stbi_uc *row0 = bytes + row * bytes_per_row;
+        stbi_uc *row1 = bytes + (h - row - 1) * bytes_per_row;
+        size_t i = 0;
+#ifdef STBI_SSE2
+        for (; i + 16 <= bytes_per_row; i += 16) {
+            __m128i top = _mm_loadu_si128((__m128i *)(row0 + i));
+            __m128i bottom = _mm_loadu_si128((__m128i *)(row1 + i));
+            _mm_storeu_si128((__m128i *)(row0 + i), bottom);
+            _mm_storeu_si128((__m128i *)(row1 + i), top);
+        }
+#endif
+        for (; i < bytes_per_row; ++i) {
+            stbi_uc temp = row0[i];
+            row0[i] = row1[i];
+            row1[i] = temp;
+        }
+    }
+}
+
 static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
     stbi__result_info ri;
@@ -1122,21 +1185,8 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
     // @TODO: move stbi__convert_format to here
 
     if (stbi__vertically_flip_on_load) {
-        int w = *x, h = *y;
         int channels = req_comp ? req_comp : *comp;
-        int row, col, z;
-        stbi_uc *image = (stbi_uc *)result;
-
-        // @OPTIMIZE: use a bigger temp buffer and memcpy multiple pixels at once
-        for (row = 0; row < (h >> 1); row++) {
-            for (col = 0; col < w; col++) {
-                for (z = 0; z < channels; z++) {
-                    stbi_uc temp = image[(row * w + col) * channels + z];
-                    image[(row * w + col) * channels + z] = image[((h - row - 1) * w + col) * channels + z];
-                    image[((h - row - 1) * w + col) * channels + z] = temp;
-                }
-            }
-        }
+        stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
     }
 
     return (unsigned char *)result;
@@ -1160,21 +1210,8 @@ static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x,
     // @TODO: special case RGB-to-Y (and RGBA-to-YA) for 8-bit-to-16-bit case to keep more precision
 
     if (stbi__vertically_flip_on_load) {
-        int w = *x, h = *y;
         int channels = req_comp ? req_comp : *comp;
-        int row, col, z;
-        stbi__uint16 *image = (stbi__uint16 *)result;
-
-        // @OPTIMIZE: use a bigger temp buffer and memcpy multiple pixels at once
-        for (row = 0; row < (h >> 1); row++) {
-            for (col = 0; col < w; col++) {
-                for (z = 0; z < channels; z++) {
-                    stbi__uint16 temp = image[(row * w + col) * channels + z];
-                    image[(row * w + col) * channels + z] = image[((h - row - 1) * w + col) * channels + z];
-                    image[((h - row - 1) * w + col) * channels + z] = temp;
-                }
-            }
-        }
+        stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi__uint16));
     }
 
     return (stbi__uint16 *)result;
@@ -1184,21 +1221,8 @@ static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x,
 static void stbi__float_postprocess(float *result, int *x, int *y, int *comp, int req_comp)
 {
     if (stbi__vertically_flip_on_load && result != NULL) {
-        int w = *x, h = *y;
         int depth = req_comp ? req_comp : *comp;
-        int row, col, z;
-        float temp;
-
-        // @OPTIMIZE: use a bigger temp buffer and memcpy multiple pixels at once
-        for (row = 0; row < (h >> 1); row++) {
-            for (col = 0; col < w; col++) {
-                for (z = 0; z < depth; z++) {
-                    temp = result[(row * w + col) * depth + z];
-                    result[(row * w + col) * depth + z] = result[((h - row - 1) * w + col) * depth + z];
-                    result[((h - row - 1) * w + col) * depth + z] = temp;
-                }
-            }
-        }
+        stbi__vertical_flip(result, *x, *y, depth * sizeof(float));
     }
 }
 #endif
@@ -4303,6 +4327,94 @@ static int stbi__paeth(int a, int b, int c)
 static stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // create the png data from post-deflated data
+#ifdef STBI_SSE2
+// fixed-size copies so they compile to plain loads and stores
+static __m128i stbi__png_load_pixel(stbi_uc const *p, int n)
+{
+    int v = 0;
+    switch (n) {
+    case 2: memcpy(&v, p, 2); break;
+    case 3: v = p[0] | (p[1] << 8) | (p[2] << 16); break;
+    default: memcpy(&v, p, 4); break;
+    }
+    return _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), _mm_setzero_si128());
+}
+
+static void stbi__png_store_pixel(stbi_uc *p, __m128i v, int n)
+{
+    int r = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+    switch (n) {
+    case 2: memcpy(p, &r, 2); break;
+    case 3: p[0] = (stbi_uc)r; p[1] = (stbi_uc)(r >> 8); p[2] = (stbi_uc)(r >> 16); break;
+    default: memcpy(p, &r, 4); break;
+    }
+}
+
+static __m128i stbi__png_select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static __m128i stbi__png_abs16(__m128i v)
+{
+    return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+// Unfilters the rest of a scanline after the first pixel. "up" has no
+// dependency between bytes and runs 16 at a time for every depth; sub, avg and
+// paeth depend on the pixel to the left, so for 8-bit images with 2-4 bytes per
+// pixel they run a pixel at a time with the components in 16-bit lanes, which
+// removes the branches from the paeth predictor. Returns 0 for the cases it
+// leaves to the scalar code.
+static int stbi__png_unfilter_sse2(int filter, stbi_uc *cur, stbi_uc const *raw, stbi_uc const *prior, int nk, int n, int depth)
+{
+    __m128i a, c, mask;
+    int k = 0;
+
+    if (filter == STBI__F_up) {
+        for (; k + 16 <= nk; k += 16) {
+            __m128i x = _mm_loadu_si128((__m128i const *)(raw + k));
+            __m128i b = _mm_loadu_si128((__m128i const *)(prior + k));
+            _mm_storeu_si128((__m128i *)(cur + k), _mm_add_epi8(x, b));
+        }
+        for (; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+        return 1;
+    }
+    if (depth != 8 || n < 2 || n > 4 || (filter != STBI__F_sub && filter != STBI__F_avg && filter != STBI__F_paeth))
+        return 0;
+
+    // prior is only valid past the first row, where "sub" is the one filter left
+    a = stbi__png_load_pixel(cur - n, n);
+    c = filter == STBI__F_paeth ? stbi__png_load_pixel(prior - n, n) : _mm_setzero_si128();
+    mask = _mm_set1_epi16(0xff);
+    for (; k < nk; k += n) {
+        __m128i x = stbi__png_load_pixel(raw + k, n);
+        if (filter == STBI__F_sub) {
+            a = _mm_add_epi16(x, a);
+        }
+        else if (filter == STBI__F_avg) {
+            __m128i b = stbi__png_load_pixel(prior + k, n);
+            a = _mm_add_epi16(x, _mm_srli_epi16(_mm_add_epi16(a, b), 1));
+        }
+        else {
+            __m128i b = stbi__png_load_pixel(prior + k, n);
+            __m128i bc = _mm_sub_epi16(b, c), ac = _mm_sub_epi16(a, c);
+            __m128i pa = stbi__png_abs16(bc), pb = stbi__png_abs16(ac), pc = stbi__png_abs16(_mm_add_epi16(bc, ac));
+            __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            // ties prefer a, then b, like stbi__paeth
+            __m128i pred = stbi__png_select(_mm_cmpeq_epi16(smallest, pa), a,
+                                            stbi__png_select(_mm_cmpeq_epi16(smallest, pb), b, c));
+            c = b;
+            a = _mm_add_epi16(x, pred);
+        }
+        a = _mm_and_si128(a, mask);
+        stbi__png_store_pixel(cur + k, a, n);
+    }
+    return 1;
+}
+#endif
+
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
     int bytes = (depth == 16 ? 2 : 1);
@@ -4315,6 +4427,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
     int output_bytes = out_n*bytes;
     int filter_bytes = img_n*bytes;
     int width = x;
+#ifdef STBI_SSE2
+    int simd = stbi__sse2_available();
+#endif
 
     STBI_ASSERT(out_n == s->img_n || out_n == s->img_n + 1);
     a->out = (stbi_uc *)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4388,6 +4503,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
 #define STBI__CASE(f) \
              case f:     \
                 for (k=0; k < nk; ++k)
+#ifdef STBI_SSE2
+            if (!simd || !stbi__png_unfilter_sse2(filter, cur, raw, prior, nk, filter_bytes, depth))
+#endif
             switch (filter) {
                 // "none" filter turns into a memcpy here; make that explicit.
             case STBI__F_none:         memcpy(cur, raw, nk); break;
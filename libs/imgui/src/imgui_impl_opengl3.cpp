@@ -125,6 +125,12 @@ using namespace gl;
 #endif
 #endif
 
+// The application shadows its GL state in rg::GLState (IMGUI_IMPL_OPENGL_SHADOWED_STATE): state is backed up from the
+// shadow instead of queried, and set and restored through it so unchanged state never reaches the driver.
+#ifdef IMGUI_IMPL_OPENGL_SHADOWED_STATE
+#include <rg/GLState.h>
+#endif
+
 // Desktop GL 3.2+ has glDrawElementsBaseVertex() which GL ES and WebGL don't have.
 #if !defined(IMGUI_IMPL_OPENGL_ES2) && !defined(IMGUI_IMPL_OPENGL_ES3) && defined(GL_VERSION_3_2)
 #define IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
@@ -244,12 +250,22 @@ void    ImGui_ImplOpenGL3_NewFrame()
 static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_width, int fb_height, GLuint vertex_array_object)
 {
     // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled, polygon fill
+#ifdef IMGUI_IMPL_OPENGL_SHADOWED_STATE
+    rg::GLState& state = rg::GLState::instance();
+    state.enable(GL_BLEND);
+    state.blendEquation(GL_FUNC_ADD);
+    state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.disable(GL_CULL_FACE);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_SCISSOR_TEST);
+#else
     glEnable(GL_BLEND);
     glBlendEquation(GL_FUNC_ADD);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glDisable(GL_CULL_FACE);
     glDisable(GL_DEPTH_TEST);
     glEnable(GL_SCISSOR_TEST);
+#endif
 #ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_PRIMITIVE_RESTART
     if (g_GlVersion >= 310)
         glDisable(GL_PRIMITIVE_RESTART);
@@ -268,7 +284,11 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
 
     // Setup viewport, orthographic projection matrix
     // Our visible imgui space lies from draw_data->DisplayPos (top left) to draw_data->DisplayPos+data_data->DisplaySize (bottom right). DisplayPos is (0,0) for single viewport apps.
+#ifdef IMGUI_IMPL_OPENGL_SHADOWED_STATE
+    state.viewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
+#else
     glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
+#endif
     float L = draw_data->DisplayPos.x;
     float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
     float T = draw_data->DisplayPos.y;
@@ -281,7 +301,11 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
         { 0.0f,         0.0f,        -1.0f,   0.0f },
         { (R+L)/(L-R),  (T+B)/(B-T),  0.0f,   1.0f },
     };
+#ifdef IMGUI_IMPL_OPENGL_SHADOWED_STATE
+    state.useProgram(g_ShaderHandle);
+#else
     glUseProgram(g_ShaderHandle);
+#endif
     glUniform1i(g_AttribLocationTex, 0);
     glUniformMatrix4fv(g_AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
     
@@ -291,7 +315,9 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
 #endif
     
     (void)vertex_array_object;
-#ifndef IMGUI_IMPL_OPENGL_ES2
+#if defined(IMGUI_IMPL_OPENGL_SHADOWED_STATE)
+    state.bindVertexArray(vertex_array_object);
+#elif !defined(IMGUI_IMPL_OPENGL_ES2)
     glBindVertexArray(vertex_array_object);
 #endif
 
@@ -318,6 +344,13 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
         return;
 
     // Backup GL state
+#ifdef IMGUI_IMPL_OPENGL_SHADOWED_STATE
+    // taken from the shadow, no glGet round trips; sampler, polygon mode and GL_ARRAY_BUFFER are left as ImGui sets
+    // them since the application never changes them
+    rg::GLState& state = rg::GLState::instance();
+    const rg::GLState::Snapshot last_state = state.save();
+    state.activeTexture(0);
+#else
     GLenum last_active_texture; glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&last_active_texture);
     glActiveTexture(GL_TEXTURE0);
     GLuint last_program; glGetIntegerv(GL_CURRENT_PROGRAM, (GLint*)&last_program);
@@ -346,6 +379,7 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
     GLboolean last_enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
 #ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_PRIMITIVE_RESTART
     GLboolean last_enable_primitive_restart = (g_GlVersion >= 310) ? glIsEnabled(GL_PRIMITIVE_RESTART) : GL_FALSE;
+#endif
 #endif
 
     // Setup desired GL state
@@ -397,7 +431,11 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                     glScissor((int)clip_rect.x, (int)(fb_height - clip_rect.w), (int)(clip_rect.z - clip_rect.x), (int)(clip_rect.w - clip_rect.y));
 
                     // Bind texture, Draw
+#ifdef IMGUI_IMPL_OPENGL_SHADOWED_STATE
+                    state.bindTexture(0, GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
+#else
                     glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
+#endif
 #ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
                     if (g_GlVersion >= 320)
                         glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset);
@@ -409,6 +447,11 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
         }
     }
 
+#ifdef IMGUI_IMPL_OPENGL_SHADOWED_STATE
+    // Restore through the shadow first, so the temporary VAO is no longer bound when it is deleted
+    state.restore(last_state);
+    glDeleteVertexArrays(1, &vertex_array_object);
+#else
     // Destroy the temporary VAO
 #ifndef IMGUI_IMPL_OPENGL_ES2
     glDeleteVertexArrays(1, &vertex_array_object);
@@ -441,6 +484,7 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
 #endif
     glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
     glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+#endif
 }
 
 bool ImGui_ImplOpenGL3_CreateFontsTexture()
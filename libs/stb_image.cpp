@@ -1,2 +1,8 @@
 #define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
\ No newline at end of file
+#include "stb_image.h"
+
+// The JPEG IDCT, YCbCr conversion and PNG unfiltering all have SSE2 versions;
+// make sure a stray STBI_NO_SIMD or compiler flag never silently drops them.
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386) || defined(_M_IX86)) && !defined(STBI_SSE2)
+#error "stb_image built without SSE2, check for STBI_NO_SIMD or a missing -msse2"
+#endif
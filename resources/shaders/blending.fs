@@ -1,14 +1,21 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
 
 in vec2 TexCoords;
 
 uniform sampler2D texture1;
+// 0 alpha test, 1 alpha to coverage, 2 blended (rg::DrawBatcher::AlphaMode)
+uniform int alphaMode;
 
 void main()
 {
     vec4 texColor = texture(texture1, TexCoords);
-    if(texColor.a < 0.1)
+    if(alphaMode == 1)
+        texColor.a = clamp((texColor.a - 0.5) / max(fwidth(texColor.a), 0.0001) + 0.5, 0.0, 1.0);
+    else if(texColor.a < (alphaMode == 0 ? 0.1 : 0.01))
         discard;
     FragColor = texColor;
+    // unlit, nothing bright enough to bloom
+    BrightColor = vec4(0.0, 0.0, 0.0, texColor.a);
 }
\ No newline at end of file
@@ -11,6 +11,9 @@ layout (location = 1) out vec4 BrightColor;
        sampler2D diffuse;
        sampler2D specular;
        float shininess;
+ #ifdef ALPHA
+       sampler2D texture_opacity1;
+ #endif
    };
 
    struct DirLight {
@@ -59,9 +62,36 @@ layout (location = 1) out vec4 BrightColor;
      uniform Material material;
      uniform bool spot;
 
+     // cascaded shadow map of dirLight (rg::CascadedShadowMap), no shadows while cascadeCount is 0
+     uniform int cascadeCount;
+     uniform mat4 cascadeMatrices[4];
+     uniform float cascadeSplits[4];   // view depth where each cascade ends
+     uniform float cascadeTexels[4];   // world size of one texel of each cascade
+     uniform vec3 viewForward;
+     uniform sampler2DArrayShadow shadowStatic;
+     uniform sampler2DArrayShadow shadowDynamic;
+
+     // cube shadow maps of the point lights (rg::PointShadows), a range of 0 leaves the light without one
+     uniform samplerCubeShadow pointShadow1;
+     uniform samplerCubeShadow pointShadow2;
+     uniform float pointShadowRange1;
+     uniform float pointShadowRange2;
+
+     // half resolution ambient occlusion and view depth (rg::AmbientOcclusion), only darkens the ambient terms
+     uniform sampler2D ssao;
+     uniform bool ssaoEnabled;
+     float ao = 1.0;
+ #ifdef ALPHA
+     // meshes with an opacity map: 0 alpha test, 1 alpha to coverage, 2 blended (rg::DrawBatcher::AlphaMode)
+     uniform int alphaMode;
+ #endif
+
      // function prototypes
-     vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-     vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+     vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
+     float DirShadow(vec3 normal);
+     float PointShadow(samplerCubeShadow map, vec3 lightPosition, float range, vec3 normal);
+     float AmbientOcclusion();
+     vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow);
      vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
  void main()
@@ -69,6 +99,19 @@ layout (location = 1) out vec4 BrightColor;
 
   vec3 norm = normalize(Normal);
      vec3 viewDir = normalize(viewPos - FragPos);
+ #ifdef ALPHA
+     float alpha = texture(material.texture_opacity1, TexCoords).r;
+     if (alphaMode == 1)
+         // sharpened to an edge about a pixel wide at any mip level, the coverage mask does the rest
+         alpha = clamp((alpha - 0.5) / max(fwidth(alpha), 0.0001) + 0.5, 0.0, 1.0);
+     else if (alpha < (alphaMode == 0 ? 0.5 : 0.01))
+         discard;
+     // drawn two-sided, the back faces are lit from their side
+     if (!gl_FrontFacing)
+         norm = -norm;
+ #else
+     float alpha = 1.0;
+ #endif
 
      // == =====================================================
      // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
@@ -76,12 +119,16 @@ layout (location = 1) out vec4 BrightColor;
      // per lamp. In the main() function we take all the calculated colors and sum them up for
      // this fragment's final color.
      // == =====================================================
+     if (ssaoEnabled)
+         ao = AmbientOcclusion();
      // phase 1: directional lighting
-     vec3 result = CalcDirLight(dirLight, norm, viewDir);
+     vec3 result = CalcDirLight(dirLight, norm, viewDir, DirShadow(norm));
      // phase 2: point lights
     // for(int i = 0; i < NR_POINT_LIGHTS; i++)
-         result+= CalcPointLight(pointLight1, norm, FragPos, viewDir);
-         result += CalcPointLight(pointLight2, norm, FragPos, viewDir);
+         result+= CalcPointLight(pointLight1, norm, FragPos, viewDir,
+                                 PointShadow(pointShadow1, pointLight1.position, pointShadowRange1, norm));
+         result += CalcPointLight(pointLight2, norm, FragPos, viewDir,
+                                  PointShadow(pointShadow2, pointLight2.position, pointShadowRange2, norm));
      // phase 3: spot light
      if(spot)
      result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
@@ -90,13 +137,72 @@ layout (location = 1) out vec4 BrightColor;
 
          float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
          if(brightness > 1.0)
-             BrightColor = vec4(result, 1.0);
+             BrightColor = vec4(result, alpha);
          else
-             BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-         FragColor = vec4(result, 1.0);
+             BrightColor = vec4(0.0, 0.0, 0.0, alpha);
+         FragColor = vec4(result, alpha);
+ }
+
+ // The four half resolution texels around the fragment, weighted bilinearly
+ // and by how close their view depth is to the fragment's, so occlusion from
+ // one side of an edge does not bleed onto the other.
+ float AmbientOcclusion()
+ {
+     float depth = dot(FragPos - viewPos, viewForward);
+     vec2 position = gl_FragCoord.xy * 0.5 - 0.5;
+     vec2 base = floor(position);
+     vec2 f = position - base;
+     vec2 size = vec2(textureSize(ssao, 0));
+     float total = 0.0;
+     float weight = 0.0;
+     for (int i = 0; i < 4; ++i) {
+         vec2 offset = vec2(i & 1, i >> 1);
+         vec2 tap = texture(ssao, (base + offset + 0.5) / size).rg;
+         float bilinear = (offset.x > 0.5 ? f.x : 1.0 - f.x) * (offset.y > 0.5 ? f.y : 1.0 - f.y);
+         float w = (bilinear + 1e-3) / (1e-3 + abs(tap.g - depth));
+         total += tap.r * w;
+         weight += w;
+     }
+     return total / weight;
  }
 
- vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+ // share of the directional light that reaches the fragment, 3x3 PCF over both caster layers
+ float DirShadow(vec3 normal)
+ {
+     float depth = dot(FragPos - viewPos, viewForward);
+     if (cascadeCount == 0 || depth > cascadeSplits[cascadeCount - 1])
+         return 1.0;
+     int cascade = 0;
+     while (cascade < cascadeCount - 1 && depth > cascadeSplits[cascade])
+         cascade++;
+     // pushed off the surface by a texel or two against acne, more where the light grazes it
+     float grazing = 1.0 - max(dot(normal, normalize(-dirLight.direction)), 0.0);
+     vec3 position = FragPos + normal * cascadeTexels[cascade] * (0.5 + 1.5 * grazing);
+     vec3 coords = (cascadeMatrices[cascade] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+     if (coords.z > 1.0)
+         return 1.0;
+     vec2 texel = 1.0 / vec2(textureSize(shadowStatic, 0).xy);
+     float lit = 0.0;
+     for (int x = -1; x <= 1; x++)
+         for (int y = -1; y <= 1; y++) {
+             vec4 tap = vec4(coords.xy + vec2(x, y) * texel, float(cascade), coords.z);
+             lit += texture(shadowStatic, tap) * texture(shadowDynamic, tap);
+         }
+     return lit / 9.0;
+ }
+
+ // share of a point light that reaches the fragment, the cube map holds distances to the light over its range
+ float PointShadow(samplerCubeShadow map, vec3 lightPosition, float range, vec3 normal)
+ {
+     float distance = length(FragPos - lightPosition);
+     if (range <= 0.0 || distance >= range)
+         return 1.0;
+     // a texel of a 90 degree face spans about distance / 256 at 512 texels, pushed off by a texel and a half
+     vec3 fromLight = FragPos + normal * (0.006 * distance) - lightPosition;
+     return texture(map, vec4(fromLight, length(fromLight) / range - 0.001));
+ }
+
+ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
  {
 
      vec3 lightDir = normalize(-light.direction);
@@ -109,17 +215,17 @@ layout (location = 1) out vec4 BrightColor;
      float spec = pow(max(dot(normal, halfway), 0.0), material.shininess+32.0f);
 
 
-     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords).rgb);
+     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords).rgb) * ao;
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords).rgb);
     vec3 specular = light.specular * spec*vec3(texture(material.specular, TexCoords).rgb);
 
-    return diffuse+specular+ambient;
+    return (diffuse+specular)*shadow+ambient;
 
  }
 
 
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow)
 {
 
    vec3 lightDir = normalize(light.position - FragPos);
@@ -138,9 +244,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
      vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords).rgb);
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords).rgb);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords).rgb);
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
+    ambient *= attenuation * ao;
+    diffuse *= attenuation * shadow;
+    specular *= attenuation * shadow;
     return ( diffuse + specular+ambient);
 
 }
@@ -165,7 +271,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords).rgb);
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords).rgb);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords).rgb);
-    ambient *= attenuation * intensity;
+    ambient *= attenuation * intensity * ao;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
     return ( diffuse + specular+ambient);
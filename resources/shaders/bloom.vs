@@ -8,16 +8,32 @@ out vec3 Normal;
 out vec2 TexCoords;
 
 
+invariant gl_Position;
+
 uniform mat4 projection;
 uniform mat4 view;
+#ifdef DRAW_DATA
+// batched draws (rg::DrawBatcher): 8 texels per draw, model matrix then normal matrix
+layout (location = 5) in int aDrawID;
+uniform samplerBuffer drawData;
+#else
 uniform mat4 model;
+#endif
 
 void main()
 {
+#ifdef DRAW_DATA
+    int base = aDrawID * 8;
+    mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+                      texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    mat3 normalMatrix = mat3(texelFetch(drawData, base + 4).xyz, texelFetch(drawData, base + 5).xyz,
+                             texelFetch(drawData, base + 6).xyz);
+#else
+    mat3 normalMatrix = transpose(inverse(mat3(model)));
+#endif
   FragPos = vec3(model * vec4(aPos, 1.0));
    TexCoords = aTexCoords;
 
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
    Normal = normalize(normalMatrix * aNormal);
 
     gl_Position = projection * view * model * vec4(aPos, 1.0);
@@ -6,19 +6,20 @@ in vec2 TexCoords;
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 uniform bool bloom;
-uniform float exposure;
+uniform sampler2D exposure;   // 1 x 1, metered and adapted by rg::AutoExposure
+// tone curve, grading and gamma in one table (rg::ColorLut), indexed by sqrt(c / (c + 1))
+uniform sampler3D lut;
+uniform float lutScale;
+uniform float lutOffset;
 
 void main()
 {
-    const float gamma = 2.2;
     vec3 hdrColor = texture(scene, TexCoords).rgb;
     vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
     if(bloom)
         hdrColor += bloomColor; // additive blending
      //  hdrColor=bloomColor;
-    // tone mapping
-    vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
-    // also gamma correct while we're at it
-    result = pow(result, vec3(1.0 / gamma));
-    FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+    vec3 exposed = hdrColor * texelFetch(exposure, ivec2(0), 0).r;
+    vec3 shaped = sqrt(exposed / (exposed + 1.0));
+    FragColor = vec4(texture(lut, shaped * lutScale + lutOffset).rgb, 1.0);
+}
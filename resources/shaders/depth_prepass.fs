@@ -0,0 +1,18 @@
+#version 330 core
+// depth only, with bloom.vs, so the depth matches the lit pass exactly
+in vec2 TexCoords;
+
+#ifdef ALPHA
+struct Material {
+    sampler2D texture_opacity1;
+};
+uniform Material material;
+#endif
+
+void main()
+{
+#ifdef ALPHA
+    if (texture(material.texture_opacity1, TexCoords).r < 0.5)
+        discard;
+#endif
+}
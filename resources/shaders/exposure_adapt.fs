@@ -0,0 +1,47 @@
+#version 330 core
+// this frame's exposure from the histogram and last frame's (rg::AutoExposure)
+out float FragColor;
+
+uniform sampler2D histogram;
+uniform sampler2D previous;
+uniform int bins;
+uniform float minLog;
+uniform float maxLog;
+uniform float lowPercent;    // share of the weight below which bins do not count
+uniform float highPercent;   // and above which
+uniform float key;
+uniform float minExposure;
+uniform float maxExposure;
+uniform float adaptUp;       // share of the way to the target covered this frame
+uniform float adaptDown;
+
+void main()
+{
+    // bin 0 is black and everything below the range, the sky at night should not brighten the scene
+    float total = 0.0;
+    for (int i = 1; i < bins; ++i)
+        total += texelFetch(histogram, ivec2(i, 0), 0).r;
+    float low = total * lowPercent;
+    float high = total * highPercent;
+
+    float below = 0.0;
+    float sum = 0.0;
+    float weight = 0.0;
+    for (int i = 1; i < bins; ++i) {
+        float count = texelFetch(histogram, ivec2(i, 0), 0).r;
+        // the part of the bin's weight between the percentiles
+        float counted = max(min(below + count, high) - max(below, low), 0.0);
+        below += count;
+        sum += counted * (minLog + (maxLog - minLog) * float(i) / float(bins - 1));
+        weight += counted;
+    }
+    float last = texelFetch(previous, ivec2(0), 0).r;
+    if (weight <= 0.0) {
+        FragColor = last;
+        return;
+    }
+    float target = clamp(key / exp2(sum / weight), minExposure, maxExposure);
+    // adapted in stops, faster when the image got brighter and exposure has to fall
+    float rate = target < last ? adaptUp : adaptDown;
+    FragColor = exp2(mix(log2(last), log2(target), rate));
+}
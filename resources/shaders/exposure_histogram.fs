@@ -0,0 +1,9 @@
+#version 330 core
+out float FragColor;
+
+in float Weight;
+
+void main()
+{
+    FragColor = Weight;
+}
@@ -0,0 +1,21 @@
+#version 330 core
+// one point per luminance texel, into its bin of the 64 x 1 histogram (rg::AutoExposure)
+out float Weight;
+
+uniform sampler2D luminance;
+uniform float minLog;
+uniform float maxLog;
+uniform int bins;
+
+void main()
+{
+    ivec2 size = textureSize(luminance, 0);
+    ivec2 texel = ivec2(gl_VertexID % size.x, gl_VertexID / size.x);
+    float value = texelFetch(luminance, texel, 0).r;
+    // below the range lands in bin 0, which the average skips; above it in the last bin
+    float bin = floor(clamp((value - minLog) / (maxLog - minLog), 0.0, 1.0) * float(bins - 1) + 0.5);
+    // the center of the screen counts about three times as much as the corners
+    vec2 offset = (vec2(texel) + 0.5) / vec2(size) - 0.5;
+    Weight = 1.0 - length(offset);
+    gl_Position = vec4((bin + 0.5) / float(bins) * 2.0 - 1.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+// log2 luminance of the HDR image at an eighth of its size (rg::AutoExposure)
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+
+void main()
+{
+    // four bilinear taps spread over the 8x8 block, 16 of its texels
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec3 color = texture(scene, TexCoords + texel * vec2(-2.0, -2.0)).rgb
+               + texture(scene, TexCoords + texel * vec2(2.0, -2.0)).rgb
+               + texture(scene, TexCoords + texel * vec2(-2.0, 2.0)).rgb
+               + texture(scene, TexCoords + texel * vec2(2.0, 2.0)).rgb;
+    float luminance = dot(color * 0.25, vec3(0.2126, 0.7152, 0.0722));
+    FragColor = log2(max(luminance, 1.0e-5));
+}
@@ -0,0 +1,42 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in float Height;
+in float Tint;
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uniform DirLight dirLight;
+
+void main()
+{
+    // blades are two-sided; leaning the normal up rounds off the flat strip
+    vec3 normal = normalize(gl_FrontFacing ? Normal : -Normal);
+    normal = normalize(mix(normal, vec3(0.0, 1.0, 0.0), 0.4));
+
+    vec3 root = mix(vec3(0.05, 0.18, 0.03), vec3(0.09, 0.26, 0.05), Tint);
+    vec3 tip = mix(vec3(0.35, 0.50, 0.12), vec3(0.48, 0.56, 0.20), Tint);
+    vec3 albedo = mix(root, tip, Height);
+
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    // the blades shade each other toward the root
+    float occlusion = mix(0.4, 1.0, Height);
+    vec3 result = (dirLight.ambient * occlusion + dirLight.diffuse * diff) * albedo;
+
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    if(brightness > 1.0)
+        BrightColor = vec4(result, 1.0);
+    else
+        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 330 core
+layout (location = 0) in vec2 aStrip;   // side -1..1 across the blade, 0..1 from root to tip
+// per blade (rg::GrassBlade): root position and yaw, then height, width, wind phase and tint
+layout (location = 1) in vec4 aRoot;
+layout (location = 2) in vec4 aShape;
+
+out vec3 FragPos;
+out vec3 Normal;
+out float Height;
+out float Tint;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float time;
+uniform vec2 windDirection;
+uniform float windStrength;
+
+void main()
+{
+    float t = aStrip.y;
+    float height = aShape.x;
+    float c = cos(aRoot.w), s = sin(aRoot.w);
+    vec3 across = vec3(c, 0.0, -s);
+    vec3 facing = vec3(s, 0.0, c);
+
+    // a slow sway that travels over the field with the wind plus a faster flutter per blade
+    float sway = sin(time * 1.7 + aShape.z + dot(aRoot.xz, windDirection) * 0.35);
+    float flutter = sin(time * 4.3 + aShape.z * 3.0) * 0.15;
+    vec3 wind = vec3(windDirection.x, 0.0, windDirection.y) * windStrength * (0.6 + 0.4 * sway + flutter);
+    // every blade curves forward a little, the wind bends it further, both growing toward the tip
+    vec3 lean = facing * 0.25 + wind;
+    float bend = t * t;
+
+    vec3 position = aRoot.xyz + across * (aStrip.x * aShape.y * 0.5) + lean * (height * bend);
+    // a leaning blade keeps roughly its length
+    position.y += t * height * (1.0 - 0.5 * min(dot(lean, lean), 1.0) * bend);
+    vec3 tangent = vec3(0.0, height, 0.0) + lean * (height * 2.0 * t);
+    Normal = normalize(cross(across, tangent));
+
+    FragPos = position;
+    Height = t;
+    Tint = aShape.w;
+    gl_Position = projection * view * vec4(position, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in vec2 FrameUV0;
+in vec2 FrameUV1;
+in float FrameBlend;
+in vec3 FragPos;
+in float Yaw;
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uniform sampler2D albedo;
+uniform sampler2D normals;
+uniform DirLight dirLight;
+
+void main()
+{
+    vec4 color = mix(texture(albedo, FrameUV0), texture(albedo, FrameUV1), FrameBlend);
+    if(color.a < 0.5)
+        discard;
+    vec3 n = mix(texture(normals, FrameUV0).rgb, texture(normals, FrameUV1).rgb, FrameBlend) * 2.0 - 1.0;
+    // baked in model space, turned by the instance's rotation about the up axis
+    float c = cos(Yaw), s = sin(Yaw);
+    vec3 normal = normalize(vec3(c * n.x + s * n.z, n.y, -s * n.x + c * n.z));
+
+    // the directional light without the specular term, too small to matter this far away
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 result = (dirLight.ambient + dirLight.diffuse * diff) * color.rgb;
+
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    if(brightness > 1.0)
+        BrightColor = vec4(result, 1.0);
+    else
+        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,48 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+// per instance: bounding sphere center and radius, rotation about the up axis
+layout (location = 1) in vec4 aSphere;
+layout (location = 2) in float aYaw;
+
+out vec2 FrameUV0;
+out vec2 FrameUV1;
+out float FrameBlend;
+out vec3 FragPos;
+out float Yaw;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+uniform int columns;
+uniform int rows;
+
+const float PI = 3.14159265;
+
+void main()
+{
+    vec3 center = aSphere.xyz;
+    vec3 toEye = normalize(viewPos - center);
+    // the same basis lookAt gave the frame's camera when it was baked
+    vec3 right = abs(toEye.y) < 0.999 ? normalize(cross(vec3(0.0, 1.0, 0.0), toEye)) : vec3(1.0, 0.0, 0.0);
+    vec3 up = cross(toEye, right);
+    FragPos = center + (right * aCorner.x + up * aCorner.y) * aSphere.w;
+
+    // direction to the eye in the instance's frame picks the frames,
+    // columns are spaced evenly around +y starting on +z, rows over (-90, 90) degrees
+    float c = cos(-aYaw), s = sin(-aYaw);
+    vec3 local = vec3(c * toEye.x + s * toEye.z, toEye.y, -s * toEye.x + c * toEye.z);
+    float azimuth = atan(local.x, local.z);
+    float column = fract(azimuth / (2.0 * PI)) * float(columns);
+    float elevation = asin(clamp(local.y, -1.0, 1.0));
+    float row = clamp(floor((elevation / PI + 0.5) * float(rows)), 0.0, float(rows - 1));
+    float column0 = floor(column);
+    float column1 = mod(column0 + 1.0, float(columns));
+    FrameBlend = column - column0;
+
+    vec2 uv = aCorner * 0.5 + 0.5;
+    vec2 frameSize = vec2(1.0 / float(columns), 1.0 / float(rows));
+    FrameUV0 = (vec2(column0, row) + uv) * frameSize;
+    FrameUV1 = (vec2(column1, row) + uv) * frameSize;
+    Yaw = aYaw;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalOut;
+
+in vec3 Normal;
+in vec2 TexCoords;
+
+struct Material {
+    sampler2D texture_diffuse1;
+};
+
+uniform Material material;
+
+void main()
+{
+    vec4 color = texture(material.texture_diffuse1, TexCoords);
+    if(color.a < 0.5)
+        discard;
+    // alpha is coverage
+    Albedo = vec4(color.rgb, 1.0);
+    NormalOut = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+in vec3 FragPos;
+in vec2 TexCoords;
+
+uniform vec3 lightPosition;
+uniform float range;
+#ifdef ALPHA
+// cut-outs cast the shadow of what stays after the alpha test
+struct Material {
+    sampler2D texture_opacity1;
+};
+uniform Material material;
+#endif
+
+void main()
+{
+#ifdef ALPHA
+    if (texture(material.texture_opacity1, TexCoords).r < 0.5)
+        discard;
+#endif
+    // the distance to the light over its range, what bloom.fs compares against
+    gl_FragDepth = length(FragPos - lightPosition) / range;
+}
@@ -0,0 +1,43 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+in vec3 WorldPos[];
+in vec2 WorldTexCoords[];
+
+out vec3 FragPos;
+out vec2 TexCoords;
+
+// the faces of the cube map this pass redraws (rg::PointShadowPass)
+uniform mat4 faceMatrices[6];
+uniform int faces[6];
+uniform int faceCount;
+
+// true when all three vertices are beyond the same side of the clip volume
+bool outside(vec4 a, vec4 b, vec4 c)
+{
+    vec3 above = step(vec3(a.w), a.xyz) * step(vec3(b.w), b.xyz) * step(vec3(c.w), c.xyz);
+    vec3 below = step(a.xyz, vec3(-a.w)) * step(b.xyz, vec3(-b.w)) * step(c.xyz, vec3(-c.w));
+    return any(greaterThan(above + below, vec3(0.0)));
+}
+
+void main()
+{
+    for (int i = 0; i < faceCount; ++i) {
+        int face = faces[i];
+        vec4 clip[3];
+        for (int v = 0; v < 3; ++v)
+            clip[v] = faceMatrices[face] * vec4(WorldPos[v], 1.0);
+        // triangles the face does not see are not emitted into it
+        if (outside(clip[0], clip[1], clip[2]))
+            continue;
+        gl_Layer = face;
+        for (int v = 0; v < 3; ++v) {
+            FragPos = WorldPos[v];
+            TexCoords = WorldTexCoords[v];
+            gl_Position = clip[v];
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
@@ -0,0 +1,35 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoords;
+// batched draws (rg::DrawBatcher): 8 texels per draw, the model matrix first
+layout (location = 5) in int aDrawID;
+
+uniform samplerBuffer drawData;
+#ifdef LAYERED
+// point_shadow.gs projects every triangle into the faces of the pass
+out vec3 WorldPos;
+out vec2 WorldTexCoords;
+#else
+out vec3 FragPos;
+out vec2 TexCoords;
+// the one face drawn (rg::PointShadowPass)
+uniform mat4 faceMatrices[6];
+uniform int faces[6];
+#endif
+
+void main()
+{
+    int base = aDrawID * 8;
+    mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+                      texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    vec4 world = model * vec4(aPos, 1.0);
+#ifdef LAYERED
+    WorldPos = world.xyz;
+    WorldTexCoords = aTexCoords;
+    gl_Position = world;
+#else
+    FragPos = world.xyz;
+    TexCoords = aTexCoords;
+    gl_Position = faceMatrices[faces[0]] * world;
+#endif
+}
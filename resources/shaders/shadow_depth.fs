@@ -0,0 +1,18 @@
+#version 330 core
+in vec2 TexCoords;
+
+#ifdef ALPHA
+// cut-outs cast the shadow of what stays after the alpha test
+struct Material {
+    sampler2D texture_opacity1;
+};
+uniform Material material;
+#endif
+
+void main()
+{
+#ifdef ALPHA
+    if (texture(material.texture_opacity1, TexCoords).r < 0.5)
+        discard;
+#endif
+}
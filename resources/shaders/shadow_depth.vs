@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoords;
+// batched draws (rg::DrawBatcher): 8 texels per draw, the model matrix first
+layout (location = 5) in int aDrawID;
+
+out vec2 TexCoords;
+
+uniform samplerBuffer drawData;
+// the cascade being drawn, world to the light's clip space (rg::ShadowCascade)
+uniform mat4 lightSpace;
+
+void main()
+{
+    int base = aDrawID * 8;
+    mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+                      texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    TexCoords = aTexCoords;
+    gl_Position = lightSpace * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,52 @@
+#version 330 core
+// occlusion and view depth, at half resolution (rg::AmbientOcclusion)
+out vec2 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D depth;   // the scene's depth, full resolution
+uniform sampler2D noise;   // 4x4 rotations in the tangent plane, tiled over the screen
+uniform vec2 noiseScale;
+uniform mat4 projection;
+uniform mat4 inverseProjection;
+uniform vec3 samples[32];  // hemisphere kernel around +z
+uniform int sampleCount;
+uniform float radius;
+
+vec3 viewPosition(vec2 uv)
+{
+    vec4 position = inverseProjection * vec4(uv * 2.0 - 1.0, texture(depth, uv).r * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+void main()
+{
+    if (texture(depth, TexCoords).r >= 1.0) {
+        // sky, nothing to occlude
+        FragColor = vec2(1.0, 1.0e4);
+        return;
+    }
+    vec3 position = viewPosition(TexCoords);
+    // the normal from the neighbour with the smaller step on each axis, so silhouettes do not bend it
+    vec2 texel = 1.0 / vec2(textureSize(depth, 0));
+    vec3 right = viewPosition(TexCoords + vec2(texel.x, 0.0)) - position;
+    vec3 left = position - viewPosition(TexCoords - vec2(texel.x, 0.0));
+    vec3 up = viewPosition(TexCoords + vec2(0.0, texel.y)) - position;
+    vec3 down = position - viewPosition(TexCoords - vec2(0.0, texel.y));
+    vec3 normal = normalize(cross(abs(right.z) < abs(left.z) ? right : left, abs(up.z) < abs(down.z) ? up : down));
+
+    vec3 rotation = vec3(texture(noise, TexCoords * noiseScale).xy, 0.0);
+    vec3 tangent = normalize(rotation - normal * dot(rotation, normal));
+    mat3 TBN = mat3(tangent, cross(normal, tangent), normal);
+
+    float occlusion = 0.0;
+    for (int i = 0; i < sampleCount; ++i) {
+        vec3 sample = position + TBN * samples[i] * radius;
+        vec4 projected = projection * vec4(sample, 1.0);
+        float sceneDepth = viewPosition(projected.xy / projected.w * 0.5 + 0.5).z;
+        // occluders much further away than the radius do not count
+        float range = smoothstep(0.0, 1.0, radius / abs(position.z - sceneDepth));
+        occlusion += (sceneDepth >= sample.z + 0.02 ? 1.0 : 0.0) * range;
+    }
+    FragColor = vec2(1.0 - occlusion / float(sampleCount), -position.z);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+// one direction of the separable blur of rg::AmbientOcclusion, view depth passes through
+out vec2 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D image;    // occlusion and view depth
+uniform vec2 direction;     // one texel along the blur
+uniform int blurRadius;
+
+void main()
+{
+    vec2 center = texture(image, TexCoords).rg;
+    float sigma = float(blurRadius) * 0.5 + 0.5;
+    float total = center.r;
+    float weight = 1.0;
+    for (int i = -blurRadius; i <= blurRadius; ++i) {
+        if (i == 0)
+            continue;
+        vec2 tap = texture(image, TexCoords + direction * float(i)).rg;
+        // gaussian in distance, and texels more than a few percent nearer or further fall off fast
+        float w = exp(-float(i * i) / (2.0 * sigma * sigma)) * exp(-abs(tap.g - center.g) / (0.02 * center.g + 0.01));
+        total += tap.r * w;
+        weight += w;
+    }
+    FragColor = vec2(total / weight, center.g);
+}
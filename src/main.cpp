@@ -15,8 +15,22 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <rg/AutoExposure.h>
+#include <rg/CascadedShadowMap.h>
+#include <rg/ColorLut.h>
+#include <rg/Cubemap.h>
+#include <rg/GLState.h>
+#include <rg/Grass.h>
+#include <rg/Impostor.h>
+#include <rg/PointShadows.h>
+#include <rg/RenderQueue.h>
+#include <rg/Scene.h>
+#include <rg/Ssao.h>
+#include <rg/Transforms.h>
+#include <rg/ShaderWatcher.h>
 
 #include <iostream>
+#include <memory>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -29,13 +43,13 @@ void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
 void renderQuad();
-void renderCube();
+unsigned int cubeVertexArray();
 
 unsigned int loadTexture(char const * path, bool gammaCorrection);
 
 unsigned int loadTexture(const char *path);
 
-unsigned int loadCubemap(vector<std::string> faces);
+unsigned int loadCubemap(vector<std::string> faces, const rg::CubemapParams& params = rg::CubemapParams());
 
 // settings
 const unsigned int SCR_WIDTH = 1000;
@@ -100,12 +114,40 @@ struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
     Camera camera;
-    glm::vec3 islandPosition;
     bool CameraMouseMovementUpdateEnabled = true;
     bool spotlight=true;
     bool bloom = true;
 
-    float exposure =0.5;
+    // stops added to the metered exposure, Q and E
+    float exposureCompensation = 0.0f;
+    // baked into the tone mapping table whenever it changes
+    rg::GradingSettings grading;
+
+    // last frame's model batches, queue and redundant binds, shown in the ImGui window, not saved
+    rg::DrawBatcher::Stats batchStats;
+    rg::RenderQueue::Stats queueStats;
+    rg::GLState::Counters glCounters;
+    bool validateGLState = false;
+    // largest error in pixels a model's level of detail may show, 0 draws everything at full detail
+    float lodPixelError = 1.0f;
+    // far instances of models with an impostor in the scene are drawn as baked quads
+    bool impostors = true;
+    rg::ImpostorRenderer::Stats impostorStats;
+    bool grass = true;
+    float windStrength = 0.3f;
+    rg::GrassRenderer::Stats grassStats;
+    // directional light shadows, static casters cached per cascade
+    bool shadows = true;
+    rg::CascadedShadowMap::Stats shadowStats;
+    // point light cube shadows, a budget of faces redrawn per frame
+    bool pointShadows = true;
+    bool layeredPointShadows = true;
+    int pointShadowBudget = 4;
+    rg::PointShadows::Stats pointShadowStats;
+    // how meshes with an opacity map and the billboards draw, a rg::DrawBatcher::AlphaMode
+    int alphaMode = rg::DrawBatcher::AlphaTest;
+    // ambient occlusion: 0 off, 1 performance, 2 quality (rg::AmbientOcclusion::Preset + 1)
+    int ssao = 1;
 
     //Light pointLights[2];
     ProgramState()
@@ -130,7 +172,7 @@ void ProgramState::SaveToFile(std::string filename) {
         << camera.Front.y << '\n'
         << camera.Front.z << '\n'
         << bloom << '\n'
-        << exposure << '\n';
+        << exposureCompensation << '\n';
 }
 
 void ProgramState::LoadFromFile(std::string filename) {
@@ -148,7 +190,7 @@ void ProgramState::LoadFromFile(std::string filename) {
            >> camera.Front.y
            >> camera.Front.z
            >> bloom
-           >> exposure;
+           >> exposureCompensation;
     }
 }
 
@@ -163,6 +205,10 @@ int main() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef RG_GL_DEBUG
+    // without a debug context most drivers report little beyond errors
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -190,6 +236,11 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+#ifdef RG_GL_DEBUG
+    // GL errors and warnings arrive through the KHR_debug callback, GLCALL polls glGetError only without it
+    if (!rg::installDebugOutput(GL_DEBUG_SEVERITY_MEDIUM))
+        std::cout << "GL_KHR_debug unavailable, GLCALL checks glGetError after each call" << std::endl;
+#endif
 
 
     programState = new ProgramState;
@@ -210,41 +261,126 @@ int main() {
     // configure global opengl state
     // -----------------------------
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_FRONT);
-    glFrontFace(GL_CW);
+    // all state changes go through the shadow, which drops the ones that change nothing
+    rg::GLState& glState = rg::GLState::instance();
+    glState.enable(GL_DEPTH_TEST);
+    glState.depthFunc(GL_LESS);
+    glState.enable(GL_CULL_FACE);
+    glState.cullFace(GL_FRONT);
+    glState.frontFace(GL_CW);
 
 
     // build and compile shaders
     // ----------------------
+    // linked programs are cached on disk, only the first run (or a changed shader/driver) compiles from source
+    double shaderStartTime = glfwGetTime();
 
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
-    Shader shader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
+    Shader shader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs", nullptr, "#define DRAW_DATA\n");
+    // meshes with an opacity map, kept apart so the opaque program never discards
+    Shader shaderAlpha("resources/shaders/bloom.vs", "resources/shaders/bloom.fs", nullptr, "#define DRAW_DATA\n#define ALPHA\n");
     Shader shaderLight("resources/shaders/bloom.vs", "resources/shaders/lb.fs");
      Shader shaderBlur("resources/shaders/blur.vs", "resources/shaders/blur.fs");
      Shader shaderBloomFinal("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs");
     Shader shaderBlending("resources/shaders/blending.vs", "resources/shaders/blending.fs");
-
-
-
-         Model islan("resources/objects/islan/Small_Tropical_Island.obj");
-          islan.SetShaderTextureNamePrefix("material.");
-
-         Model heli("resources/objects/heli/ah64d.obj");
-          heli.SetShaderTextureNamePrefix("material.");
+    Shader shaderImpostor("resources/shaders/impostor.vs", "resources/shaders/impostor.fs");
+    Shader shaderImpostorBake("resources/shaders/impostor_bake.vs", "resources/shaders/impostor_bake.fs");
+    Shader shaderGrass("resources/shaders/grass.vs", "resources/shaders/grass.fs");
+    Shader shaderShadow("resources/shaders/shadow_depth.vs", "resources/shaders/shadow_depth.fs");
+    Shader shaderShadowAlpha("resources/shaders/shadow_depth.vs", "resources/shaders/shadow_depth.fs", nullptr, "#define ALPHA\n");
+    // point light cube maps, all redrawn faces of a light in one pass through the geometry shader or one pass per face
+    Shader shaderPointShadow("resources/shaders/point_shadow.vs", "resources/shaders/point_shadow.fs",
+                             "resources/shaders/point_shadow.gs", "#define LAYERED\n");
+    Shader shaderPointShadowAlpha("resources/shaders/point_shadow.vs", "resources/shaders/point_shadow.fs",
+                                  "resources/shaders/point_shadow.gs", "#define LAYERED\n#define ALPHA\n");
+    Shader shaderPointShadowFace("resources/shaders/point_shadow.vs", "resources/shaders/point_shadow.fs");
+    Shader shaderPointShadowFaceAlpha("resources/shaders/point_shadow.vs", "resources/shaders/point_shadow.fs", nullptr,
+                                      "#define ALPHA\n");
+    Shader shaderPrepass("resources/shaders/bloom.vs", "resources/shaders/depth_prepass.fs", nullptr, "#define DRAW_DATA\n");
+    Shader shaderPrepassAlpha("resources/shaders/bloom.vs", "resources/shaders/depth_prepass.fs", nullptr,
+                              "#define DRAW_DATA\n#define ALPHA\n");
+    Shader shaderSsao("resources/shaders/blur.vs", "resources/shaders/ssao.fs");
+    Shader shaderSsaoBlur("resources/shaders/blur.vs", "resources/shaders/ssao_blur.fs");
+    Shader shaderLuminance("resources/shaders/blur.vs", "resources/shaders/exposure_luminance.fs");
+    Shader shaderHistogram("resources/shaders/exposure_histogram.vs", "resources/shaders/exposure_histogram.fs");
+    Shader shaderAdapt("resources/shaders/blur.vs", "resources/shaders/exposure_adapt.fs");
+
+    rg::ProgramCache& programCache = rg::ProgramCache::instance();
+    std::cout << "Shaders ready in " << (glfwGetTime() - shaderStartTime) * 1000.0 << " ms ("
+              << programCache.hits << " from cache, " << programCache.misses << " compiled"
+              << (programCache.available() ? "" : ", program binaries unsupported") << ")" << std::endl;
+
+    // edits to resources/shaders are recompiled in the background and swapped in while running
+    rg::ShaderWatcher shaderWatcher("resources/shaders");
+    shaderWatcher.add(skyboxShader);
+    shaderWatcher.add(shader);
+    shaderWatcher.add(shaderAlpha);
+    shaderWatcher.add(shaderLight);
+    shaderWatcher.add(shaderBlur);
+    shaderWatcher.add(shaderBloomFinal);
+    shaderWatcher.add(shaderBlending);
+    shaderWatcher.add(shaderImpostor);
+    shaderWatcher.add(shaderImpostorBake);
+    shaderWatcher.add(shaderGrass);
+    shaderWatcher.add(shaderShadow);
+    shaderWatcher.add(shaderShadowAlpha);
+    shaderWatcher.add(shaderPointShadow);
+    shaderWatcher.add(shaderPointShadowAlpha);
+    shaderWatcher.add(shaderPointShadowFace);
+    shaderWatcher.add(shaderPointShadowFaceAlpha);
+    shaderWatcher.add(shaderPrepass);
+    shaderWatcher.add(shaderPrepassAlpha);
+    shaderWatcher.add(shaderSsao);
+    shaderWatcher.add(shaderSsaoBlur);
+    shaderWatcher.add(shaderLuminance);
+    shaderWatcher.add(shaderHistogram);
+    shaderWatcher.add(shaderAdapt);
+
+
+
+          rg::Scene scene;
+          if (!rg::loadScene(FileSystem::getPath("resources/scene.json"), scene)) {
+              glfwTerminate();
+              return -1;
+          }
+          std::vector<std::unique_ptr<Model>> models;
+          for (const rg::SceneModel& sceneModel : scene.models) {
+              models.emplace_back(new Model(FileSystem::getPath(sceneModel.path)));
+              models.back()->SetShaderTextureNamePrefix(sceneModel.texturePrefix);
+          }
+          std::unique_ptr<rg::DrawBatcher> batcher(new rg::DrawBatcher);
+          // far instances of the models that have an impostor, -1 for the others
+          std::unique_ptr<rg::ImpostorRenderer> impostors(new rg::ImpostorRenderer);
+          std::vector<int> impostorKinds;
+          for (unsigned int i = 0; i < scene.models.size(); i++) {
+              const rg::SceneModel& sceneModel = scene.models[i];
+              impostorKinds.push_back(sceneModel.impostorDistance > 0.0f
+                                      ? (int) impostors->add(*models[i], sceneModel.impostorDistance,
+                                                             sceneModel.impostorColumns, sceneModel.impostorRows)
+                                      : -1);
+          }
+          // billboards, light markers and the skybox, sorted into passes every frame
+          rg::RenderQueue renderQueue;
+          // node spins resolved to node indices, -1 where the model has no such node
+          std::vector<int> spinNodes;
+          for (const rg::SceneNodeSpin& spin : scene.nodeSpins) {
+              spinNodes.push_back(models[spin.model]->FindNode(spin.node));
+              if (spinNodes.back() < 0) {
+                  std::cout << "Scene: model " << scene.models[spin.model].name << " has no node " << spin.node << std::endl;
+              }
+          }
 
 
           unsigned int hdrFBO;
           glGenFramebuffers(1, &hdrFBO);
-          glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+          glState.bindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+          GLLABEL(GL_FRAMEBUFFER, hdrFBO, "HDR scene");
           // create 2 floating point color buffers (1 for normal rendering, other for brightness threshold values)
           unsigned int colorBuffers[2];
           glGenTextures(2, colorBuffers);
           for (unsigned int i = 0; i < 2; i++)
           {
-              glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
+              glState.bindTexture(0, GL_TEXTURE_2D, colorBuffers[i]);
               glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
               glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
               glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -252,20 +388,57 @@ int main() {
               glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
               // attach texture to framebuffer
               glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
+              GLLABEL(GL_TEXTURE, colorBuffers[i], i == 0 ? "HDR color" : "HDR bright");
           }
-          // create and attach depth buffer (renderbuffer)
-          unsigned int rboDepth;
-          glGenRenderbuffers(1, &rboDepth);
-          glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-          glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-          glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+          // create and attach depth buffer, a texture so ambient occlusion can read the depth prepass
+          unsigned int depthTexture;
+          glGenTextures(1, &depthTexture);
+          glState.bindTexture(0, GL_TEXTURE_2D, depthTexture);
+          glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+          glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+          GLLABEL(GL_TEXTURE, depthTexture, "HDR depth");
           // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
           unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
           glDrawBuffers(2, attachments);
           // finally check if framebuffer is complete
           if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
               std::cout << "Framebuffer not complete!" << std::endl;
-          glBindFramebuffer(GL_FRAMEBUFFER, 0);
+          glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+          // multisampled twin of the HDR framebuffer, the scene renders here when alpha to coverage is on
+          // and is resolved into hdrFBO before the blur
+          GLint maxSamples = 0;
+          glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+          const GLsizei msaaSamples = std::min(4, (int) maxSamples);
+          unsigned int msaaFBO = 0;
+          unsigned int msaaBuffers[3] = { 0, 0, 0 };
+          if (msaaSamples > 1) {
+              glGenFramebuffers(1, &msaaFBO);
+              glState.bindFramebuffer(GL_FRAMEBUFFER, msaaFBO);
+              GLLABEL(GL_FRAMEBUFFER, msaaFBO, "HDR scene MSAA");
+              glGenRenderbuffers(3, msaaBuffers);
+              for (unsigned int i = 0; i < 3; i++) {
+                  glBindRenderbuffer(GL_RENDERBUFFER, msaaBuffers[i]);
+                  glRenderbufferStorageMultisample(GL_RENDERBUFFER, msaaSamples, i < 2 ? GL_RGBA16F : GL_DEPTH_COMPONENT24,
+                                                   SCR_WIDTH, SCR_HEIGHT);
+                  glFramebufferRenderbuffer(GL_FRAMEBUFFER, i < 2 ? GL_COLOR_ATTACHMENT0 + i : GL_DEPTH_ATTACHMENT,
+                                            GL_RENDERBUFFER, msaaBuffers[i]);
+              }
+              glDrawBuffers(2, attachments);
+              if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                  std::cout << "MSAA framebuffer not complete, alpha to coverage falls back to alpha testing" << std::endl;
+                  glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+                  glState.forgetFramebuffer(msaaFBO);
+                  glDeleteFramebuffers(1, &msaaFBO);
+                  glDeleteRenderbuffers(3, msaaBuffers);
+                  msaaFBO = 0;
+              }
+              glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+          }
 
           // ping-pong-framebuffer for blurring
           unsigned int pingpongFBO[2];
@@ -274,14 +447,16 @@ int main() {
           glGenTextures(2, pingpongColorbuffers);
           for (unsigned int i = 0; i < 2; i++)
           {
-              glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-              glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
+              glState.bindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
+              glState.bindTexture(0, GL_TEXTURE_2D, pingpongColorbuffers[i]);
               glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
               glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
               glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
               glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
               glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
               glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
+              GLLABEL(GL_FRAMEBUFFER, pingpongFBO[i], i == 0 ? "blur ping" : "blur pong");
+              GLLABEL(GL_TEXTURE, pingpongColorbuffers[i], i == 0 ? "blur ping" : "blur pong");
               // also check if framebuffers are complete (no need for depth buffer)
               if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
                   std::cout << "Framebuffer not complete!" << std::endl;
@@ -300,26 +475,98 @@ int main() {
     unsigned int transparentVAO, transparentVBO;
     glGenVertexArrays(1, &transparentVAO);
     glGenBuffers(1, &transparentVBO);
-    glBindVertexArray(transparentVAO);
+    glState.bindVertexArray(transparentVAO);
     glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)nullptr);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
-    unsigned int transparentTexture=0;
-    GLCALL(transparentTexture = loadTexture(FileSystem::getPath("resources/textures/grass.png").c_str()));
-
-    vector<glm::vec3> vegetation
-            {
-                   // glm::vec3(6.77f, 1.0f, 4.11f),
-                    glm::vec3(8.44f, 1.0f, 5.53f),
-                    glm::vec3(11.72f, 1.82f, 4.85f),
-                    glm::vec3(7.17f,0.60f,1.90f),
-                    glm::vec3(0)
-
-            };
+    glState.bindVertexArray(0);
+    std::vector<unsigned int> materialTextures;
+    for (const rg::SceneMaterial& material : scene.materials) {
+        materialTextures.push_back(loadTexture(FileSystem::getPath(material.diffuse).c_str()));
+    }
+
+    // instances and billboards share one transform store, only the orbiting
+    // and spinning ones are written each frame
+    rg::TransformStore transforms;
+    std::vector<std::pair<rg::Entity, const rg::SceneInstance*>> animated;
+    auto spawn = [&transforms, &animated](const rg::SceneInstance& instance) {
+        rg::Entity entity = transforms.create(rg::instancePosition(instance, 0.0f), rg::instanceRotation(instance, 0.0f),
+                                              instance.scale);
+        if ((instance.flags & rg::SceneOrbiting) || instance.spin != 0.0f) {
+            animated.emplace_back(entity, &instance);
+        }
+        return entity;
+    };
+    std::vector<rg::Entity> instanceEntities, billboardEntities;
+    for (const rg::SceneInstance& instance : scene.instances) {
+        instanceEntities.push_back(spawn(instance));
+    }
+    for (const rg::SceneInstance& billboard : scene.billboards) {
+        billboardEntities.push_back(spawn(billboard));
+    }
+
+    // grass is scattered once over the first instance of its model and drawn from a static buffer
+    rg::GrassField grassField;
+    std::unique_ptr<rg::GrassRenderer> grass;
+    for (unsigned int i = 0; i < scene.instances.size() && scene.grass.model >= 0; i++) {
+        if ((int) scene.instances[i].index != scene.grass.model)
+            continue;
+        double grassStartTime = glfwGetTime();
+        transforms.update();
+        std::vector<glm::vec3> triangles;
+        rg::collectTriangles(*models[scene.grass.model], transforms.world(instanceEntities[i]), triangles);
+        rg::DensityMap density;
+        if (!scene.grass.density.empty())
+            density = rg::loadDensityMap(FileSystem::getPath(scene.grass.density));
+        rg::GrassSettings settings;
+        settings.blades = scene.grass.blades;
+        settings.chunkSize = scene.grass.chunkSize;
+        settings.minHeight = scene.grass.height.x;
+        settings.maxHeight = scene.grass.height.y;
+        settings.width = scene.grass.width;
+        settings.minUp = scene.grass.minUp;
+        grassField.scatter(triangles, density, settings);
+        if (!grassField.blades().empty())
+            grass.reset(new rg::GrassRenderer(grassField));
+        std::cout << "Grass: " << grassField.blades().size() << " blades in " << grassField.chunks().size()
+                  << " chunks, scattered in " << (glfwGetTime() - grassStartTime) * 1000.0 << " ms" << std::endl;
+        break;
+    }
+
+    // Instances that move or have spinning nodes cast into the dynamic shadow layer, the rest into the
+    // cached static one. The casters' bounds take in every instance with the whole of its orbit.
+    std::vector<bool> dynamicCasters;
+    glm::vec3 casterMin(FLT_MAX), casterMax(-FLT_MAX);
+    transforms.update();
+    for (unsigned int i = 0; i < scene.instances.size(); i++) {
+        const rg::SceneInstance& instance = scene.instances[i];
+        bool dynamic = (instance.flags & rg::SceneOrbiting) || instance.spin != 0.0f;
+        for (const rg::SceneNodeSpin& spin : scene.nodeSpins)
+            dynamic = dynamic || spin.model == instance.index;
+        dynamicCasters.push_back(dynamic);
+        const Model& caster = *models[instance.index];
+        const glm::mat4& world = transforms.world(instanceEntities[i]);
+        float radius = caster.boundsRadius * rg::maxScale(world);
+        if (instance.flags & rg::SceneOrbiting)
+            radius += std::max(instance.orbit.radius.x, instance.orbit.radius.y);
+        const glm::vec3 center = glm::vec3(world * glm::vec4(caster.boundsCenter, 1.0f));
+        casterMin = glm::min(casterMin, center - glm::vec3(radius));
+        casterMax = glm::max(casterMax, center + glm::vec3(radius));
+    }
+    std::unique_ptr<rg::CascadedShadowMap> shadows(new rg::CascadedShadowMap);
+    if (!scene.instances.empty())
+        shadows->setCasterBounds(casterMin, casterMax);
+    std::unique_ptr<rg::PointShadows> pointShadows(new rg::PointShadows((unsigned int) scene.pointLights.size()));
+    std::unique_ptr<rg::AmbientOcclusion> ssao(new rg::AmbientOcclusion(SCR_WIDTH, SCR_HEIGHT));
+    std::unique_ptr<rg::AutoExposure> autoExposure(new rg::AutoExposure(SCR_WIDTH, SCR_HEIGHT));
+    std::unique_ptr<rg::ColorLut> colorLut(new rg::ColorLut);
+    // instances drawn as models this frame, the depth prepass and the lit pass draw the same ones
+    std::vector<unsigned int> modelInstances;
+    // world space bounding spheres of the instances, refreshed every frame for the shadow passes
+    std::vector<glm::vec4> casterSpheres(scene.instances.size());
           float skyboxVertices[] = {
                   // positions
                   -1.0f,  1.0f, -1.0f,
@@ -365,92 +612,83 @@ int main() {
                   1.0f, -1.0f,  1.0f
           };
 
-           stbi_set_flip_vertically_on_load(true);
           unsigned int skyboxVAO, skyboxVBO;
           glGenVertexArrays(1, &skyboxVAO);
           glGenBuffers(1, &skyboxVBO);
-          glBindVertexArray(skyboxVAO);
+          glState.bindVertexArray(skyboxVAO);
           glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
           glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
           glEnableVertexAttribArray(0);
           glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
           // load textures
-          vector<std::string> faces
-                  {
-                          FileSystem::getPath("resources/textures/skybox/skyboxbak/right.png"),
-                          FileSystem::getPath("resources/textures/skybox/skyboxbak/left.png"),
-                          FileSystem::getPath("resources/textures/skybox/skyboxbak/top.png"),
-                          FileSystem::getPath("resources/textures/skybox/skyboxbak/bottom.png"),
-                          FileSystem::getPath("resources/textures/skybox/skyboxbak/front.png"),
-                          FileSystem::getPath("resources/textures/skybox/skyboxbak/back.png")
-                  };
-          unsigned int cubemapTexture = loadCubemap(faces);
-    stbi_set_flip_vertically_on_load(false);
+          vector<std::string> faces;
+          for (const std::string& face : scene.skyboxFaces) {
+              faces.push_back(FileSystem::getPath(face));
+          }
+          rg::CubemapParams skyboxParams;
+          skyboxParams.flipVertically = scene.skyboxFlipVertically;
+          unsigned int cubemapTexture = loadCubemap(faces, skyboxParams);
+          rg::TextureRegistry& textureRegistry = rg::TextureRegistry::instance();
+          std::cout << "Textures: " << textureRegistry.loads << " loaded, " << textureRegistry.pathHits
+                    << " shared by path, " << textureRegistry.contentHits << " shared by content" << std::endl;
 
 
           // render loop
           // -----------
 
-          std::vector<glm::vec3> lightPositions;
-          lightPositions.push_back(glm::vec3(1,1,1));
-          lightPositions.push_back(glm::vec3(2,2,2));
-
-          std::vector<glm::vec3> lightAmbients;
-          lightAmbients.push_back(glm::vec3(0.05,0.05,0.05));
-          lightAmbients.push_back(glm::vec3(0.05,0.05,0.05));
-
-          std::vector<glm::vec3> lightDiffuse;
-          lightDiffuse.push_back(glm::vec3(0.8,0.8,0.8));
-          lightDiffuse.push_back(glm::vec3(0.8,0.8,0.8));
-
-          std::vector<glm::vec3> lightSpecular;
-          lightSpecular.push_back(glm::vec3(1,1,1));
-          lightSpecular.push_back(glm::vec3(1,1,1));
-
-          std::vector<float> lightConstant;
-          lightConstant.push_back(1.0f);
-          lightConstant.push_back(1.0f);
-
-          std::vector<float> lightLinear;
-          lightLinear.push_back(0.09f);
-          lightLinear.push_back(0.09f);
-
-          std::vector<float> lightQuadratic;
-          lightQuadratic.push_back(0.032f);
-          lightQuadratic.push_back(0.032f);
-
-
-    shader.use();
-
-              shader.setVec3("pointLight1.ambient", lightAmbients[0]);
-              shader.setVec3("pointLight1.diffuse", lightDiffuse[0]);
-              shader.setVec3("pointLight1.specular", lightSpecular[0]);
-              shader.setFloat("pointLight1.constant", lightConstant[0]);
-              shader.setFloat("pointLight1.linear", lightLinear[0]);
-              shader.setFloat("pointLight1.quadratic", lightQuadratic[0]);
+          std::vector<glm::vec3> lightPositions(scene.pointLights.size());
+
+          // the opaque and the alpha variant of the model shader share their lighting
+          for (Shader* lit : { &shader, &shaderAlpha }) {
+              lit->use();
+
+              // the shader has two point lights, missing ones stay black
+              for (unsigned int i = 0; i < 2; i++) {
+                  const std::string name = "pointLight" + std::to_string(i + 1);
+                  rg::ScenePointLight light;
+                  if (i < scene.pointLights.size()) {
+                      light = scene.pointLights[i];
+                  } else {
+                      light.ambient = light.diffuse = light.specular = glm::vec3(0.0f);
+                  }
+                  lit->setVec3(name + ".ambient", light.ambient);
+                  lit->setVec3(name + ".diffuse", light.diffuse);
+                  lit->setVec3(name + ".specular", light.specular);
+                  lit->setFloat(name + ".constant", light.constant);
+                  lit->setFloat(name + ".linear", light.linear);
+                  lit->setFloat(name + ".quadratic", light.quadratic);
+                  lit->setVec3(name + ".position", light.position);
+              }
 
+              lit->setVec3("dirLight.direction", scene.dirLight.direction);
+              lit->setVec3("dirLight.ambient", scene.dirLight.ambient);
+              lit->setVec3("dirLight.diffuse", scene.dirLight.diffuse);
+              lit->setVec3("dirLight.specular", scene.dirLight.specular);
+              lit->setBool("spot",programState->spotlight);
+              lit->setVec3("spotLight.ambient", scene.spotLight.ambient);
+              lit->setVec3("spotLight.diffuse", scene.spotLight.diffuse);
+              lit->setVec3("spotLight.specular", scene.spotLight.specular);
+              lit->setFloat("spotLight.constant", scene.spotLight.constant);
+              lit->setFloat("spotLight.linear", scene.spotLight.linear);
+              lit->setFloat("spotLight.quadratic", scene.spotLight.quadratic);
+              lit->setFloat("spotLight.cutOff", scene.spotLight.cutOff);
+              lit->setFloat("spotLight.outerCutOff", scene.spotLight.outerCutOff);
+              rg::CascadedShadowMap::setSamplers(*lit);
+              rg::PointShadows::setSamplers(*lit);
+              rg::AmbientOcclusion::setSamplers(*lit);
+          }
 
-    shader.setVec3("pointLight2.ambient", lightAmbients[1]);
-    shader.setVec3("pointLight2.diffuse", lightDiffuse[1]);
-    shader.setVec3("pointLight2.specular", lightSpecular[1]);
-    shader.setFloat("pointLight2.constant", lightConstant[1]);
-    shader.setFloat("pointLight2.linear", lightLinear[1]);
-    shader.setFloat("pointLight2.quadratic", lightQuadratic[1]);
+          shaderImpostor.use();
+          shaderImpostor.setVec3("dirLight.direction", scene.dirLight.direction);
+          shaderImpostor.setVec3("dirLight.ambient", scene.dirLight.ambient);
+          shaderImpostor.setVec3("dirLight.diffuse", scene.dirLight.diffuse);
 
-          shader.setVec3("dirLight.direction", -0.35f, 0.0f, -1.0f);
-          shader.setVec3("dirLight.ambient", 0.005f, 0.005f, 0.020f);
-          shader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.6f);
-          shader.setVec3("dirLight.specular", 0.2f, 0.2f, 0.1f);
-          shader.setBool("spot",programState->spotlight);
-          shader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-          shader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-          shader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-          shader.setFloat("spotLight.constant", 1.0f);
-          shader.setFloat("spotLight.linear", 0.09);
-          shader.setFloat("spotLight.quadratic", 0.032);
-          shader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-          shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+          shaderGrass.use();
+          shaderGrass.setVec3("dirLight.direction", scene.dirLight.direction);
+          shaderGrass.setVec3("dirLight.ambient", scene.dirLight.ambient);
+          shaderGrass.setVec3("dirLight.diffuse", scene.dirLight.diffuse);
+          shaderGrass.setVec2("windDirection", glm::vec2(0.8f, 0.6f));  // unit length
 
 
 
@@ -461,9 +699,19 @@ int main() {
           shaderBloomFinal.use();
           shaderBloomFinal.setInt("scene", 0);
           shaderBloomFinal.setInt("bloomBlur", 1);
+          rg::AutoExposure::setSamplers(shaderBloomFinal);
+          rg::ColorLut::setSamplers(shaderBloomFinal);
           shaderBlending.use();
           shaderBlending.setInt("texture1",0);
 
+          // textures keep streaming in over the first frames
+          rg::TextureStreamer& textureStreamer = rg::TextureStreamer::instance();
+          // the static shadow layers are cached, they are redrawn whenever another texture finishes streaming
+          size_t shadowTexturesPending = textureStreamer.pending();
+
+          // the cubemap loader and the ImGui init bound things directly, start the loop from a clean shadow
+          glState.invalidate();
+
           while (!glfwWindowShouldClose(window)) {
               // per-frame time logic
               // --------------------
@@ -471,11 +719,17 @@ int main() {
               float currentFrame = glfwGetTime();
               deltaTime = currentFrame - lastFrame;
               lastFrame = currentFrame;
+              glState.resetCounters();
 
               // input
               // -----
               processInput(window);
-
+              shaderWatcher.update();
+              textureStreamer.update();
+              // impostors are baked once, after the textures they show are resident
+              if (!impostors->baked() && textureStreamer.pending() == 0) {
+                  impostors->bake(shaderImpostorBake);
+              }
 
               // render
               // ------
@@ -485,140 +739,311 @@ int main() {
 
               // 1. render scene into floating point framebuffer
               // -----------------------------------------------
-              glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+              GLPUSHGROUP("Scene");
+              rg::DrawBatcher::AlphaMode alphaMode = (rg::DrawBatcher::AlphaMode) programState->alphaMode;
+              if (alphaMode == rg::DrawBatcher::AlphaCoverage && !msaaFBO)
+                  alphaMode = rg::DrawBatcher::AlphaTest;
+              const unsigned int sceneFBO = alphaMode == rg::DrawBatcher::AlphaCoverage ? msaaFBO : hdrFBO;
+              glState.bindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
               glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
               glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
               glm::mat4 view = programState->camera.GetViewMatrix();
               glm::mat4 model = glm::mat4(1.0f);
 
 
-              glm::vec3 pos0 = glm::vec3(4.0 * cos(currentFrame), 10.0f, 4.0 * sin(currentFrame));
-              glm::vec3 pos1 = glm::vec3(5.0 * sin(currentFrame)+2, 5.0f+3, 5.0 * cos(currentFrame)+1);
-
-              lightPositions[0]=pos0+glm::vec3(0,1,0);
-              lightPositions[1]=pos1+glm::vec3(0,1,0);
+              for (unsigned int i = 0; i < lightPositions.size(); i++) {
+                  lightPositions[i] = rg::lightPosition(scene.pointLights[i], currentFrame);
+              }
+              for (const auto& entity : animated) {
+                  transforms.setPosition(entity.first, rg::instancePosition(*entity.second, currentFrame));
+                  transforms.setRotation(entity.first, rg::instanceRotation(*entity.second, currentFrame));
+              }
+              transforms.update();
+              for (unsigned int i = 0; i < scene.nodeSpins.size(); i++) {
+                  if (spinNodes[i] >= 0) {
+                      const rg::SceneNodeSpin& spin = scene.nodeSpins[i];
+                      models[spin.model]->RotateNode(spinNodes[i], spin.speed * currentFrame, spin.axis);
+                  }
+              }
 
-              shader.use();
-              shader.setMat4("projection", projection);
-              shader.setMat4("view", view);
-              shader.setVec3("pointLight1.position", lightPositions[0]);
-              shader.setVec3("pointLight2.position", lightPositions[1]);
-              shader.setVec3("viewPos", programState->camera.Position);
+              if (textureStreamer.pending() != shadowTexturesPending) {
+                  shadowTexturesPending = textureStreamer.pending();
+                  shadows->invalidate();
+              }
+              for (unsigned int i = 0; i < scene.instances.size(); i++) {
+                  const Model& caster = *models[scene.instances[i].index];
+                  const glm::mat4& world = transforms.world(instanceEntities[i]);
+                  casterSpheres[i] = glm::vec4(glm::vec3(world * glm::vec4(caster.boundsCenter, 1.0f)),
+                                               caster.boundsRadius * rg::maxScale(world));
+              }
+              programState->shadowStats = rg::CascadedShadowMap::Stats();
+              if (programState->shadows) {
+                  // casters cut out with their opacity maps, full detail since static layers outlive the view
+                  batcher->setAlphaShader(&shaderShadowAlpha, rg::DrawBatcher::AlphaTest);
+                  auto drawCasters = [&](const rg::ShadowCascade& cascade, rg::CascadedShadowMap::Layer layer) {
+                      for (Shader* depth : { &shaderShadow, &shaderShadowAlpha }) {
+                          depth->use();
+                          depth->setMat4("lightSpace", cascade.viewProjection);
+                      }
+                      const rg::Frustum frustum(cascade.viewProjection);
+                      unsigned int casters = 0;
+                      for (unsigned int i = 0; i < scene.instances.size(); i++) {
+                          if (dynamicCasters[i] != (layer == rg::CascadedShadowMap::Dynamic))
+                              continue;
+                          if (!frustum.intersects(glm::vec3(casterSpheres[i]), casterSpheres[i].w))
+                              continue;
+                          models[scene.instances[i].index]->Submit(*batcher, shaderShadow, transforms.world(instanceEntities[i]));
+                          ++casters;
+                      }
+                      batcher->flush();
+                      batcher->flushTransparent();
+                      return casters;
+                  };
+                  shadows->render(programState->camera.Position, programState->camera.Front,
+                                  glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f,
+                                  scene.dirLight.direction, drawCasters);
+                  programState->shadowStats = shadows->stats();
+              }
+              programState->pointShadowStats = rg::PointShadows::Stats();
+              if (programState->pointShadows) {
+                  pointShadows->setBudget((unsigned int) programState->pointShadowBudget);
+                  pointShadows->setLayered(programState->layeredPointShadows);
+                  for (unsigned int i = 0; i < lightPositions.size() && i < rg::PointShadows::MaxLights; i++) {
+                      const rg::ScenePointLight& light = scene.pointLights[i];
+                      pointShadows->setLight(i, lightPositions[i], rg::PointShadows::range(light.constant, light.linear, light.quadratic),
+                                             std::max(light.diffuse.x, std::max(light.diffuse.y, light.diffuse.z)));
+                  }
+                  auto drawPointCasters = [&](const rg::PointShadowPass& pass) {
+                      Shader& depth = pass.layered ? shaderPointShadow : shaderPointShadowFace;
+                      Shader& depthAlpha = pass.layered ? shaderPointShadowAlpha : shaderPointShadowFaceAlpha;
+                      for (Shader* program : { &depth, &depthAlpha }) {
+                          program->use();
+                          pass.apply(*program);
+                      }
+                      batcher->setAlphaShader(&depthAlpha, rg::DrawBatcher::AlphaTest);
+                      unsigned int casters = 0;
+                      for (unsigned int i = 0; i < scene.instances.size(); i++) {
+                          if (!pass.reaches(glm::vec3(casterSpheres[i]), casterSpheres[i].w))
+                              continue;
+                          models[scene.instances[i].index]->Submit(*batcher, depth, transforms.world(instanceEntities[i]));
+                          ++casters;
+                      }
+                      batcher->flush();
+                      batcher->flushTransparent();
+                      return casters;
+                  };
+                  pointShadows->render(rg::Frustum(projection * view), programState->camera.Position, drawPointCasters);
+                  programState->pointShadowStats = pointShadows->stats();
+              }
 
-              shader.setBool("spot",programState->spotlight);
-              shader.setVec3("spotLight.position", programState->camera.Position);
-              shader.setVec3("spotLight.direction", programState->camera.Front);
+              for (Shader* lit : { &shader, &shaderAlpha }) {
+                  lit->use();
+                  lit->setMat4("projection", projection);
+                  lit->setMat4("view", view);
+                  for (unsigned int i = 0; i < lightPositions.size() && i < 2; i++) {
+                      lit->setVec3("pointLight" + std::to_string(i + 1) + ".position", lightPositions[i]);
+                  }
+                  lit->setVec3("viewPos", programState->camera.Position);
+
+                  lit->setBool("spot",programState->spotlight);
+                  lit->setVec3("spotLight.position", programState->camera.Position);
+                  lit->setVec3("spotLight.direction", programState->camera.Front);
+                  lit->setVec3("viewForward", programState->camera.Front);
+                  if (programState->shadows)
+                      shadows->bind(*lit);
+                  else
+                      lit->setInt("cascadeCount", 0);
+                  pointShadows->bind(*lit, programState->pointShadows);
+                  ssao->bind(*lit, programState->ssao > 0);
+              }
 
               shaderLight.use();
               shaderLight.setMat4("projection", projection);
               shaderLight.setMat4("view", view);
 
+              shaderBlending.use();
+              shaderBlending.setMat4("projection", projection);
+              shaderBlending.setMat4("view", view);
+              shaderBlending.setInt("alphaMode", alphaMode);
 
+              shaderImpostor.use();
+              shaderImpostor.setMat4("projection", projection);
+              shaderImpostor.setMat4("view", view);
+              shaderImpostor.setVec3("viewPos", programState->camera.Position);
 
-              shader.use();
+              shaderGrass.use();
+              shaderGrass.setMat4("projection", projection);
+              shaderGrass.setMat4("view", view);
+              shaderGrass.setFloat("time", currentFrame);
+              shaderGrass.setFloat("windStrength", programState->windStrength);
 
-              //island
-              model = glm::translate(model, programState->islandPosition+glm::vec3(0,6,0));
-              model = glm::scale(model, glm::vec3(0.1f));
-              shader.setMat4("model", model);
-              islan.Draw(shader);
+              skyboxShader.use();
+              glm::mat4 view2 = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
+              skyboxShader.setMat4("view", view2);
+              skyboxShader.setMat4("projection", projection);
 
+              rg::LodView lodView;
+              lodView.eye = programState->camera.Position;
+              lodView.projectionScale = SCR_HEIGHT / (2.0f * std::tan(glm::radians(programState->camera.Zoom) * 0.5f));
+              lodView.maxPixelError = programState->lodPixelError;
+              impostors->setView(programState->camera.Position);
+              batcher->setView(programState->camera.Position, 100.0f);
+              modelInstances.clear();
+              for (unsigned int i = 0; i < scene.instances.size(); i++) {
+                  const unsigned int index = scene.instances[i].index;
+                  if (programState->impostors && impostorKinds[index] >= 0 &&
+                      impostors->submit(impostorKinds[index], transforms.world(instanceEntities[i])))
+                      continue;
+                  modelInstances.push_back(i);
+              }
 
-              //heli
-              model = glm::mat4(1.0f);
-              model=glm::translate(model,pos0+glm::vec3(0,6,0));
-              model = glm::scale(model, glm::vec3(0.4f));
-              model = glm::rotate(model,-currentFrame, glm::vec3(0,1,0));
-              shader.setMat4("model", model);
-              heli.Draw(shader);
+              // depth of the models alone, then the occlusion from it; the lit pass draws over the same depth
+              const bool prepass = programState->ssao > 0;
+              if (prepass) {
+                  GLPUSHGROUP("Depth prepass");
+                  glState.bindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+                  glClear(GL_DEPTH_BUFFER_BIT);
+                  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                  for (Shader* depthOnly : { &shaderPrepass, &shaderPrepassAlpha }) {
+                      depthOnly->use();
+                      depthOnly->setMat4("projection", projection);
+                      depthOnly->setMat4("view", view);
+                  }
+                  // blended meshes do not write depth in the lit pass either
+                  batcher->setAlphaShader(&shaderPrepassAlpha, alphaMode == rg::DrawBatcher::AlphaBlend
+                                                                   ? rg::DrawBatcher::AlphaSkip : rg::DrawBatcher::AlphaTest);
+                  for (unsigned int i : modelInstances)
+                      models[scene.instances[i].index]->Submit(*batcher, shaderPrepass, transforms.world(instanceEntities[i]), &lodView);
+                  batcher->flush();
+                  batcher->flushTransparent();
+                  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                  GLPOPGROUP();
+                  ssao->setPreset(programState->ssao == 2 ? rg::AmbientOcclusion::Quality : rg::AmbientOcclusion::Performance);
+                  ssao->render(depthTexture, projection, shaderSsao, shaderSsaoBlur, renderQuad);
+                  glState.bindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+              }
 
+              batcher->setAlphaShader(&shaderAlpha, alphaMode);
+              for (unsigned int i : modelInstances)
+                  models[scene.instances[i].index]->Submit(*batcher, shader, transforms.world(instanceEntities[i]), &lodView);
+              // the prepass already wrote exactly these depths into hdrFBO
+              if (prepass && sceneFBO == hdrFBO)
+                  glState.depthFunc(GL_LEQUAL);
+              batcher->flush();
+              glState.depthFunc(GL_LESS);
+              programState->batchStats = batcher->stats();
+              impostors->flush(shaderImpostor);
+              programState->impostorStats = impostors->stats();
+              programState->grassStats = rg::GrassRenderer::Stats();
+              if (grass && programState->grass) {
+                  grass->draw(shaderGrass, rg::Frustum(projection * view), programState->camera.Position, scene.grass.distance);
+                  programState->grassStats = grass->stats();
+              }
 
-              model = glm::mat4(1.0f);
-              model=glm::translate(model,pos1+glm::vec3(0,6,0));
-              model = glm::scale(model, glm::vec3(0.4f));
-              model=glm::rotate(model,glm::radians(90.0f),glm::vec3(0,1,0));
-              model = glm::rotate(model, currentFrame, glm::vec3(0,1,0));
-              shader.setMat4("model", model);
-              heli.Draw(shader);
+              renderQueue.setView(programState->camera.Position, 100.0f);
+              renderQueue.setAlphaToCoverage(alphaMode == rg::DrawBatcher::AlphaCoverage);
 
               // vegetation
-              glDisable(GL_CULL_FACE);
-              shaderBlending.use();
-              shaderBlending.setMat4("projection", projection);
-              shaderBlending.setMat4("view", view);
-              glBindVertexArray(transparentVAO);
-              glBindTexture(GL_TEXTURE_2D, transparentTexture);
-              for (unsigned int i = 0; i < vegetation.size(); i++)
+              rg::RenderQueue::Item item;
+              item.shader = &shaderBlending;
+              item.vao = transparentVAO;
+              item.count = 6;
+              for (unsigned int i = 0; i < scene.billboards.size(); i++)
               {
-                  model = glm::mat4(1.0f);
-                  model = glm::translate(model, vegetation[i]+glm::vec3(0,6,0));
-                  shaderBlending.use();
-                  shaderBlending.setMat4("model", model);
-                  glDrawArrays(GL_TRIANGLES, 0, 6);
+                  item.texture = materialTextures[scene.billboards[i].index];
+                  item.model = transforms.world(billboardEntities[i]);
+                  renderQueue.submit(alphaMode == rg::DrawBatcher::AlphaBlend ? rg::PassTransparent : rg::PassAlphaTested,
+                                     item, glm::vec3(item.model[3]));
               }
-              glEnable(GL_CULL_FACE);
-              glCullFace(GL_FRONT);
-              glFrontFace(GL_CW);
-
-              //skybox
-              glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-              skyboxShader.use();
-              glm::mat4 view2 = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-              skyboxShader.setMat4("view", view2);
-              skyboxShader.setMat4("projection", projection);
-              // skybox cube
-              glBindVertexArray(skyboxVAO);
-              glActiveTexture(GL_TEXTURE0);
-              glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-              glDrawArrays(GL_TRIANGLES, 0, 36);
-              glBindVertexArray(0);
-              glDepthFunc(GL_LESS);
-
 
               //lights
-              shaderLight.use();
+              item = rg::RenderQueue::Item();
+              item.shader = &shaderLight;
+              item.vao = cubeVertexArray();
+              item.count = 36;
+              item.colorUniform = "lightColor";
               for (unsigned int i = 0; i < lightPositions.size(); i++)
               {
                   model = glm::mat4(1.0f);
-                  model = glm::translate(model, glm::vec3(lightPositions[i])+glm::vec3(0,6,0));
-                  model = glm::scale(model, glm::vec3(0.14f));
-                  shaderLight.setMat4("model", model);
-                  shaderLight.setVec3("lightColor", glm::vec3(30,30,30));
-                  renderCube();
-             }
+                  model = glm::translate(model, lightPositions[i] + scene.pointLights[i].markerOffset);
+                  model = glm::scale(model, glm::vec3(scene.pointLights[i].markerScale));
+                  item.model = model;
+                  item.color = scene.pointLights[i].markerColor;
+                  renderQueue.submit(rg::PassOpaque, item, glm::vec3(model[3]));
+              }
+
+              //skybox, drawn last among the opaque passes so depth testing rejects what is covered
+              item = rg::RenderQueue::Item();
+              item.shader = &skyboxShader;
+              item.vao = skyboxVAO;
+              item.count = 36;
+              item.textureTarget = GL_TEXTURE_CUBE_MAP;
+              item.texture = cubemapTexture;
+              renderQueue.submit(rg::PassSky, item, programState->camera.Position);
+
+              renderQueue.flush();
+              programState->queueStats = renderQueue.stats();
+              // blended model meshes, back to front over the sky
+              batcher->flushTransparent();
+
+              if (sceneFBO != hdrFBO) {
+                  // resolve both attachments, a blit only reads one color buffer at a time
+                  glState.bindFramebuffer(GL_READ_FRAMEBUFFER, msaaFBO);
+                  glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, hdrFBO);
+                  for (unsigned int i = 0; i < 2; i++) {
+                      glReadBuffer(attachments[i]);
+                      glDrawBuffers(1, &attachments[i]);
+                      glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                  }
+                  glReadBuffer(GL_COLOR_ATTACHMENT0);
+                  glDrawBuffers(2, attachments);
+              }
+              GLPOPGROUP();
 
                 //blur
-              glBindFramebuffer(GL_FRAMEBUFFER, 0);
+              GLPUSHGROUP("Bloom blur");
               bool horizontal = true, first_iteration = true;
                  unsigned int amount = 10;
                 shaderBlur.use();
                 for (unsigned int i = 0; i < amount; i++)
                 {
-                    glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
+                    glState.bindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
                     shaderBlur.setInt("horizontal", horizontal);
-                    glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
+                    glState.bindTexture(0, GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
                     renderQuad();
                     horizontal = !horizontal;
                     if (first_iteration)
                         first_iteration=false;
                 }
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+                GLPOPGROUP();
+
+                // exposure for this frame, metered from the scene without the bloom
+                autoExposure->settings().compensation = programState->exposureCompensation;
+                autoExposure->update(colorBuffers[0], deltaTime, shaderLuminance, shaderHistogram, shaderAdapt, renderQuad);
 
                 // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
                 // --------------------------------------------------------------------------------------------------------------------------
+                GLPUSHGROUP("Tone mapping");
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
                 shaderBloomFinal.use();
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
+                glState.bindTexture(0, GL_TEXTURE_2D, colorBuffers[0]);
+                glState.bindTexture(1, GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
                 shaderBloomFinal.setInt("bloom", programState->bloom);
-                shaderBloomFinal.setFloat("exposure", programState->exposure);
+                autoExposure->bind();
+                colorLut->update(programState->grading);
+                colorLut->bind();
                 renderQuad();
-              std::cout << "bloom: " << (programState->bloom ? "on" : "off") << "| exposure: " << programState->exposure << std::endl;
+                GLPOPGROUP();
 
-              if (programState->ImGuiEnabled)
+              if (programState->ImGuiEnabled) {
+                  GLGROUP("ImGui");
                   DrawImGui(programState);
+              }
+
+              glState.setValidation(programState->validateGLState);
+              glState.validate();
+              programState->glCounters = glState.counters();
 
               // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
               // -------------------------------------------------------------------------------
@@ -628,6 +1053,25 @@ int main() {
 
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
+    // models and the batcher own GL buffers, free them while the context is still alive
+    impostors.reset();
+    grass.reset();
+    shadows.reset();
+    pointShadows.reset();
+    ssao.reset();
+    autoExposure.reset();
+    colorLut.reset();
+    models.clear();
+    batcher.reset();
+    if (msaaFBO) {
+        glState.forgetFramebuffer(msaaFBO);
+        glDeleteFramebuffers(1, &msaaFBO);
+        glDeleteRenderbuffers(3, msaaBuffers);
+    }
+    glState.forgetTexture(depthTexture);
+    glDeleteTextures(1, &depthTexture);
+    textureRegistry.shutdown();
+    textureStreamer.shutdown();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -667,16 +1111,14 @@ void processInput(GLFWwindow *window) {
         bloomKeyPressed = false;
     }
 
+    // exposure is metered, Q and E shift it by up to 4 stops, one stop per second
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
     {
-        if (programState->exposure > 0.0f)
-            programState->exposure -= 0.001f;
-        else
-            programState->exposure = 0.0f;
+        programState->exposureCompensation = std::max(programState->exposureCompensation - deltaTime, -4.0f);
     }
     if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
     {
-        programState->exposure += 0.001f;
+        programState->exposureCompensation = std::min(programState->exposureCompensation + deltaTime, 4.0f);
     }
 
     if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS&&!spotKeyPressed)
@@ -696,7 +1138,7 @@ void processInput(GLFWwindow *window) {
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    rg::GLState::instance().viewport(0, 0, width, height);
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -739,6 +1181,56 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Rendering");
+        const rg::DrawBatcher::Stats& batches = programState->batchStats;
+        ImGui::Text("Model meshes: %u in %u batches, %u draw calls", batches.draws, batches.batches, batches.calls);
+        ImGui::Text("Model triangles: %u", batches.triangles);
+        ImGui::SliderFloat("LOD error (px)", &programState->lodPixelError, 0.0f, 8.0f);
+        ImGui::Text("Impostors: %u in %u draw calls", programState->impostorStats.impostors, programState->impostorStats.calls);
+        ImGui::Checkbox("Impostors", &programState->impostors);
+        const rg::GrassRenderer::Stats& grass = programState->grassStats;
+        ImGui::Text("Grass: %u blades in %u chunks, %u draw calls", grass.blades, grass.chunks, grass.calls);
+        ImGui::Checkbox("Grass", &programState->grass);
+        ImGui::SliderFloat("Wind", &programState->windStrength, 0.0f, 1.0f);
+        const rg::CascadedShadowMap::Stats& shadows = programState->shadowStats;
+        ImGui::Text("Shadows: %u static layers redrawn, %u static and %u dynamic casters", shadows.staticLayers,
+                    shadows.staticCasters, shadows.dynamicCasters);
+        ImGui::Checkbox("Shadows", &programState->shadows);
+        const rg::PointShadows::Stats& pointShadows = programState->pointShadowStats;
+        ImGui::Text("Point shadows: %u faces in %u passes, %u casters", pointShadows.faces, pointShadows.passes,
+                    pointShadows.casters);
+        ImGui::Checkbox("Point shadows", &programState->pointShadows);
+        ImGui::Checkbox("Layered (geometry shader)", &programState->layeredPointShadows);
+        ImGui::SliderInt("Faces per frame", &programState->pointShadowBudget, 1, 12);
+        // order of rg::DrawBatcher::AlphaMode
+        const char* alphaModes[] = { "Alpha test", "Alpha to coverage (4x MSAA)", "Sorted blending" };
+        ImGui::Combo("Alpha", &programState->alphaMode, alphaModes, 3);
+        const char* ssaoModes[] = { "Off", "Performance (8 samples)", "Quality (16 samples)" };
+        ImGui::Combo("SSAO", &programState->ssao, ssaoModes, 3);
+        ImGui::SliderFloat("Exposure (stops)", &programState->exposureCompensation, -4.0f, 4.0f);
+        ImGui::SliderFloat("Gamma", &programState->grading.gamma, 1.6f, 2.8f);
+        ImGui::SliderFloat("Temperature", &programState->grading.temperature, -1.0f, 1.0f);
+        ImGui::SliderFloat("Saturation", &programState->grading.saturation, 0.0f, 2.0f);
+        ImGui::SliderFloat("Contrast", &programState->grading.contrast, 0.5f, 1.5f);
+        const rg::RenderQueue::Stats& queue = programState->queueStats;
+        ImGui::Text("Queued draws: %u, %u program runs, %u material runs", queue.items, queue.programRuns, queue.materialRuns);
+        // binds that matched the shadowed state and never reached the driver
+        const rg::GLState::Counters& gl = programState->glCounters;
+        ImGui::Text("glUseProgram: %u issued, %u skipped", gl.programs.issued, gl.programs.skipped);
+        ImGui::Text("glBindVertexArray: %u issued, %u skipped", gl.vertexArrays.issued, gl.vertexArrays.skipped);
+        ImGui::Text("glBindTexture: %u issued, %u skipped", gl.textures.issued, gl.textures.skipped);
+        ImGui::Text("glActiveTexture: %u issued, %u skipped", gl.textureUnits.issued, gl.textureUnits.skipped);
+        ImGui::Text("glBindFramebuffer: %u issued, %u skipped", gl.framebuffers.issued, gl.framebuffers.skipped);
+        ImGui::Text("glEnable/glDisable: %u issued, %u skipped", gl.capabilities.issued, gl.capabilities.skipped);
+        ImGui::Text("Cull/depth/blend/viewport: %u issued, %u skipped", gl.fixedFunction.issued, gl.fixedFunction.skipped);
+        // compares the shadow against glGet* every frame, mismatches are printed to stderr
+        ImGui::Checkbox("Validate GL state shadow", &programState->validateGLState);
+        if (programState->validateGLState)
+            ImGui::Text("Shadow mismatches: %u", gl.mismatches);
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -760,87 +1252,25 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 
 
 }
-unsigned int loadCubemap(vector<std::string> faces)
+unsigned int loadCubemap(vector<std::string> faces, const rg::CubemapParams& params)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    const bool options[] = { params.flipVertically, params.gammaCorrection, params.mipmaps };
+    return rg::TextureRegistry::instance().acquire(faces, hashBytes(options, sizeof(options)), GL_TEXTURE_CUBE_MAP,
+                                                   [&faces, &params] { return rg::createCubemap(faces, params); });
 }
 unsigned int loadTexture(char const * path, bool gammaCorrection)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
-        {
-            internalFormat = dataFormat = GL_RED;
-        }
-        else if (nrComponents == 3)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
-        }
-        else if (nrComponents == 4)
-        {
-            //internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            internalFormat=GL_RGBA;
-            dataFormat = GL_RGBA;
-        }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    rg::TextureParams params;
+    params.wrapS = params.wrapT = GL_CLAMP_TO_EDGE;
+    params.gammaCorrection = gammaCorrection;
+    return rg::TextureRegistry::instance().acquire(path, params);
 }
 
 
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
-void renderCube() {
-    // initialize (if necessary)
+// unit cube with normals for the light markers, created on first use
+unsigned int cubeVertexArray() {
 
     if (cubeVAO == 0) {
         float vertices[] = {
@@ -901,7 +1331,7 @@ void renderCube() {
         glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
         // link vertex attributes
-        glBindVertexArray(cubeVAO);
+        rg::GLState::instance().bindVertexArray(cubeVAO);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *) 0);
         glEnableVertexAttribArray(1);
@@ -909,11 +1339,8 @@ void renderCube() {
 
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
     }
-    glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    return cubeVAO;
 }
 
 unsigned int quadVAO = 0;
@@ -932,7 +1359,7 @@ void renderQuad()
         // setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        rg::GLState::instance().bindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -940,47 +1367,15 @@ void renderQuad()
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
+    rg::GLState::instance().bindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
 
 unsigned int loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-
-        std::cout << "Texture loaded: " << path << std::endl;
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    // for this tutorial: use GL_CLAMP_TO_EDGE on RGBA textures to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
+    rg::TextureParams params;
+    params.clampIfAlpha = true;
+    return rg::TextureRegistry::instance().acquire(path, params);
 }
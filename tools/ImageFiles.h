@@ -0,0 +1,51 @@
+#ifndef PROJECT_BASE_IMAGEFILES_H
+#define PROJECT_BASE_IMAGEFILES_H
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+// Shared by the command line tools: recursively finds the images stb_image
+// decodes for us under a file or directory argument.
+
+inline std::string imageExtension(const std::string& path) {
+    const char* extensions[] = { ".png", ".jpg", ".jpeg", ".tga" };
+    for (const char* ext : extensions) {
+        size_t n = std::strlen(ext);
+        if (path.size() > n && strcasecmp(path.c_str() + path.size() - n, ext) == 0) {
+            return ext;
+        }
+    }
+    return "";
+}
+
+inline void collectImages(const std::string& path, std::vector<std::string>& files) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        std::cerr << "no such file " << path << '\n';
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        if (!imageExtension(path).empty()) {
+            files.push_back(path);
+        }
+        return;
+    }
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return;
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            collectImages(path + '/' + entry->d_name, files);
+        }
+    }
+    closedir(dir);
+}
+
+#endif //PROJECT_BASE_IMAGEFILES_H
@@ -0,0 +1,173 @@
+// Decode throughput of the vendored stb_image over the project's images.
+// Files are read into memory first, so only decoding (and the optional
+// vertical flip) is timed. Output is per format, in megabytes of decoded
+// texels per second.
+//
+// With --io the whole load is timed instead, comparing stbi_load (stdio) with
+// rg::MappedFile + stbi_load_from_memory on a cold and a warm page cache. The
+// cold runs evict each file with posix_fadvise first. Read syscalls come from
+// /proc/self/io, major page faults from getrusage.
+//
+// usage: decode_benchmark [--flip] [--io] [--iterations N] [file|dir]...   (default: resources)
+
+#include "ImageFiles.h"
+
+#include <rg/MappedFile.h>
+#include <stb_image.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+struct FormatStats {
+    int files = 0;
+    double fileBytes = 0;
+    double decodedBytes = 0;
+    double seconds = 0;
+};
+
+struct IoCounters {
+    double seconds = 0;
+    long long readCalls = 0;
+    long majorFaults = 0;
+};
+
+static long long readSyscalls() {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    long long value;
+    while (io >> key >> value) {
+        if (key == "syscr:") {
+            return value;
+        }
+    }
+    return 0;
+}
+
+static long majorFaults() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_majflt;
+}
+
+static void evict(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+static unsigned char* loadImage(const std::string& path, bool mapped, int& width, int& height, int& channels) {
+    if (!mapped) {
+        return stbi_load(path.c_str(), &width, &height, &channels, 0);
+    }
+    rg::MappedFile file(path);
+    return file.valid() ? stbi_load_from_memory(file.data(), (int) file.size(), &width, &height, &channels, 0) : nullptr;
+}
+
+static void ioBenchmark(const std::vector<std::string>& files, int iterations) {
+    std::printf("%-6s %-6s %10s %14s %14s\n", "cache", "loader", "ms total", "read calls", "major faults");
+    for (int cold = 1; cold >= 0; --cold) {
+        for (int mapped = 0; mapped <= 1; ++mapped) {
+            IoCounters total;
+            for (int i = 0; i < iterations; ++i) {
+                for (const std::string& file : files) {
+                    if (cold) {
+                        evict(file);
+                    }
+                    long long calls = readSyscalls();
+                    long faults = majorFaults();
+                    auto start = std::chrono::steady_clock::now();
+                    int width, height, channels;
+                    unsigned char* data = loadImage(file, mapped, width, height, channels);
+                    total.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    // the /proc read itself is one read syscall
+                    total.readCalls += readSyscalls() - calls - 1;
+                    total.majorFaults += majorFaults() - faults;
+                    stbi_image_free(data);
+                }
+            }
+            std::printf("%-6s %-6s %10.1f %14.0f %14.0f\n", cold ? "cold" : "warm", mapped ? "mmap" : "stdio",
+                        total.seconds * 1000.0 / iterations, (double) total.readCalls / iterations,
+                        (double) total.majorFaults / iterations);
+        }
+    }
+    std::printf("%zu files, averaged over %d runs\n", files.size(), iterations);
+}
+
+int main(int argc, char** argv) {
+    bool flip = false;
+    bool io = false;
+    int iterations = 5;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--flip") {
+            flip = true;
+        } else if (arg == "--io") {
+            io = true;
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else {
+            collectImages(arg, files);
+        }
+    }
+    if (files.empty()) {
+        collectImages("resources", files);
+    }
+    stbi_set_flip_vertically_on_load(flip);
+    if (io) {
+        ioBenchmark(files, iterations);
+        return 0;
+    }
+
+    std::map<std::string, FormatStats> stats;
+    for (const std::string& file : files) {
+        std::ifstream in(file, std::ios::binary);
+        std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        int width = 0, height = 0, channels = 0;
+        double best = 1e30;
+        bool ok = true;
+        for (int i = 0; i < iterations && ok; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            unsigned char* data = stbi_load_from_memory(bytes.data(), (int) bytes.size(), &width, &height, &channels, 0);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ok = data != nullptr;
+            stbi_image_free(data);
+            best = std::min(best, seconds);
+        }
+        if (!ok) {
+            std::cerr << "cannot decode " << file << ": " << stbi_failure_reason() << '\n';
+            continue;
+        }
+        std::string ext = imageExtension(file).substr(1);
+        if (ext == "jpeg") {
+            ext = "jpg";
+        }
+        FormatStats& s = stats[ext];
+        ++s.files;
+        s.fileBytes += bytes.size();
+        s.decodedBytes += (double) width * height * channels;
+        s.seconds += best;
+    }
+
+    std::printf("%-6s %6s %12s %14s %10s %10s\n", "format", "files", "file MB", "decoded MB", "ms/image", "MB/s");
+    for (const auto& entry : stats) {
+        const FormatStats& s = entry.second;
+        std::printf("%-6s %6d %12.2f %14.2f %10.2f %10.1f\n", entry.first.c_str(), s.files, s.fileBytes / 1e6,
+                    s.decodedBytes / 1e6, s.seconds * 1000.0 / s.files, s.decodedBytes / 1e6 / s.seconds);
+    }
+    std::printf("best of %d runs per file%s\n", iterations, flip ? ", flipped on load" : "");
+    return 0;
+}
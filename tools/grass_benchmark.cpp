@@ -0,0 +1,129 @@
+// Scatter and culling cost of the grass field on a generated island.
+// The surface is a 200 x 200 unit heightfield with hills steep enough for
+// minUp to reject some of it, and the density map is a blob pattern that
+// leaves about half the ground bare, so the scatter pays for rejected tries.
+//
+// Per camera position (a circle around the island, 2 units above the ground,
+// looking at its center with the app's 45 degree, 1000x700 projection) the
+// chunks are culled against the frustum and the draw distance; listed are the
+// chunks and blades left and the time the CPU spends deciding that.
+//
+// usage: grass_benchmark [--blades N] [--chunk SIZE] [--distance D]   (default: 100000 blades, 4, 40)
+
+#include <rg/GrassField.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static float terrainHeight(float x, float z) {
+    // a dome falling off to the shore, with ridges on it
+    const float r = std::sqrt(x * x + z * z) / 100.0f;
+    return 12.0f * std::max(0.0f, 1.0f - r * r) + 1.5f * std::sin(x * 0.21f) * std::cos(z * 0.17f);
+}
+
+static std::vector<glm::vec3> buildTerrain(int cells) {
+    std::vector<glm::vec3> triangles;
+    const float size = 200.0f / cells;
+    auto point = [&](int i, int j) {
+        const float x = -100.0f + i * size, z = -100.0f + j * size;
+        return glm::vec3(x, terrainHeight(x, z), z);
+    };
+    for (int j = 0; j < cells; ++j) {
+        for (int i = 0; i < cells; ++i) {
+            // counter-clockwise seen from above
+            triangles.push_back(point(i, j));
+            triangles.push_back(point(i, j + 1));
+            triangles.push_back(point(i + 1, j));
+            triangles.push_back(point(i + 1, j));
+            triangles.push_back(point(i, j + 1));
+            triangles.push_back(point(i + 1, j + 1));
+        }
+    }
+    return triangles;
+}
+
+static rg::DensityMap buildDensity(int size) {
+    rg::DensityMap map;
+    map.width = map.height = size;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            const float u = (float) x / size * 6.2831853f, v = (float) y / size * 6.2831853f;
+            const float blob = std::sin(u * 3.0f) * std::sin(v * 2.0f) + 0.5f * std::sin(u * 7.0f + v * 5.0f);
+            map.values.push_back((uint8_t) (255.0f * std::min(std::max(blob + 0.3f, 0.0f), 1.0f)));
+        }
+    }
+    return map;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    rg::GrassSettings settings;
+    float distance = 40.0f;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--blades" && i + 1 < argc) {
+            settings.blades = (uint32_t) std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--chunk" && i + 1 < argc) {
+            settings.chunkSize = std::max(0.1f, (float) std::atof(argv[++i]));
+        } else if (arg == "--distance" && i + 1 < argc) {
+            distance = std::max(1.0f, (float) std::atof(argv[++i]));
+        } else {
+            std::printf("usage: grass_benchmark [--blades N] [--chunk SIZE] [--distance D]\n");
+            return 1;
+        }
+    }
+
+    const std::vector<glm::vec3> triangles = buildTerrain(256);
+    const rg::DensityMap density = buildDensity(256);
+    rg::GrassField field;
+    auto start = std::chrono::steady_clock::now();
+    field.scatter(triangles, density, settings);
+    const double scatterTime = millisecondsSince(start);
+    const size_t blades = field.blades().size();
+    std::printf("%zu triangles, %zu blades in %zu chunks of %g units, scattered in %.1f ms\n", triangles.size() / 3,
+                blades, field.chunks().size(), settings.chunkSize, scatterTime);
+    std::printf("instance buffer %.1f MB\n\n", blades * sizeof(rg::GrassBlade) / 1e6);
+
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1000.0f / 700.0f, 0.1f, 100.0f);
+    std::printf("draw distance %g, thinning from %g\n", distance, distance * 0.5f);
+    std::printf("%-8s %8s %10s %8s %10s\n", "camera", "chunks", "blades", "of all", "cull us");
+    std::vector<rg::GrassDraw> draws;
+    const int cameras = 8;
+    double totalTime = 0.0;
+    size_t totalDrawn = 0;
+    for (int c = 0; c < cameras; ++c) {
+        const float angle = 6.2831853f * c / cameras;
+        const float radius = 30.0f + 50.0f * (c % 2);
+        glm::vec3 eye(radius * std::cos(angle), 0.0f, radius * std::sin(angle));
+        eye.y = terrainHeight(eye.x, eye.z) + 2.0f;
+        const glm::vec3 target(0.0f, terrainHeight(0.0f, 0.0f) * 0.5f, 0.0f);
+        const rg::Frustum frustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+        const int repeats = 200;
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            field.cull(frustum, eye, distance, 0.5f, draws);
+        }
+        const double cullTime = millisecondsSince(start) * 1e3 / repeats;
+        size_t drawn = 0;
+        for (const rg::GrassDraw& draw : draws) {
+            drawn += draw.count;
+        }
+        totalTime += cullTime;
+        totalDrawn += drawn;
+        std::printf("%-8d %8zu %10zu %7.1f%% %10.1f\n", c, draws.size(), drawn, 100.0 * drawn / blades, cullTime);
+    }
+    std::printf("%-8s %8s %10zu %7.1f%% %10.1f\n", "mean", "", totalDrawn / cameras, 100.0 * totalDrawn / cameras / blades,
+                totalTime / cameras);
+    return 0;
+}
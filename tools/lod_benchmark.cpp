@@ -0,0 +1,220 @@
+// Triangle count against visual error for the generated levels of detail.
+// The model is imported with the same assimp flags as Model and every mesh
+// gets the chain Model::buildLods builds, with the same attribute weights.
+//
+// Per level: triangles kept, the error the chain reports (a bound on the
+// distance from the original vertices to the level's surface), and that
+// distance measured against all of the level's triangles (one-sided
+// Hausdorff over up to 1000 vertices per mesh), both relative to the model's
+// bounding radius. The reported error should never be below the measured max.
+//
+// Then a field of instances spread over 5-200 units in front of a 1000x700,
+// 45 degree camera (the app's defaults) is drawn for a range of pixel error
+// limits: triangles submitted per frame against what each limit allows on
+// screen, and the cost of picking the levels.
+//
+// usage: lod_benchmark [--levels N] [--instances N] [model]   (default: 4 levels, 1000 instances, resources/objects/heli/ah64d.obj)
+
+#include <rg/MeshLod.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+struct BenchVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+};
+
+struct BenchMesh {
+    std::vector<BenchVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<rg::MeshLod> lods;
+};
+
+static bool loadMeshes(const std::string& path, std::vector<BenchMesh>& meshes) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs |
+                                                   aiProcess_CalcTangentSpace);
+    if (!scene || !scene->mRootNode) {
+        std::printf("%s: %s\n", path.c_str(), importer.GetErrorString());
+        return false;
+    }
+    for (unsigned int m = 0; m < scene->mNumMeshes; ++m) {
+        const aiMesh* source = scene->mMeshes[m];
+        BenchMesh mesh;
+        for (unsigned int i = 0; i < source->mNumVertices; ++i) {
+            BenchVertex vertex;
+            vertex.position = glm::vec3(source->mVertices[i].x, source->mVertices[i].y, source->mVertices[i].z);
+            vertex.normal = source->HasNormals() ? glm::vec3(source->mNormals[i].x, source->mNormals[i].y, source->mNormals[i].z)
+                                                 : glm::vec3(0.0f);
+            vertex.texCoords = source->mTextureCoords[0]
+                               ? glm::vec2(source->mTextureCoords[0][i].x, source->mTextureCoords[0][i].y)
+                               : glm::vec2(0.0f);
+            mesh.vertices.push_back(vertex);
+        }
+        for (unsigned int f = 0; f < source->mNumFaces; ++f) {
+            for (unsigned int j = 0; j < source->mFaces[f].mNumIndices; ++j) {
+                mesh.indices.push_back(source->mFaces[f].mIndices[j]);
+            }
+        }
+        meshes.push_back(mesh);
+    }
+    return true;
+}
+
+// largest and summed distance from sampled level 0 vertices to the level's triangles
+static void measureError(const BenchMesh& mesh, const rg::MeshLod& lod, float& maxDistance, double& sumDistance,
+                         size_t& samples) {
+    std::vector<bool> used(mesh.vertices.size(), false);
+    for (uint32_t i = 0; i < mesh.lods[0].indexCount; ++i) {
+        used[mesh.indices[i]] = true;
+    }
+    std::vector<uint32_t> sampled;
+    for (uint32_t v = 0; v < used.size(); ++v) {
+        if (used[v]) {
+            sampled.push_back(v);
+        }
+    }
+    const size_t step = std::max<size_t>(1, sampled.size() / 1000);
+    for (size_t s = 0; s < sampled.size(); s += step) {
+        const glm::vec3& p = mesh.vertices[sampled[s]].position;
+        float best = INFINITY;
+        for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; i += 3) {
+            const glm::vec3 closest = rg::closestPointOnTriangle(p, mesh.vertices[mesh.indices[i]].position,
+                                                                 mesh.vertices[mesh.indices[i + 1]].position,
+                                                                 mesh.vertices[mesh.indices[i + 2]].position);
+            best = std::min(best, glm::dot(p - closest, p - closest));
+        }
+        best = std::sqrt(best);
+        maxDistance = std::max(maxDistance, best);
+        sumDistance += best;
+        ++samples;
+    }
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    std::string path = "resources/objects/heli/ah64d.obj";
+    unsigned int levels = 4;
+    size_t instances = 1000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--levels" && i + 1 < argc) {
+            levels = (unsigned int) std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--instances" && i + 1 < argc) {
+            instances = (size_t) std::max(1, std::atoi(argv[++i]));
+        } else if (!arg.empty() && arg[0] != '-') {
+            path = arg;
+        } else {
+            std::printf("usage: lod_benchmark [--levels N] [--instances N] [model]\n");
+            return 1;
+        }
+    }
+    std::vector<BenchMesh> meshes;
+    if (!loadMeshes(path, meshes) || meshes.empty()) {
+        return 1;
+    }
+
+    // same weights as Model::buildLods
+    const float attributeWeights[5] = { 0.02f, 0.02f, 0.02f, 0.1f, 0.1f };
+    size_t triangles = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (BenchMesh& mesh : meshes) {
+        triangles += mesh.indices.size() / 3;
+        rg::SimplifyMesh simplify;
+        simplify.positions = &mesh.vertices[0].position.x;
+        simplify.attributes = &mesh.vertices[0].normal.x;
+        simplify.attributeWeights = attributeWeights;
+        simplify.attributeCount = 5;
+        simplify.vertexCount = mesh.vertices.size();
+        simplify.stride = sizeof(BenchVertex);
+        mesh.lods = rg::buildLodChain(simplify, mesh.indices, levels);
+    }
+    const double buildTime = millisecondsSince(start);
+
+    glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+    for (const BenchMesh& mesh : meshes) {
+        for (const BenchVertex& vertex : mesh.vertices) {
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
+        }
+    }
+    const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    const float radius = glm::length(boundsMax - center);
+
+    std::printf("%s: %zu meshes, %zu triangles, bounding radius %g\n", path.c_str(), meshes.size(), triangles, radius);
+    std::printf("chain built in %.1f ms, %.2f Mtriangles/s\n\n", buildTime, triangles / buildTime / 1e3);
+    std::printf("%-6s %10s %8s %16s %16s %16s\n", "level", "triangles", "kept", "reported error", "measured max", "measured mean");
+    for (unsigned int level = 0; level < levels; ++level) {
+        size_t levelTriangles = 0, samples = 0;
+        float reported = 0.0f, measuredMax = 0.0f;
+        double measuredSum = 0.0;
+        for (const BenchMesh& mesh : meshes) {
+            // meshes with a shorter chain stay at their coarsest level
+            const rg::MeshLod& lod = mesh.lods[std::min<size_t>(level, mesh.lods.size() - 1)];
+            levelTriangles += lod.indexCount / 3;
+            reported = std::max(reported, lod.error);
+            if (level > 0) {
+                measureError(mesh, lod, measuredMax, measuredSum, samples);
+            }
+        }
+        std::printf("%-6u %10zu %7.1f%% %15.3f%% %15.3f%% %15.3f%%\n", level, levelTriangles,
+                    100.0 * levelTriangles / triangles, 100.0f * reported / radius, 100.0f * measuredMax / radius,
+                    samples ? 100.0 * measuredSum / samples / radius : 0.0);
+    }
+
+    // instances at random distances and sizes, all in view
+    std::vector<glm::vec3> positions(instances);
+    std::vector<float> scales(instances);
+    unsigned int seed = 12345;
+    auto random = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+    for (size_t i = 0; i < instances; ++i) {
+        const float distance = 5.0f + 195.0f * random();
+        const float angle = (random() - 0.5f) * 0.6f;
+        positions[i] = glm::vec3(distance * std::sin(angle), 0.0f, -distance * std::cos(angle));
+        scales[i] = (0.2f + 0.4f * random()) / radius;   // the helicopters are about 0.4 units across in the scene
+    }
+
+    rg::LodView view;
+    view.projectionScale = 700.0f / (2.0f * std::tan(glm::radians(45.0f) * 0.5f));
+    std::printf("\n%zu instances, 5-200 units from the camera\n", instances);
+    std::printf("%-16s %14s %8s %14s\n", "max pixel error", "triangles", "of full", "selection ns");
+    const float limits[] = { 0.0f, 0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 8.0f };
+    size_t full = 0;
+    for (float limit : limits) {
+        view.maxPixelError = limit;
+        size_t submitted = 0;
+        const int repeats = 20;
+        start = std::chrono::steady_clock::now();
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            submitted = 0;
+            for (size_t i = 0; i < instances; ++i) {
+                const float pixelsPerUnit = view.pixelsPerUnit(positions[i] + center * scales[i], radius * scales[i]);
+                for (const BenchMesh& mesh : meshes) {
+                    submitted += mesh.lods[rg::selectLod(mesh.lods, pixelsPerUnit * scales[i], limit)].indexCount / 3;
+                }
+            }
+        }
+        const double selection = millisecondsSince(start) * 1e6 / repeats / instances;
+        full = limit == 0.0f ? submitted : full;
+        std::printf("%-16g %14zu %7.1f%% %14.1f\n", limit, submitted, 100.0 * submitted / full, selection);
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Offline texture cooker: decodes every image under the given paths once,
+// builds the mip chain and optionally block-compresses it, and writes
+// <image>.rgtex next to the source. TextureStreamer picks the cooked file up
+// whenever it is newer than the image it was made from.
+//
+// usage: texture_cooker [--uncompressed] [--linear] [--force] <file|dir>...
+
+#include "ImageFiles.h"
+
+#include <rg/BlockCompression.h>
+#include <rg/CookedTexture.h>
+#include <rg/MipChain.h>
+#include <stb_image.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+struct Options {
+    bool compress = true;
+    bool srgb = true;
+    bool force = false;
+};
+
+static bool upToDate(const std::string& source, const std::string& output) {
+    struct stat src, out;
+    return stat(source.c_str(), &src) == 0 && stat(output.c_str(), &out) == 0 && out.st_mtime >= src.st_mtime;
+}
+
+static bool cook(const std::string& path, const Options& options, size_t& inBytes, size_t& outBytes) {
+    int width, height, channels;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+    if (!data) {
+        std::cerr << "texture_cooker: cannot decode " << path << '\n';
+        return false;
+    }
+    std::vector<rg::TextureLevel> levels(1);
+    levels[0].width = width;
+    levels[0].height = height;
+    levels[0].pixels.assign(data, data + (size_t) width * height * channels);
+    stbi_image_free(data);
+
+    rg::CookedTexture texture;
+    bool opaque = true;
+    if (channels == 4) {
+        for (size_t i = 3; i < levels[0].pixels.size(); i += 4) {
+            opaque = opaque && levels[0].pixels[i] == 255;
+        }
+    }
+    if (!opaque) {
+        texture.flags |= rg::CookedAlpha;
+    }
+    const bool srgb = options.srgb && channels >= 3;
+    if (srgb) {
+        texture.flags |= rg::CookedSRGB;
+    }
+    rg::buildMipChain(levels, channels, srgb);
+
+    // BC1 has no alpha to speak of, so opaque RGBA images take the smaller format
+    const rg::CookedFormat raw[] = { rg::CookedFormat::R8, rg::CookedFormat::RG8, rg::CookedFormat::RGB8, rg::CookedFormat::RGBA8 };
+    texture.format = raw[channels - 1];
+    rg::BlockFormat block = rg::BlockFormat::BC1;
+    if (options.compress && channels >= 2) {
+        if (channels == 2) {
+            texture.format = rg::CookedFormat::BC5;
+            block = rg::BlockFormat::BC5;
+        } else if (channels == 4 && !opaque) {
+            texture.format = rg::CookedFormat::BC3;
+            block = rg::BlockFormat::BC3;
+        } else {
+            texture.format = rg::CookedFormat::BC1;
+        }
+    }
+
+    for (rg::TextureLevel& level : levels) {
+        rg::CookedLevel cookedLevel;
+        cookedLevel.width = level.width;
+        cookedLevel.height = level.height;
+        if (texture.format >= rg::CookedFormat::BC1) {
+            cookedLevel.data = rg::compressLevel(block, level.pixels.data(), level.width, level.height, channels);
+        } else {
+            cookedLevel.data = std::move(level.pixels);
+        }
+        outBytes += cookedLevel.data.size();
+        texture.levels.push_back(std::move(cookedLevel));
+    }
+    inBytes += (size_t) width * height * channels;
+    return rg::writeCookedTexture(rg::cookedPath(path), texture);
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--uncompressed") {
+            options.compress = false;
+        } else if (arg == "--linear") {
+            options.srgb = false;
+        } else if (arg == "--force") {
+            options.force = true;
+        } else {
+            collectImages(arg, files);
+        }
+    }
+    if (argc < 2) {
+        std::cerr << "usage: texture_cooker [--uncompressed] [--linear] [--force] <file|dir>...\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t inBytes = 0, outBytes = 0;
+    int cooked = 0, skipped = 0, failed = 0;
+    for (const std::string& file : files) {
+        if (!options.force && upToDate(file, rg::cookedPath(file))) {
+            ++skipped;
+            continue;
+        }
+        if (cook(file, options, inBytes, outBytes)) {
+            ++cooked;
+            std::cout << "cooked " << file << '\n';
+        } else {
+            ++failed;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << cooked << " cooked, " << skipped << " up to date, " << failed << " failed in " << seconds << " s";
+    if (inBytes > 0) {
+        std::cout << " (" << inBytes / 1024 << " KB of base level texels -> " << outBytes / 1024 << " KB with mips)";
+    }
+    std::cout << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// Per-frame cost of rebuilding world matrices for many animated entities.
+// Every frame each animated entity gets a new orbit position and spin, as the
+// helicopters in the scene do, then its world matrix is rebuilt:
+//
+//   glm      one glm::translate/scale/rotate chain per entity into a mat4 array
+//   store    rg::TransformStore setters plus one batched update()
+//
+// The store is also timed with only a tenth of the entities moving, where the
+// dirty flags let update() skip the rest. Time spent inside update() alone is
+// listed separately; the remainder is the animation and the setters. Last, the
+// store's matrices are compared with the glm chain for non-uniform scales and
+// arbitrary rotations, which only agree when both scale after rotating.
+//
+// usage: transform_benchmark [--entities N] [--frames N]   (default: 100000 entities, 200 frames)
+
+#include <rg/Transforms.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+struct Animation {
+    glm::vec3 center;
+    float radius;
+    float speed;
+    float scale;
+};
+
+static std::vector<Animation> makeAnimations(size_t count) {
+    std::vector<Animation> animations(count);
+    unsigned int seed = 12345;
+    auto random = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+    for (Animation& animation : animations) {
+        animation.center = glm::vec3(random() * 200.0f - 100.0f, random() * 20.0f, random() * 200.0f - 100.0f);
+        animation.radius = 1.0f + random() * 4.0f;
+        animation.speed = 0.5f + random();
+        animation.scale = 0.2f + random() * 0.4f;
+    }
+    return animations;
+}
+
+static glm::vec3 orbit(const Animation& animation, float time) {
+    const float angle = animation.speed * time;
+    return animation.center + glm::vec3(animation.radius * std::cos(angle), 0.0f, animation.radius * std::sin(angle));
+}
+
+// keeps the optimizer from dropping the matrices nobody reads
+static float checksum(const glm::mat4* matrices, size_t count) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; i += 97) {
+        sum += matrices[i][3][0] + matrices[i][0][0];
+    }
+    return sum;
+}
+
+// largest element difference between the store and translate * scale * rotate
+static float compareWithGlm(size_t count) {
+    unsigned int seed = 777;
+    auto random = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+    rg::TransformStore store;
+    std::vector<rg::Entity> handles;
+    std::vector<glm::mat4> expected;
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3 position(random() * 20.0f - 10.0f, random() * 20.0f - 10.0f, random() * 20.0f - 10.0f);
+        const glm::vec3 scale(0.2f + random() * 2.0f, 0.2f + random() * 2.0f, 0.2f + random() * 2.0f);
+        const glm::vec3 axis = glm::normalize(glm::vec3(random() - 0.5f, random() - 0.5f, random() - 0.5f) + glm::vec3(0.0f, 0.01f, 0.0f));
+        const float angle = random() * 6.2831853f;
+        handles.push_back(store.create(position, glm::angleAxis(angle, axis), scale));
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+        model = glm::scale(model, scale);
+        expected.push_back(glm::rotate(model, angle, axis));
+    }
+    store.update();
+    float largest = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        const glm::mat4& world = store.world(handles[i]);
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                largest = std::max(largest, std::abs(world[c][r] - expected[i][c][r]));
+            }
+        }
+    }
+    return largest;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t entities = 100000;
+    int frames = 200;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--entities" && i + 1 < argc) {
+            entities = (size_t) std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else {
+            std::printf("usage: transform_benchmark [--entities N] [--frames N]\n");
+            return 1;
+        }
+    }
+    const std::vector<Animation> animations = makeAnimations(entities);
+    const glm::vec3 up(0.0f, 1.0f, 0.0f);
+    float sink = 0.0f;
+
+    std::vector<glm::mat4> matrices(entities);
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        const float time = frame / 60.0f;
+        for (size_t i = 0; i < entities; ++i) {
+            const Animation& animation = animations[i];
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), orbit(animation, time));
+            model = glm::scale(model, glm::vec3(animation.scale));
+            matrices[i] = glm::rotate(model, animation.speed * time, up);
+        }
+        sink += checksum(matrices.data(), entities);
+    }
+    const double glmTime = millisecondsSince(start) / frames;
+
+    rg::TransformStore store;
+    std::vector<rg::Entity> handles;
+    for (const Animation& animation : animations) {
+        handles.push_back(store.create(orbit(animation, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(animation.scale)));
+    }
+    store.update();
+
+    double storeTime[2], updateTime[2] = { 0.0, 0.0 };
+    const size_t strides[2] = { 1, 10 };
+    for (int run = 0; run < 2; ++run) {
+        start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            const float time = frame / 60.0f;
+            for (size_t i = 0; i < entities; i += strides[run]) {
+                const Animation& animation = animations[i];
+                store.setPosition(handles[i], orbit(animation, time));
+                store.setRotation(handles[i], glm::angleAxis(animation.speed * time, up));
+            }
+            auto update = std::chrono::steady_clock::now();
+            store.update();
+            updateTime[run] += millisecondsSince(update);
+            sink += checksum(store.worlds(), store.size());
+        }
+        storeTime[run] = millisecondsSince(start) / frames;
+        updateTime[run] /= frames;
+    }
+
+    std::printf("%zu entities, %d frames\n", entities, frames);
+    std::printf("%-24s %10s %12s %12s\n", "", "ms/frame", "update() ms", "Mentities/s");
+    std::printf("%-24s %10.3f %12s %12.1f\n", "glm chain, all moving", glmTime, "-", entities / glmTime / 1e3);
+    std::printf("%-24s %10.3f %12.3f %12.1f\n", "store, all moving", storeTime[0], updateTime[0], entities / storeTime[0] / 1e3);
+    std::printf("%-24s %10.3f %12.3f %12.1f\n", "store, 10% moving", storeTime[1], updateTime[1], entities / 10 / storeTime[1] / 1e3);
+    std::printf("largest difference from the glm chain, non-uniform scale: %g\n", compareWithGlm(1001));
+    std::printf("(checksum %g)\n", sink);
+    return 0;
+}